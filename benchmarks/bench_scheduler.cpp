@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <scheduler/Scheduler.h>
+
+using namespace rboc::utils::scheduler;
+
+//! Timer dispatch: time from one periodic callback to the next, minus the period.
+/**
+ * Each iteration waits for the next callback of a periodic task and reports, as
+ * manual time, how late it fired with respect to its period.
+ */
+static void BM_SchedulerPeriodicDispatch(benchmark::State& state)
+{
+	const time_t period_ms = static_cast<time_t>(state.range(0));
+	std::mutex mtx;
+	std::condition_variable cond;
+	uint64_t fired = 0;
+	std::chrono::steady_clock::time_point last_fire;
+
+	Scheduler sched;
+	int error = 0;
+	sched.addPeriodicTask("bench", period_ms, [&]
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		last_fire = std::chrono::steady_clock::now();
+		++fired;
+		cond.notify_one();
+	}, error);
+	if (error != 0)
+	{
+		state.SkipWithError("addPeriodicTask failed");
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mtx);
+	cond.wait(lock, [&]{ return fired > 0; });
+	for (auto _ : state)
+	{
+		auto seen = fired;
+		auto previous = last_fire;
+		cond.wait(lock, [&]{ return fired > seen; });
+		std::chrono::duration<double> lateness = (last_fire - previous) - std::chrono::milliseconds(period_ms);
+		state.SetIterationTime(lateness.count() < 0 ? -lateness.count() : lateness.count());
+	}
+}
+BENCHMARK(BM_SchedulerPeriodicDispatch)->ArgName("period_ms")->Arg(1)->Arg(10)->Iterations(100)->UseManualTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,780 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <common/Metrics.h>
+#include <thread/ActiveWorker.h>
+#include <thread/Threadpool.h>
+#include <thread/TaskAllocator.h>
+#include <thread/TaskGroup.h>
+#include <thread/ForkJoin.h>
+#include <thread/Algorithms.h>
+#include <thread/Channel.h>
+#include <thread/SpscQueue.h>
+#include <thread/ConcurrentHashMap.h>
+#include <thread/Synchronization.h>
+#include <logging/Logger.h>
+
+using namespace rboc::utils::threading;
+
+namespace // Anonymous namespace for benchmark helpers
+{
+	//! Number of tasks submitted per benchmark iteration.
+	constexpr int kBatch = 1024;
+
+	//! Burns roughly `iterations` loop turns so tasks have a controllable size.
+	inline int spin(int iterations)
+	{
+		int acc = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			benchmark::DoNotOptimize(acc += i);
+		}
+		return acc;
+	}
+
+	//! Runs `producers` threads, each calling submit(n) for its share of kBatch tasks.
+	template<typename Submit>
+	void produce(int producers, Submit submit)
+	{
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p)
+		{
+			threads.emplace_back([&submit, producers] { submit(kBatch / producers); });
+		}
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+	}
+
+	void setThroughput(benchmark::State& state)
+	{
+		state.SetItemsProcessed(state.iterations() * kBatch);
+	}
+
+	// Argument grids. Apply is used instead of ArgsProduct to stay compatible with benchmark 1.3.
+	void producerWorkGrid(benchmark::internal::Benchmark* b)
+	{
+		for (int producers : {1, 2, 4, 8})
+			for (int work : {0, 100, 1000})
+				b->Args({producers, work});
+	}
+
+	void poolGrid(benchmark::internal::Benchmark* b)
+	{
+		for (int producers : {1, 4})
+			for (int workers : {1, 2, 4, 8})
+				for (int work : {0, 1000})
+					b->Args({producers, workers, work});
+	}
+
+	void poolPayloadGrid(benchmark::internal::Benchmark* b)
+	{
+		for (int producers : {1, 4})
+			for (int workers : {1, 2, 4, 8})
+				b->Args({producers, workers, 0});
+	}
+}
+
+//! Submission throughput of ActiveWorker<void>: producers x task size.
+static void BM_ActiveWorkerVoid_Throughput(benchmark::State& state)
+{
+	const int producers = static_cast<int>(state.range(0));
+	const int work = static_cast<int>(state.range(1));
+	ActiveWorker<void> worker;
+	for (auto _ : state)
+	{
+		produce(producers, [&](int n)
+		{
+			std::future<void> last;
+			for (int i = 0; i < n; ++i)
+			{
+				last = worker.addWork([work]{ spin(work); });
+			}
+			last.get();
+		});
+	}
+	setThroughput(state);
+}
+BENCHMARK(BM_ActiveWorkerVoid_Throughput)
+	->ArgNames({"producers", "work"})
+	->Apply(producerWorkGrid)
+	->UseRealTime();
+
+//! Submission throughput of ActiveWorker<int, int>, the argument-forwarding path.
+static void BM_ActiveWorkerIntInt_Throughput(benchmark::State& state)
+{
+	const int producers = static_cast<int>(state.range(0));
+	ActiveWorker<int, int> worker;
+	for (auto _ : state)
+	{
+		produce(producers, [&](int n)
+		{
+			std::future<int> last;
+			for (int i = 0; i < n; ++i)
+			{
+				last = worker.addWork([](int v){ return v + 1; }, i);
+			}
+			benchmark::DoNotOptimize(last.get());
+		});
+	}
+	setThroughput(state);
+}
+BENCHMARK(BM_ActiveWorkerIntInt_Throughput)->ArgName("producers")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+//! Submission throughput of ThreadPool<void> with a captured payload of Payload bytes.
+template<size_t Payload>
+static void BM_ThreadPoolVoid_Throughput(benchmark::State& state)
+{
+	const int producers = static_cast<int>(state.range(0));
+	const size_t workers = static_cast<size_t>(state.range(1));
+	const int work = static_cast<int>(state.range(2));
+	ThreadPool<void> pool{workers};
+	std::array<char, Payload> payload{};
+	for (auto _ : state)
+	{
+		produce(producers, [&](int n)
+		{
+			std::vector<std::future<void>> results;
+			results.reserve(n);
+			for (int i = 0; i < n; ++i)
+			{
+				results.emplace_back(pool.addTask([payload, work]{ benchmark::DoNotOptimize(payload); spin(work); }));
+			}
+			for (auto& result : results)
+			{
+				result.get();
+			}
+		});
+	}
+	setThroughput(state);
+}
+BENCHMARK_TEMPLATE(BM_ThreadPoolVoid_Throughput, 8)
+	->ArgNames({"producers", "workers", "work"})
+	->Apply(poolGrid)
+	->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ThreadPoolVoid_Throughput, 256)
+	->ArgNames({"producers", "workers", "work"})
+	->Apply(poolPayloadGrid)
+	->UseRealTime();
+
+//! Fork and join of a batch of tasks through a vector of futures.
+static void BM_ThreadPoolVoid_ForkJoinFutures(benchmark::State& state)
+{
+	ThreadPool<void> pool{static_cast<size_t>(state.range(0))};
+	std::vector<std::future<void>> results;
+	for (auto _ : state)
+	{
+		results.clear();
+		for (int i = 0; i < 1000; ++i)
+		{
+			results.emplace_back(pool.addTask([]{}));
+		}
+		for (auto& result : results)
+		{
+			result.get();
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_ThreadPoolVoid_ForkJoinFutures)->ArgName("workers")->Arg(1)->Arg(4)->UseRealTime();
+
+//! Same batch joined with a TaskGroup.
+static void BM_ThreadPoolVoid_ForkJoinTaskGroup(benchmark::State& state)
+{
+	ThreadPool<void> pool{static_cast<size_t>(state.range(0))};
+	TaskGroup group{pool};
+	for (auto _ : state)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			group.run([]{});
+		}
+		group.wait();
+	}
+	state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_ThreadPoolVoid_ForkJoinTaskGroup)->ArgName("workers")->Arg(1)->Arg(4)->UseRealTime();
+
+static long serialFib(int n)
+{
+	return n < 2 ? n : serialFib(n - 1) + serialFib(n - 2);
+}
+
+static long forkJoinFib(ForkJoin& fj, int n)
+{
+	if (n < 16)
+	{
+		return serialFib(n);
+	}
+	long a = 0, b = 0;
+	fj.invoke([&]{ a = forkJoinFib(fj, n - 1); }, [&]{ b = forkJoinFib(fj, n - 2); });
+	return a + b;
+}
+
+//! Recursive divide and conquer with ForkJoin spawn/sync.
+static void BM_ForkJoin_Fib(benchmark::State& state)
+{
+	ThreadPool<void> pool{static_cast<size_t>(state.range(0))};
+	ForkJoin fj{pool};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(forkJoinFib(fj, 30));
+	}
+}
+BENCHMARK(BM_ForkJoin_Fib)->ArgName("workers")->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+//! Serial baseline for BM_ForkJoin_Fib.
+static void BM_SerialFib(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(serialFib(30));
+	}
+}
+BENCHMARK(BM_SerialFib);
+
+static std::vector<uint32_t> randomValues(size_t n)
+{
+	std::mt19937 rng(7);
+	std::vector<uint32_t> values(n);
+	for (auto& value : values)
+	{
+		value = rng();
+	}
+	return values;
+}
+
+//! parallel::sort of one million integers.
+static void BM_ParallelSort(benchmark::State& state)
+{
+	ThreadPool<void> pool{static_cast<size_t>(state.range(0))};
+	const auto input = randomValues(1 << 20);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		auto values = input;
+		state.ResumeTiming();
+		parallel::sort(pool, values.begin(), values.end());
+		benchmark::DoNotOptimize(values.data());
+	}
+	state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_ParallelSort)->ArgName("workers")->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+//! std::sort baseline for BM_ParallelSort.
+static void BM_StdSort(benchmark::State& state)
+{
+	const auto input = randomValues(1 << 20);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		auto values = input;
+		state.ResumeTiming();
+		std::sort(values.begin(), values.end());
+		benchmark::DoNotOptimize(values.data());
+	}
+	state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_StdSort)->UseRealTime();
+
+//! Items moved through a Channel of capacity 256 by `producers` senders and one receiver.
+static void BM_Channel_Throughput(benchmark::State& state)
+{
+	const int producers = static_cast<int>(state.range(0));
+	Channel<int> channel{256};
+	for (auto _ : state)
+	{
+		std::thread receiver([&channel]
+		{
+			int item = 0;
+			for (int i = 0; i < kBatch; ++i)
+			{
+				channel.recv(item);
+			}
+		});
+		produce(producers, [&channel](int n)
+		{
+			for (int i = 0; i < n; ++i)
+			{
+				channel.send(i);
+			}
+		});
+		receiver.join();
+	}
+	setThroughput(state);
+}
+BENCHMARK(BM_Channel_Throughput)->ArgName("producers")->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+//! 1:1 handoff through an SpscQueue: operations per second of one producer and one consumer.
+static void BM_SpscQueue_Handoff(benchmark::State& state)
+{
+	const size_t count = 1 << 20;
+	SpscQueue<size_t> queue{1024};
+	for (auto _ : state)
+	{
+		std::thread consumer([&queue, count]
+		{
+			size_t item = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				for (int spins = 0; !queue.tryPop(item); ++spins)
+				{
+					if (spins > 1000) std::this_thread::yield(); // Only matters without a free core.
+				}
+			}
+			benchmark::DoNotOptimize(item);
+		});
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int spins = 0; !queue.tryPush(std::move(i)); ++spins)
+			{
+				if (spins > 1000) std::this_thread::yield();
+			}
+		}
+		consumer.join();
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SpscQueue_Handoff)->UseRealTime();
+
+namespace // Anonymous namespace for lookup table benchmarks
+{
+	//! The baseline: an unordered_map behind one mutex.
+	class MutexMap
+	{
+		public:
+
+		bool find(int key, int& value) const
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			auto found = _map.find(key);
+			if (found == _map.end()) return false;
+			value = found->second;
+			return true;
+		}
+
+		void insertOrAssign(int key, int value)
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			_map[key] = value;
+		}
+
+		private:
+
+		mutable std::mutex _mtx;
+		std::unordered_map<int, int> _map;
+	};
+
+	class StripedMap
+	{
+		public:
+
+		bool find(int key, int& value) const
+		{
+			auto found = _map.find(key);
+			if (!found) return false;
+			value = *found;
+			return true;
+		}
+
+		void insertOrAssign(int key, int value)
+		{
+			_map.insertOrAssign(key, value);
+		}
+
+		private:
+
+		ConcurrentHashMap<int, int> _map;
+	};
+
+	constexpr int kLookupKeys = 4096;
+	constexpr int kLookupsPerThread = 1 << 16;
+
+	//! `threads` threads doing lookups on a shared table, one write every `write_every` operations.
+	template<typename Map>
+	void lookupTable(benchmark::State& state)
+	{
+		const int threads = static_cast<int>(state.range(0));
+		const int write_every = static_cast<int>(state.range(1));
+		Map map;
+		for (int key = 0; key < kLookupKeys; ++key)
+		{
+			map.insertOrAssign(key, key);
+		}
+		for (auto _ : state)
+		{
+			std::vector<std::thread> workers;
+			for (int t = 0; t < threads; ++t)
+			{
+				workers.emplace_back([&map, t, write_every]
+				{
+					int value = 0;
+					uint32_t key = static_cast<uint32_t>(t) * 7919u;
+					for (int i = 0; i < kLookupsPerThread; ++i)
+					{
+						key = key * 1664525u + 1013904223u;
+						auto slot = static_cast<int>(key % kLookupKeys);
+						if (write_every > 0 && i % write_every == 0)
+						{
+							map.insertOrAssign(slot, i);
+						}
+						else
+						{
+							benchmark::DoNotOptimize(map.find(slot, value));
+						}
+					}
+				});
+			}
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * threads * kLookupsPerThread);
+	}
+
+	void lookupGrid(benchmark::internal::Benchmark* b)
+	{
+		for (int threads : {1, 2, 4, 8})
+			for (int write_every : {0, 10})
+				b->Args({threads, write_every});
+	}
+}
+
+//! Shared lookup table: ConcurrentHashMap, lock-free reads and striped writes.
+static void BM_ConcurrentHashMap_Lookup(benchmark::State& state)
+{
+	lookupTable<StripedMap>(state);
+}
+BENCHMARK(BM_ConcurrentHashMap_Lookup)->Apply(lookupGrid)->ArgNames({"threads", "write_every"})->UseRealTime();
+
+//! Shared lookup table: the std::mutex + std::unordered_map baseline.
+static void BM_MutexMap_Lookup(benchmark::State& state)
+{
+	lookupTable<MutexMap>(state);
+}
+BENCHMARK(BM_MutexMap_Lookup)->Apply(lookupGrid)->ArgNames({"threads", "write_every"})->UseRealTime();
+
+//! `threads` threads counting events on one shared atomic.
+static void BM_SharedAtomic_Increment(benchmark::State& state)
+{
+	const int threads = static_cast<int>(state.range(0));
+	const int increments = 1 << 18;
+	std::atomic<int64_t> counter{0};
+	for (auto _ : state)
+	{
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&counter, increments]
+			{
+				for (int i = 0; i < increments; ++i)
+				{
+					counter.fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+	benchmark::DoNotOptimize(counter.load());
+	state.SetItemsProcessed(state.iterations() * threads * increments);
+}
+BENCHMARK(BM_SharedAtomic_Increment)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+//! `threads` threads counting events on a ShardedCounter.
+static void BM_ShardedCounter_Increment(benchmark::State& state)
+{
+	const int threads = static_cast<int>(state.range(0));
+	const int increments = 1 << 18;
+	rboc::utils::metrics::ShardedCounter counter;
+	for (auto _ : state)
+	{
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&counter, increments]
+			{
+				for (int i = 0; i < increments; ++i)
+				{
+					counter.increment();
+				}
+			});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+	benchmark::DoNotOptimize(counter.value());
+	state.SetItemsProcessed(state.iterations() * threads * increments);
+}
+BENCHMARK(BM_ShardedCounter_Increment)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+//! Submission throughput of ActiveWorker<void> in single producer mode.
+static void BM_ActiveWorkerVoid_SingleProducer(benchmark::State& state)
+{
+	ActiveWorker<void> worker{SingleProducer{4096}};
+	std::vector<std::future<void>> results;
+	results.reserve(kBatch);
+	for (auto _ : state)
+	{
+		results.clear();
+		for (int i = 0; i < kBatch; ++i)
+		{
+			results.emplace_back(worker.addWork(std::allocator_arg, TaskAllocator<char>{}, []{}));
+		}
+		for (auto& result : results)
+		{
+			result.get();
+		}
+	}
+	setThroughput(state);
+}
+BENCHMARK(BM_ActiveWorkerVoid_SingleProducer)->UseRealTime();
+
+//! Same as BM_ActiveWorkerVoid_SingleProducer through the locked queue.
+static void BM_ActiveWorkerVoid_LockedQueue(benchmark::State& state)
+{
+	ActiveWorker<void> worker;
+	std::vector<std::future<void>> results;
+	results.reserve(kBatch);
+	for (auto _ : state)
+	{
+		results.clear();
+		for (int i = 0; i < kBatch; ++i)
+		{
+			results.emplace_back(worker.addWork(std::allocator_arg, TaskAllocator<char>{}, []{}));
+		}
+		for (auto& result : results)
+		{
+			result.get();
+		}
+	}
+	setThroughput(state);
+}
+BENCHMARK(BM_ActiveWorkerVoid_LockedQueue)->UseRealTime();
+
+//! End-to-end latency: submit one task and block on its future.
+static void BM_ActiveWorkerInt_RoundTrip(benchmark::State& state)
+{
+	ActiveWorker<int> worker;
+	int value = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(worker.addWork([&value]{ return ++value; }).get());
+	}
+}
+BENCHMARK(BM_ActiveWorkerInt_RoundTrip)->UseRealTime();
+
+//! End-to-end latency through a ThreadPool<void>.
+static void BM_ThreadPoolVoid_RoundTrip(benchmark::State& state)
+{
+	ThreadPool<void> pool{static_cast<size_t>(state.range(0))};
+	for (auto _ : state)
+	{
+		pool.addTask([]{}).get();
+	}
+}
+BENCHMARK(BM_ThreadPoolVoid_RoundTrip)->ArgName("workers")->Arg(1)->Arg(4)->UseRealTime();
+
+//! Cost of creating, running and resolving a packaged_task future without any queue.
+static void BM_FutureResolution(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		std::packaged_task<int()> task{[]{ return 1; }};
+		auto result = task.get_future();
+		task();
+		benchmark::DoNotOptimize(result.get());
+	}
+}
+BENCHMARK(BM_FutureResolution);
+
+//! Same as BM_FutureResolution with the task and shared state coming from TaskAllocator.
+static void BM_FutureResolution_TaskAllocator(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		std::packaged_task<int()> task{std::allocator_arg, TaskAllocator<char>{}, []{ return 1; }};
+		auto result = task.get_future();
+		task();
+		benchmark::DoNotOptimize(result.get());
+	}
+}
+BENCHMARK(BM_FutureResolution_TaskAllocator);
+
+//! A barrier built from a mutex and a condition variable, the way it is done without C++20.
+class CondVarBarrier
+{
+	public:
+
+	explicit CondVarBarrier(size_t parties)
+		: _parties(parties)
+		, _remaining(parties)
+	{}
+
+	void arriveAndWait()
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		auto phase = _phase;
+		if (--_remaining == 0)
+		{
+			_remaining = _parties;
+			++_phase;
+			_cond.notify_all();
+			return;
+		}
+		_cond.wait(lock, [this, phase]{ return _phase != phase; });
+	}
+
+	private:
+
+	std::mutex _mtx;
+	std::condition_variable _cond;
+	const size_t _parties;
+	size_t _remaining;
+	uint64_t _phase = 0;
+};
+
+//! `threads` threads crossing a barrier `phases` times.
+template<typename BarrierType>
+static void runBarrierPhases(benchmark::State& state)
+{
+	const int threads = static_cast<int>(state.range(0));
+	const int phases = 1000;
+	for (auto _ : state)
+	{
+		BarrierType barrier(threads);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&barrier, phases]
+			{
+				for (int i = 0; i < phases; ++i)
+				{
+					barrier.arriveAndWait();
+				}
+			});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * phases);
+}
+
+static void BM_CondVarBarrier_Phases(benchmark::State& state)
+{
+	runBarrierPhases<CondVarBarrier>(state);
+}
+BENCHMARK(BM_CondVarBarrier_Phases)->ArgName("threads")->Arg(2)->Arg(4)->UseRealTime();
+
+static void BM_FutexBarrier_Phases(benchmark::State& state)
+{
+	runBarrierPhases<Barrier>(state);
+}
+BENCHMARK(BM_FutexBarrier_Phases)->ArgName("threads")->Arg(2)->Arg(4)->UseRealTime();
+
+//! Two threads passing a token back and forth through a pair of futex semaphores.
+static void BM_FutexSemaphore_PingPong(benchmark::State& state)
+{
+	const int rounds = 1000;
+	for (auto _ : state)
+	{
+		CountingSemaphore ping{0};
+		CountingSemaphore pong{0};
+		std::thread other([&ping, &pong, rounds]
+		{
+			for (int i = 0; i < rounds; ++i)
+			{
+				ping.acquire();
+				pong.release();
+			}
+		});
+		for (int i = 0; i < rounds; ++i)
+		{
+			ping.release();
+			pong.acquire();
+		}
+		other.join();
+	}
+	state.SetItemsProcessed(state.iterations() * rounds);
+}
+BENCHMARK(BM_FutexSemaphore_PingPong)->UseRealTime();
+
+//! `threads` threads logging through a locked std::ostream, as `std::cout` does.
+static void BM_SyncStream_Log(benchmark::State& state)
+{
+	const int threads = static_cast<int>(state.range(0));
+	const int messages = 1 << 12;
+	std::ofstream out("/dev/null");
+	std::mutex mtx;
+	for (auto _ : state)
+	{
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&out, &mtx, t, messages]
+			{
+				for (int i = 0; i < messages; ++i)
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					out << "thread " << t << " message " << i << " value " << 1.5 << std::endl;
+				}
+			});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * threads * messages);
+}
+BENCHMARK(BM_SyncStream_Log)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime();
+
+//! `threads` threads logging through the asynchronous Logger. Only the log calls are timed.
+static void BM_AsyncLogger_Log(benchmark::State& state)
+{
+	const int threads = static_cast<int>(state.range(0));
+	const int messages = 1 << 12;
+	FILE* null = std::fopen("/dev/null", "w");
+	rboc::utils::logging::Logger log{std::make_shared<rboc::utils::logging::FileSink>(fileno(null)), 1 << 14};
+	for (auto _ : state)
+	{
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&log, t, messages]
+			{
+				for (int i = 0; i < messages; ++i)
+				{
+					log.info("thread {} message {} value {}", t, i, 1.5);
+				}
+			});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * threads * messages);
+	log.flush();
+	std::fclose(null);
+}
+BENCHMARK(BM_AsyncLogger_Log)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
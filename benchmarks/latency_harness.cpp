@@ -0,0 +1,173 @@
+// Tail-latency harness for pool dispatch.
+//
+// An open-loop generator submits bursts of tasks on a fixed schedule. Every task
+// records the time from its *intended* submission time to the moment it starts
+// running. Using the intended time, rather than the time addTask was actually
+// called, keeps coordinated omission out of the results: when the pool falls
+// behind, the generator does not slow down and the backlog shows up as latency.
+//
+// Usage: latency_harness [--rate tasks_per_second] [--burst tasks] [--seconds s]
+//                        [--workers n] [--work spins] [--dump]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <common/Histogram.h>
+#include <thread/ActiveWorker.h>
+#include <thread/Threadpool.h>
+
+using namespace rboc::utils;
+using namespace rboc::utils::threading;
+
+namespace // Anonymous namespace for harness helpers
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		double rate = 100000.0; // Tasks per second.
+		int burst = 64;         // Tasks submitted back to back at every tick.
+		double seconds = 3.0;
+		size_t workers = std::max(1u, std::thread::hardware_concurrency());
+		int work = 100;         // Spin iterations per task.
+		bool dump = false;
+	};
+
+	Options parseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; ++i)
+		{
+			auto next = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : "0"; };
+			if (!std::strcmp(argv[i], "--rate")) options.rate = std::atof(next());
+			else if (!std::strcmp(argv[i], "--burst")) options.burst = std::max(1, std::atoi(next()));
+			else if (!std::strcmp(argv[i], "--seconds")) options.seconds = std::atof(next());
+			else if (!std::strcmp(argv[i], "--workers")) options.workers = std::max(1, std::atoi(next()));
+			else if (!std::strcmp(argv[i], "--work")) options.work = std::atoi(next());
+			else if (!std::strcmp(argv[i], "--dump")) options.dump = true;
+			else
+			{
+				std::cerr << "usage: " << argv[0]
+					<< " [--rate n] [--burst n] [--seconds s] [--workers n] [--work n] [--dump]\n";
+				std::exit(1);
+			}
+		}
+		return options;
+	}
+
+	int spin(int iterations)
+	{
+		volatile int acc = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			acc = acc + i;
+		}
+		return acc;
+	}
+
+	//! Runs the open-loop schedule. submit(intended, slot) must queue a task that
+	//! stores its dispatch latency in latencies[slot]; it returns the task future.
+	template<typename Submit>
+	metrics::HdrHistogram run(const Options& options, Submit submit)
+	{
+		const auto ticks = static_cast<size_t>(options.rate * options.seconds / options.burst);
+		const auto interval = std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(options.burst / options.rate));
+		std::vector<uint64_t> latencies(ticks * options.burst, 0);
+		std::vector<std::future<void>> pending;
+		pending.reserve(latencies.size());
+
+		auto start = Clock::now() + std::chrono::milliseconds(10);
+		for (size_t tick = 0; tick < ticks; ++tick)
+		{
+			auto intended = start + interval * tick;
+			std::this_thread::sleep_until(intended); // Returns at once when we are behind.
+			for (int i = 0; i < options.burst; ++i)
+			{
+				auto slot = tick * options.burst + i;
+				pending.emplace_back(submit(intended, &latencies[slot]));
+			}
+		}
+		for (auto& fut : pending)
+		{
+			fut.get();
+		}
+
+		metrics::HdrHistogram hist;
+		for (auto latency : latencies)
+		{
+			hist.record(latency);
+		}
+		return hist;
+	}
+
+	uint64_t sinceNs(Clock::time_point intended)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended).count());
+	}
+
+	void report(const std::string& name, const metrics::HdrHistogram& hist, bool dump)
+	{
+		std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(2);
+		for (double p : {50.0, 90.0, 99.0, 99.9, 99.99})
+		{
+			std::cout << std::setw(12) << hist.valueAtPercentile(p) / 1000.0;
+		}
+		std::cout << std::setw(12) << hist.max() / 1000.0 << std::setw(12) << hist.count() << '\n';
+		if (dump)
+		{
+			std::cout << "# " << name << " dispatch latency histogram (us)\n";
+			hist.dump(std::cout, 1000.0);
+			std::cout << '\n';
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto options = parseOptions(argc, argv);
+	std::cout << "# rate=" << options.rate << "/s burst=" << options.burst << " seconds=" << options.seconds
+		<< " workers=" << options.workers << " work=" << options.work << "\n";
+	std::cout << "# dispatch latency (us) from intended submission to task start\n";
+	std::cout << std::left << std::setw(28) << "target" << std::right;
+	for (const char* column : {"p50", "p90", "p99", "p99.9", "p99.99", "max", "count"})
+	{
+		std::cout << std::setw(12) << column;
+	}
+	std::cout << '\n';
+
+	const int work = options.work;
+	{
+		ActiveWorker<void> worker;
+		auto hist = run(options, [&](Clock::time_point intended, uint64_t* latency)
+		{
+			return worker.addWork([intended, latency, work]{ *latency = sinceNs(intended); spin(work); });
+		});
+		report("ActiveWorker<void>", hist, options.dump);
+	}
+	{
+		ActiveWorker<void, uint64_t*> worker;
+		auto hist = run(options, [&](Clock::time_point intended, uint64_t* latency)
+		{
+			return worker.addWork([intended, work](uint64_t* out){ *out = sinceNs(intended); spin(work); }, latency);
+		});
+		report("ActiveWorker<void, ptr>", hist, options.dump);
+	}
+	for (size_t workers = 1; workers <= options.workers; workers *= 2)
+	{
+		ThreadPool<void> pool{workers};
+		auto hist = run(options, [&](Clock::time_point intended, uint64_t* latency)
+		{
+			return pool.addTask([intended, latency, work]{ *latency = sinceNs(intended); spin(work); });
+		});
+		report("ThreadPool<void>[" + std::to_string(workers) + "]", hist, options.dump);
+	}
+	return 0;
+}
@@ -0,0 +1,222 @@
+// Core-count scalability matrix for ThreadPool.
+//
+// Sweeps worker counts from 1 to hardware_concurrency and producer counts over a
+// grid, for empty, CPU-bound and memory-bound tasks, and prints one CSV row per
+// configuration with throughput, speedup over one worker, parallel efficiency and
+// the voluntary/involuntary context switches measured with getrusage.
+//
+// Usage: scalability [--tasks n] [--max-workers n] [--max-producers n] [--out file.csv]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <thread/Threadpool.h>
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#endif
+
+using namespace rboc::utils::threading;
+
+namespace // Anonymous namespace for driver helpers
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		size_t tasks = 200000;
+		size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+		size_t max_producers = 4;
+		std::string out;
+	};
+
+	Options parseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; ++i)
+		{
+			auto next = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : "0"; };
+			if (!std::strcmp(argv[i], "--tasks")) options.tasks = std::max(1, std::atoi(next()));
+			else if (!std::strcmp(argv[i], "--max-workers")) options.max_workers = std::max(1, std::atoi(next()));
+			else if (!std::strcmp(argv[i], "--max-producers")) options.max_producers = std::max(1, std::atoi(next()));
+			else if (!std::strcmp(argv[i], "--out")) options.out = next();
+			else
+			{
+				std::cerr << "usage: " << argv[0] << " [--tasks n] [--max-workers n] [--max-producers n] [--out file.csv]\n";
+				std::exit(1);
+			}
+		}
+		return options;
+	}
+
+	//! Context switches of the whole process so far.
+	struct ContextSwitches
+	{
+		long voluntary = 0;
+		long involuntary = 0;
+	};
+
+	ContextSwitches contextSwitches()
+	{
+		ContextSwitches result;
+#if defined(__unix__)
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+		{
+			result.voluntary = usage.ru_nvcsw;
+			result.involuntary = usage.ru_nivcsw;
+		}
+#endif
+		return result;
+	}
+
+	//! Kinds of tasks in the matrix.
+	enum class TaskKind { empty, cpu, memory };
+
+	const char* toString(TaskKind kind)
+	{
+		switch (kind)
+		{
+			case TaskKind::empty: return "empty";
+			case TaskKind::cpu: return "cpu";
+			case TaskKind::memory: return "memory";
+		}
+		return "unknown";
+	}
+
+	// Shared buffer, far larger than the last level cache, for memory-bound tasks.
+	std::vector<uint64_t>& memoryArena()
+	{
+		static std::vector<uint64_t> arena(size_t(64) << 20 >> 3, 1); // 64 MiB
+		return arena;
+	}
+
+	void runTask(TaskKind kind, size_t seed)
+	{
+		switch (kind)
+		{
+			case TaskKind::empty:
+				break;
+			case TaskKind::cpu:
+			{
+				volatile uint64_t acc = seed;
+				for (int i = 0; i < 2000; ++i) acc = acc * 6364136223846793005ull + 1442695040888963407ull;
+				break;
+			}
+			case TaskKind::memory:
+			{
+				// 64 dependent random cache-line reads.
+				auto& arena = memoryArena();
+				uint64_t index = seed * 2654435761ull;
+				volatile uint64_t acc = 0;
+				for (int i = 0; i < 64; ++i)
+				{
+					index = (index * 6364136223846793005ull + arena[index % arena.size()]) >> 7;
+					acc = acc + index;
+				}
+				break;
+			}
+		}
+	}
+
+	struct Result
+	{
+		double seconds;
+		ContextSwitches switches;
+	};
+
+	Result measure(TaskKind kind, size_t workers, size_t producers, size_t tasks)
+	{
+		ThreadPool<void> pool{workers};
+		auto before = contextSwitches();
+		auto start = Clock::now();
+		std::vector<std::thread> threads;
+		for (size_t p = 0; p < producers; ++p)
+		{
+			threads.emplace_back([&pool, kind, p, producers, tasks]
+			{
+				std::vector<std::future<void>> results;
+				results.reserve(tasks / producers + 1);
+				for (size_t i = p; i < tasks; i += producers)
+				{
+					results.emplace_back(pool.addTask([kind, i]{ runTask(kind, i); }));
+				}
+				for (auto& result : results)
+				{
+					result.get();
+				}
+			});
+		}
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+		std::chrono::duration<double> elapsed = Clock::now() - start;
+		auto after = contextSwitches();
+		Result result;
+		result.seconds = elapsed.count();
+		result.switches.voluntary = after.voluntary - before.voluntary;
+		result.switches.involuntary = after.involuntary - before.involuntary;
+		return result;
+	}
+
+	//! 1, 2, 4, ... up to max, always including max itself.
+	std::vector<size_t> powersUpTo(size_t max)
+	{
+		std::vector<size_t> values;
+		for (size_t v = 1; v < max; v *= 2)
+		{
+			values.push_back(v);
+		}
+		values.push_back(max);
+		return values;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto options = parseOptions(argc, argv);
+	std::ofstream file;
+	if (!options.out.empty())
+	{
+		file.open(options.out);
+		if (!file)
+		{
+			std::cerr << "cannot open " << options.out << '\n';
+			return 1;
+		}
+	}
+	std::ostream& out = options.out.empty() ? std::cout : file;
+
+	memoryArena(); // Touch the arena before measuring.
+	out << "task,producers,workers,tasks,seconds,throughput,speedup,efficiency,voluntary_csw,involuntary_csw\n";
+	for (auto kind : {TaskKind::empty, TaskKind::cpu, TaskKind::memory})
+	{
+		for (auto producers : powersUpTo(options.max_producers))
+		{
+			double baseline = 0.0;
+			for (auto workers : powersUpTo(options.max_workers))
+			{
+				auto result = measure(kind, workers, producers, options.tasks);
+				auto throughput = options.tasks / result.seconds;
+				if (workers == 1)
+				{
+					baseline = throughput;
+				}
+				auto speedup = throughput / baseline;
+				out << toString(kind) << ',' << producers << ',' << workers << ',' << options.tasks << ','
+					<< result.seconds << ',' << throughput << ',' << speedup << ',' << speedup / workers << ','
+					<< result.switches.voluntary << ',' << result.switches.involuntary << '\n';
+				out.flush();
+			}
+		}
+	}
+	return 0;
+}
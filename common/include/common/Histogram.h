@@ -0,0 +1,241 @@
+#pragma once
+#ifndef UTILS_HISTOGRAM_HEADER
+#define UTILS_HISTOGRAM_HEADER
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace rboc { namespace utils { namespace metrics
+{
+	//! class HdrHistogram
+	/**
+	 * A high dynamic range histogram in the spirit of HdrHistogram. Values from 1 to
+	 * a configurable maximum are recorded with a fixed number of significant decimal
+	 * digits using log-linear buckets, so recording is O(1), memory is small and
+	 * percentiles up to p99.99 and beyond keep their relative precision.
+	 *
+	 * It is not thread safe: record from one thread or merge per-thread histograms.
+	 */
+	class HdrHistogram
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param highest the highest value to be tracked. Larger values are clamped to it.
+		 * \param significant_digits the number of significant decimal digits, from 1 to 5.
+		 */
+		explicit HdrHistogram(uint64_t highest = 3600000000000ull, int significant_digits = 3)
+			: _highest(highest)
+			, _significant_digits(significant_digits)
+		{
+			if (highest < 2 || significant_digits < 1 || significant_digits > 5)
+			{
+				throw std::invalid_argument("invalid histogram range or precision");
+			}
+			auto largest_single_unit = 2 * static_cast<uint64_t>(std::pow(10.0, significant_digits));
+			_sub_bucket_count_magnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+			_sub_bucket_half_count_magnitude = _sub_bucket_count_magnitude - 1;
+			_sub_bucket_count = 1ull << _sub_bucket_count_magnitude;
+			_sub_bucket_half_count = _sub_bucket_count / 2;
+			_sub_bucket_mask = _sub_bucket_count - 1;
+
+			// Number of power of two buckets needed to cover highest.
+			uint64_t smallest_untrackable = _sub_bucket_count;
+			_bucket_count = 1;
+			while (smallest_untrackable <= highest)
+			{
+				if (smallest_untrackable > (UINT64_MAX >> 1))
+				{
+					++_bucket_count;
+					break;
+				}
+				smallest_untrackable <<= 1;
+				++_bucket_count;
+			}
+			_counts.assign(static_cast<size_t>((_bucket_count + 1) * _sub_bucket_half_count), 0);
+		}
+
+		//! record
+		/**
+		 * Records a value. Values of 0 count as 1 and values above highest are clamped.
+		 * \param value the value to record.
+		 * \param count how many times the value is recorded.
+		 */
+		void record(uint64_t value, uint64_t count = 1) noexcept
+		{
+			value = std::max<uint64_t>(1, std::min(value, _highest));
+			_counts[countsIndex(value)] += count;
+			_total += count;
+			_min = std::min(_min, value);
+			_max = std::max(_max, value);
+			_sum += static_cast<double>(value) * static_cast<double>(count);
+		}
+
+		//! merge
+		/**
+		 * Adds the counts of other, which must have the same range and precision.
+		 * \param other the histogram to add.
+		 */
+		void merge(const HdrHistogram& other)
+		{
+			if (other._counts.size() != _counts.size() || other._highest != _highest)
+			{
+				throw std::invalid_argument("histograms have different layouts");
+			}
+			for (size_t i = 0; i < _counts.size(); ++i)
+			{
+				_counts[i] += other._counts[i];
+			}
+			_total += other._total;
+			_min = std::min(_min, other._min);
+			_max = std::max(_max, other._max);
+			_sum += other._sum;
+		}
+
+		//! reset
+		/**
+		 * Clears every recorded value.
+		 */
+		void reset() noexcept
+		{
+			std::fill(_counts.begin(), _counts.end(), 0);
+			_total = 0;
+			_min = UINT64_MAX;
+			_max = 0;
+			_sum = 0.0;
+		}
+
+		//! count
+		uint64_t count() const noexcept { return _total; }
+
+		//! min
+		uint64_t min() const noexcept { return _total == 0 ? 0 : _min; }
+
+		//! max
+		uint64_t max() const noexcept { return _max; }
+
+		//! mean
+		double mean() const noexcept { return _total == 0 ? 0.0 : _sum / static_cast<double>(_total); }
+
+		//! valueAtPercentile
+		/**
+		 * \param percentile the percentile, from 0 to 100.
+		 * \return the highest value equivalent to the one at the requested percentile.
+		 */
+		uint64_t valueAtPercentile(double percentile) const noexcept
+		{
+			if (_total == 0)
+			{
+				return 0;
+			}
+			percentile = std::min(std::max(percentile, 0.0), 100.0);
+			auto wanted = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(_total) + 0.5);
+			wanted = std::max<uint64_t>(wanted, 1);
+			uint64_t cumulative = 0;
+			for (size_t i = 0; i < _counts.size(); ++i)
+			{
+				cumulative += _counts[i];
+				if (cumulative >= wanted)
+				{
+					return std::min(highestEquivalentValue(valueFromIndex(i)), _max);
+				}
+			}
+			return _max;
+		}
+
+		//! dump
+		/**
+		 * Writes one line per non-empty bucket: bucket upper value (scaled),
+		 * cumulative percentile, bucket count and cumulative count.
+		 * \param out the stream to write to.
+		 * \param scale the values are divided by it, i.e. 1000 to print ns as us.
+		 */
+		void dump(std::ostream& out, double scale = 1.0) const
+		{
+			out << std::setw(14) << "Value" << std::setw(14) << "Percentile"
+				<< std::setw(12) << "Count" << std::setw(14) << "TotalCount" << '\n';
+			uint64_t cumulative = 0;
+			for (size_t i = 0; i < _counts.size(); ++i)
+			{
+				if (_counts[i] == 0) continue;
+				cumulative += _counts[i];
+				out << std::setw(14) << std::fixed << std::setprecision(3)
+					<< static_cast<double>(highestEquivalentValue(valueFromIndex(i))) / scale
+					<< std::setw(14) << std::setprecision(6) << static_cast<double>(cumulative) / static_cast<double>(_total)
+					<< std::setw(12) << _counts[i] << std::setw(14) << cumulative << '\n';
+			}
+			out << "#[Mean = " << std::setprecision(3) << mean() / scale << ", Max = " << static_cast<double>(_max) / scale
+				<< ", Total count = " << _total << "]\n";
+		}
+
+		private:
+
+		static int log2Floor(uint64_t value) noexcept
+		{
+			int result = 0;
+			while (value >>= 1)
+			{
+				++result;
+			}
+			return result;
+		}
+
+		int bucketIndex(uint64_t value) const noexcept
+		{
+			auto pow2ceiling = log2Floor(value | _sub_bucket_mask) + 1;
+			return pow2ceiling - (_sub_bucket_half_count_magnitude + 1);
+		}
+
+		size_t countsIndex(uint64_t value) const noexcept
+		{
+			auto bucket = bucketIndex(value);
+			auto sub_bucket = value >> bucket;
+			return static_cast<size_t>((static_cast<uint64_t>(bucket + 1) << _sub_bucket_half_count_magnitude)
+				+ (sub_bucket - _sub_bucket_half_count));
+		}
+
+		uint64_t valueFromIndex(size_t index) const noexcept
+		{
+			auto bucket = static_cast<int>(index >> _sub_bucket_half_count_magnitude) - 1;
+			auto sub_bucket = (index & (_sub_bucket_half_count - 1)) + _sub_bucket_half_count;
+			if (bucket < 0)
+			{
+				sub_bucket -= _sub_bucket_half_count;
+				bucket = 0;
+			}
+			return static_cast<uint64_t>(sub_bucket) << bucket;
+		}
+
+		uint64_t highestEquivalentValue(uint64_t value) const noexcept
+		{
+			auto bucket = bucketIndex(value);
+			auto sub_bucket = value >> bucket;
+			auto adjusted_bucket = (sub_bucket >= _sub_bucket_count) ? bucket + 1 : bucket;
+			auto lowest = sub_bucket << bucket;
+			return lowest + (1ull << adjusted_bucket) - 1;
+		}
+
+		// Private members.
+		uint64_t _highest;
+		int _significant_digits;
+		int _sub_bucket_count_magnitude = 0;
+		int _sub_bucket_half_count_magnitude = 0;
+		uint64_t _sub_bucket_count = 0;
+		uint64_t _sub_bucket_half_count = 0;
+		uint64_t _sub_bucket_mask = 0;
+		int _bucket_count = 0;
+		std::vector<uint64_t> _counts;
+		uint64_t _total = 0;
+		uint64_t _min = UINT64_MAX;
+		uint64_t _max = 0;
+		double _sum = 0.0;
+	};
+
+}}} // namespace rboc::utils::metrics
+#endif
@@ -0,0 +1,396 @@
+#pragma once
+#ifndef UTILS_METRICS_HEADER
+#define UTILS_METRICS_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <common/Histogram.h>
+#include <common/Utility.h>
+
+namespace rboc { namespace utils { namespace metrics
+{
+	namespace details
+	{
+		//! Hands out thread ordinals, lowest free first, and takes them back.
+		class ShardRegistry
+		{
+			public:
+
+			size_t acquire()
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				if (_free.empty())
+				{
+					_free.reserve(_next + 1); // So release, run at thread exit, never allocates.
+					return _next++;
+				}
+				std::pop_heap(_free.begin(), _free.end(), std::greater<size_t>());
+				auto ordinal = _free.back();
+				_free.pop_back();
+				return ordinal;
+			}
+
+			void release(size_t ordinal) noexcept
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				_free.push_back(ordinal);
+				std::push_heap(_free.begin(), _free.end(), std::greater<size_t>());
+			}
+
+			private:
+
+			std::mutex _mtx;
+			size_t _next = 0;
+			std::vector<size_t> _free; // A min-heap of the ordinals of exited threads.
+		};
+
+		//! Never destroyed: threads may exit after static destruction began.
+		inline ShardRegistry& shardRegistry()
+		{
+			static ShardRegistry* registry = new ShardRegistry;
+			return *registry;
+		}
+
+		//! The ordinal of a thread, given back when the thread exits.
+		struct ThreadOrdinal
+		{
+			ThreadOrdinal()
+				: value(shardRegistry().acquire())
+			{}
+
+			~ThreadOrdinal()
+			{
+				shardRegistry().release(value);
+			}
+
+			const size_t value;
+		};
+
+		//! The shard the calling thread writes to. A thread takes the lowest free
+		//! ordinal when it first records and gives it back when it exits, so live
+		//! threads never share a shard unless more than shards() of them were
+		//! live at once, however many short-lived threads came and went before.
+		inline size_t threadShard() noexcept
+		{
+			static thread_local ThreadOrdinal ordinal;
+			return ordinal.value;
+		}
+
+		//! One shard per hardware thread, rounded up to a power of two.
+		inline size_t defaultShardCount() noexcept
+		{
+			size_t threads = std::thread::hardware_concurrency();
+			size_t shards = 1;
+			while (shards < threads)
+			{
+				shards <<= 1;
+			}
+			return shards;
+		}
+
+		inline size_t checkedShardCount(size_t shards)
+		{
+			if (shards == 0)
+			{
+				throw std::invalid_argument("shard count must be positive");
+			}
+			size_t result = 1;
+			while (result < shards)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		//! A value with a cache line of its own (the padding follows it in the array).
+		struct CounterCell
+		{
+			std::atomic<int64_t> value{0};
+			char padding[utilities::kCacheLineSize];
+		};
+
+		//! The cells of a sharded counter or gauge.
+		class CounterCells
+		{
+			public:
+
+			explicit CounterCells(size_t shards)
+				: _mask(checkedShardCount(shards) - 1)
+				, _cells(new CounterCell[_mask + 1])
+			{}
+
+			void add(int64_t delta) noexcept
+			{
+				_cells[threadShard() & _mask].value.fetch_add(delta, std::memory_order_relaxed);
+			}
+
+			int64_t sum() const noexcept
+			{
+				int64_t result = 0;
+				for (size_t i = 0; i <= _mask; ++i)
+				{
+					result += _cells[i].value.load(std::memory_order_relaxed);
+				}
+				return result;
+			}
+
+			void reset() noexcept
+			{
+				for (size_t i = 0; i <= _mask; ++i)
+				{
+					_cells[i].value.store(0, std::memory_order_relaxed);
+				}
+			}
+
+			size_t shards() const noexcept
+			{
+				return _mask + 1;
+			}
+
+			private:
+
+			const size_t _mask;
+			std::unique_ptr<CounterCell[]> _cells;
+		};
+	}
+
+	//! class ShardedCounter
+	/**
+	 * A counter for events recorded by many threads, i.e. from every worker of
+	 * a pool. A single shared atomic makes every increment fight for the same
+	 * cache line; here each thread adds to its own padded shard and value()
+	 * sums the shards. With more threads than shards some threads share one,
+	 * which stays correct (shards are atomics) but contended.
+	 *
+	 * value() is not a snapshot: increments made while it runs may or may not
+	 * be included.
+	 */
+	class ShardedCounter
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param shards the number of shards, rounded up to a power of two. One per hardware thread by default.
+		 */
+		explicit ShardedCounter(size_t shards = details::defaultShardCount())
+			: _cells(shards)
+		{}
+
+		//! Copy constructor
+		ShardedCounter(const ShardedCounter& other) = delete;
+		//! Copy assignment
+		ShardedCounter& operator=(const ShardedCounter& other) = delete;
+
+		//! increment
+		/**
+		 * \param n the number of events to count.
+		 */
+		void increment(int64_t n = 1) noexcept
+		{
+			_cells.add(n);
+		}
+
+		//! value
+		/**
+		 * \return the number of events counted so far.
+		 */
+		int64_t value() const noexcept
+		{
+			return _cells.sum();
+		}
+
+		//! reset
+		/**
+		 * Sets the counter back to zero. Increments made meanwhile may be lost.
+		 */
+		void reset() noexcept
+		{
+			_cells.reset();
+		}
+
+		//! shards
+		size_t shards() const noexcept
+		{
+			return _cells.shards();
+		}
+
+		private:
+
+		details::CounterCells _cells;
+	};
+
+	//! class ShardedGauge
+	/**
+	 * A level raised and lowered by many threads, i.e. tasks in flight or bytes
+	 * buffered, sharded like ShardedCounter. A thread may lower the level
+	 * another one raised: only the sum of the shards is meaningful.
+	 */
+	class ShardedGauge
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param shards the number of shards, rounded up to a power of two. One per hardware thread by default.
+		 */
+		explicit ShardedGauge(size_t shards = details::defaultShardCount())
+			: _cells(shards)
+		{}
+
+		//! Copy constructor
+		ShardedGauge(const ShardedGauge& other) = delete;
+		//! Copy assignment
+		ShardedGauge& operator=(const ShardedGauge& other) = delete;
+
+		//! add
+		/**
+		 * \param delta the amount to raise the level by, negative to lower it.
+		 */
+		void add(int64_t delta) noexcept
+		{
+			_cells.add(delta);
+		}
+
+		//! increment
+		void increment() noexcept
+		{
+			_cells.add(1);
+		}
+
+		//! decrement
+		void decrement() noexcept
+		{
+			_cells.add(-1);
+		}
+
+		//! value
+		/**
+		 * \return the current level.
+		 */
+		int64_t value() const noexcept
+		{
+			return _cells.sum();
+		}
+
+		//! shards
+		size_t shards() const noexcept
+		{
+			return _cells.shards();
+		}
+
+		private:
+
+		details::CounterCells _cells;
+	};
+
+	//! class ShardedHistogram
+	/**
+	 * An HdrHistogram many threads record into, i.e. task latencies measured by
+	 * ActiveWorker tasks or scheduler callbacks. Each thread records into the
+	 * histogram of its shard under the shard's lock, which only threads sharing
+	 * the shard contend for; snapshot() merges the shards.
+	 */
+	class ShardedHistogram
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param highest the highest value to be tracked. Larger values are clamped to it.
+		 * \param significant_digits the number of significant decimal digits, from 1 to 5.
+		 * \param shards the number of shards, rounded up to a power of two. One per hardware thread by default.
+		 */
+		explicit ShardedHistogram(uint64_t highest = 3600000000000ull, int significant_digits = 3, size_t shards = details::defaultShardCount())
+			: _highest(highest)
+			, _significant_digits(significant_digits)
+			, _mask(details::checkedShardCount(shards) - 1)
+		{
+			_shards.reserve(_mask + 1);
+			for (size_t i = 0; i <= _mask; ++i)
+			{
+				_shards.emplace_back(new Shard(highest, significant_digits));
+			}
+		}
+
+		//! Copy constructor
+		ShardedHistogram(const ShardedHistogram& other) = delete;
+		//! Copy assignment
+		ShardedHistogram& operator=(const ShardedHistogram& other) = delete;
+
+		//! record
+		/**
+		 * Records a value. See HdrHistogram::record.
+		 * \param value the value to record.
+		 * \param count how many times the value is recorded.
+		 */
+		void record(uint64_t value, uint64_t count = 1)
+		{
+			auto& shard = *_shards[details::threadShard() & _mask];
+			std::lock_guard<std::mutex> lock(shard.mtx);
+			shard.histogram.record(value, count);
+		}
+
+		//! snapshot
+		/**
+		 * \return a histogram with the values recorded by every thread so far.
+		 */
+		HdrHistogram snapshot() const
+		{
+			HdrHistogram result(_highest, _significant_digits);
+			for (const auto& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard->mtx);
+				result.merge(shard->histogram);
+			}
+			return result;
+		}
+
+		//! reset
+		/**
+		 * Clears every recorded value.
+		 */
+		void reset()
+		{
+			for (auto& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard->mtx);
+				shard->histogram.reset();
+			}
+		}
+
+		//! shards
+		size_t shards() const noexcept
+		{
+			return _mask + 1;
+		}
+
+		private:
+
+		struct Shard
+		{
+			Shard(uint64_t highest, int significant_digits)
+				: histogram(highest, significant_digits)
+			{}
+
+			mutable std::mutex mtx; /*! < Protects histogram. */
+			HdrHistogram histogram;
+			char padding[utilities::kCacheLineSize];
+		};
+
+		const uint64_t _highest;
+		const int _significant_digits;
+		const size_t _mask;
+		std::vector<std::unique_ptr<Shard>> _shards;
+	};
+
+}}} // rboc::utils::metrics
+#endif // UTILS_METRICS_HEADER
@@ -2,8 +2,11 @@
 #ifndef UTILS_OPTIONAL_HEADER
 #define UTILS_OPTIONAL_HEADER
 
+#include <cassert>
 #include <exception>
+#include <memory>
 #include <type_traits>
+#include <utility>
 
 namespace rboc { namespace utils { namespace optional
 {
@@ -0,0 +1,380 @@
+#pragma once
+#ifndef UTILS_READMOSTLY_HEADER
+#define UTILS_READMOSTLY_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <common/Utility.h>
+
+namespace rboc { namespace utils { namespace rcu
+{
+	namespace details
+	{
+		//! The read side state of one thread.
+		struct ReaderSlot
+		{
+			std::atomic<uint64_t> epoch{0}; // (epoch << 1) | 1 while reading, 0 otherwise.
+			std::atomic<bool> in_use{true};
+			unsigned nesting = 0;           // Read sections the owner is in. Owner only.
+			ReaderSlot* next = nullptr;
+			char padding[utilities::kCacheLineSize];
+		};
+
+		//! class ReaderRegistry
+		/**
+		 * The global epoch and the slot of every reading thread, shared by every
+		 * ReadMostly. A reader publishes the epoch it started reading in; a
+		 * version replaced in epoch e can go once no reader started in e or
+		 * before is still reading.
+		 *
+		 * Slots are reused by new threads and never freed, so threads still
+		 * running during static destruction can keep using theirs.
+		 */
+		class ReaderRegistry
+		{
+			public:
+
+			ReaderSlot* acquire()
+			{
+				for (auto slot = _slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+				{
+					bool expected = false;
+					if (!slot->in_use.load(std::memory_order_relaxed)
+						&& slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					{
+						return slot;
+					}
+				}
+				auto slot = new ReaderSlot();
+				slot->next = _slots.load(std::memory_order_relaxed);
+				while (!_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+				{}
+				return slot;
+			}
+
+			void release(ReaderSlot* slot) noexcept
+			{
+				slot->in_use.store(false, std::memory_order_release);
+			}
+
+			void enter(ReaderSlot& slot) noexcept
+			{
+				if (slot.nesting++ != 0) return;
+				auto current = _epoch.load(std::memory_order_acquire);
+				slot.epoch.store((current << 1) | 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst); // The version is loaded after the slot is visible.
+			}
+
+			void leave(ReaderSlot& slot) noexcept
+			{
+				if (--slot.nesting == 0)
+				{
+					slot.epoch.store(0, std::memory_order_release);
+				}
+			}
+
+			//! Starts a new epoch. Called after a version is replaced.
+			/**
+			 * \return the epoch the replaced version belongs to.
+			 */
+			uint64_t advance() noexcept
+			{
+				return _epoch.fetch_add(1, std::memory_order_seq_cst);
+			}
+
+			//! The epoch of the oldest reader still reading, or the maximum if there is none.
+			uint64_t oldestReader() const noexcept
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				auto oldest = std::numeric_limits<uint64_t>::max();
+				for (auto slot = _slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+				{
+					auto epoch = slot->epoch.load(std::memory_order_acquire);
+					if ((epoch & 1) != 0)
+					{
+						oldest = std::min(oldest, epoch >> 1);
+					}
+				}
+				return oldest;
+			}
+
+			private:
+
+			std::atomic<uint64_t> _epoch{1};
+			char _padding[utilities::kCacheLineSize]; // Readers load the epoch, writers push slots.
+			std::atomic<ReaderSlot*> _slots{nullptr};
+		};
+
+		inline ReaderRegistry& readerRegistry()
+		{
+			static ReaderRegistry registry;
+			return registry;
+		}
+
+		//! Owns the calling thread's slot for the lifetime of the thread.
+		struct ReaderSlotHolder
+		{
+			ReaderSlotHolder()
+				: _slot(readerRegistry().acquire())
+			{}
+
+			~ReaderSlotHolder()
+			{
+				readerRegistry().release(_slot);
+			}
+
+			ReaderSlot* _slot;
+		};
+
+		inline ReaderSlot& localReaderSlot()
+		{
+			static thread_local ReaderSlotHolder holder;
+			return *holder._slot;
+		}
+	}
+
+	//! class ReadMostly
+	/**
+	 * A value read by many threads and rarely replaced, i.e. routing tables or
+	 * feature flags, in the spirit of RCU. Readers take a snapshot: a pointer
+	 * to the current version which stays valid, and unchanged, until the
+	 * snapshot is destroyed. Taking one is wait-free and does no atomic
+	 * read-modify-write: it publishes the reading thread's epoch in its own
+	 * slot and loads the current version.
+	 *
+	 * Writers never modify a published version: they publish a new one, under
+	 * a mutex, and the replaced version is destroyed once every reader that
+	 * may still see it has left. That is checked on every publish, by
+	 * reclaim() and by synchronize(), which waits for it.
+	 *
+	 * A snapshot must be destroyed by the thread that took it and should be
+	 * short lived: while it exists no version replaced since it was taken,
+	 * in any ReadMostly, can be reclaimed.
+	 *
+	 * \code
+	 * ReadMostly<Routes> routes{loadRoutes()};
+	 * pool.addTask([&]{ auto current = routes.read(); send(current->next(hop)); });
+	 * routes.update([](Routes& copy){ copy.add(hop, peer); });
+	 * \endcode
+	 */
+	template<typename T>
+	class ReadMostly
+	{
+		public:
+
+		//! class Snapshot
+		/**
+		 * A read section: the version of the value current when it was taken.
+		 */
+		class Snapshot
+		{
+			public:
+
+			//! Move constructor
+			Snapshot(Snapshot&& other) noexcept
+				: _slot(other._slot)
+				, _value(other._value)
+			{
+				other._slot = nullptr;
+			}
+
+			//! Copy constructor
+			Snapshot(const Snapshot& other) = delete;
+			//! Copy assignment
+			Snapshot& operator=(const Snapshot& other) = delete;
+			//! Move assignment
+			Snapshot& operator=(Snapshot&& other) = delete;
+
+			//! Destructor
+			~Snapshot()
+			{
+				if (_slot != nullptr)
+				{
+					details::readerRegistry().leave(*_slot);
+				}
+			}
+
+			const T& operator*() const noexcept
+			{
+				return *_value;
+			}
+
+			const T* operator->() const noexcept
+			{
+				return _value;
+			}
+
+			const T* get() const noexcept
+			{
+				return _value;
+			}
+
+			private:
+
+			friend class ReadMostly;
+
+			Snapshot(details::ReaderSlot& slot, const std::atomic<T*>& current) noexcept
+				: _slot(&slot)
+			{
+				details::readerRegistry().enter(slot);
+				_value = current.load(std::memory_order_acquire);
+			}
+
+			details::ReaderSlot* _slot;
+			const T* _value;
+		};
+
+		//! Constructor
+		/**
+		 * \param value the first version.
+		 */
+		explicit ReadMostly(T value = T())
+			: _current(new T(std::move(value)))
+		{}
+
+		//! Copy constructor
+		ReadMostly(const ReadMostly& other) = delete;
+		//! Copy assignment
+		ReadMostly& operator=(const ReadMostly& other) = delete;
+
+		//! Destructor
+		/**
+		 * No snapshot of this object may be alive.
+		 */
+		~ReadMostly()
+		{
+			delete _current.load(std::memory_order_relaxed);
+		}
+
+		//! read
+		/**
+		 * Wait-free, once the calling thread has a slot (its first read allocates it).
+		 * \return a snapshot of the current version.
+		 */
+		Snapshot read() const
+		{
+			return Snapshot(details::localReaderSlot(), _current);
+		}
+
+		//! load
+		/**
+		 * \return a copy of the current version.
+		 */
+		T load() const
+		{
+			auto snapshot = read();
+			return *snapshot;
+		}
+
+		//! store
+		/**
+		 * Publishes value as the new version.
+		 */
+		void store(T value)
+		{
+			publish(std::unique_ptr<T>(new T(std::move(value))));
+		}
+
+		//! publish
+		/**
+		 * Publishes an already built version, which must not be null.
+		 */
+		void publish(std::unique_ptr<T> value)
+		{
+			assert(value);
+			std::lock_guard<std::mutex> lock(_mtx);
+			replace(std::move(value));
+		}
+
+		//! update
+		/**
+		 * Read-copy-update: copies the current version, applies f to the copy
+		 * and publishes it. Concurrent updates are serialized, so none is lost.
+		 * \param f a function taking a T& to modify.
+		 */
+		template<typename F>
+		void update(F f)
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			std::unique_ptr<T> copy(new T(*_current.load(std::memory_order_relaxed)));
+			f(*copy);
+			replace(std::move(copy));
+		}
+
+		//! reclaim
+		/**
+		 * Destroys the replaced versions no reader can see anymore.
+		 */
+		void reclaim()
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			reclaimLocked();
+		}
+
+		//! synchronize
+		/**
+		 * Waits until every reader of a replaced version has left and destroys
+		 * those versions. Must not be called while holding a snapshot.
+		 */
+		void synchronize()
+		{
+			assert(details::localReaderSlot().nesting == 0);
+			std::unique_lock<std::mutex> lock(_mtx);
+			reclaimLocked();
+			while (!_retired.empty())
+			{
+				lock.unlock();
+				std::this_thread::yield();
+				lock.lock();
+				reclaimLocked();
+			}
+		}
+
+		//! pending
+		/**
+		 * \return the number of replaced versions not destroyed yet.
+		 */
+		size_t pending() const
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			return _retired.size();
+		}
+
+		private:
+
+		// Called with _mtx held.
+		void replace(std::unique_ptr<T> value)
+		{
+			std::unique_ptr<T> old(_current.exchange(value.release(), std::memory_order_seq_cst));
+			auto epoch = details::readerRegistry().advance();
+			_retired.emplace_back(epoch, std::move(old));
+			reclaimLocked();
+		}
+
+		// Called with _mtx held.
+		void reclaimLocked()
+		{
+			if (_retired.empty()) return;
+			auto oldest = details::readerRegistry().oldestReader();
+			while (!_retired.empty() && _retired.front().first < oldest)
+			{
+				_retired.pop_front();
+			}
+		}
+
+		std::atomic<T*> _current;
+		mutable std::mutex _mtx; /*! < Serializes writers and protects _retired. */
+		std::deque<std::pair<uint64_t, std::unique_ptr<T>>> _retired; // Replaced versions and their epoch, oldest first.
+	};
+
+}}} // rboc::utils::rcu
+#endif // UTILS_READMOSTLY_HEADER
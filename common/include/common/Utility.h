@@ -2,8 +2,15 @@
 #ifndef UTILS_UTILITY_HEADER
 #define UTILS_UTILITY_HEADER
 
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
 namespace rboc { namespace utils { namespace utilities {
 
+	//! Size of a cache line. Used to pad data written by different threads.
+	static constexpr std::size_t kCacheLineSize = 64;
+
 	//! A template representing an index sequence. Similar to std::index_sequence from C++14
 	template <std::size_t... Seq>
 	struct IndexSequence{};
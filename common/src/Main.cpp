@@ -1,18 +1,20 @@
-#include <iostream>
+#include <logging/Logger.h>
 #include <scheduler/Scheduler.h>
 #include <chrono>
 
 using namespace rboc::utils::scheduler;
+using namespace rboc::utils::logging;
 
 int main()
 {
+	Logger log{std::make_shared<FileSink>(1)};
+	log.flushOnCrash();
 	Scheduler sched;
 	int error = 0;
-	std::function<void(void)> f = [] () 
+	std::function<void(void)> f = [&log] () 
 	{
 		auto now = std::chrono::high_resolution_clock::now();
-		std::cout << "Executing callback from task 1 at " 
-			<< now.time_since_epoch().count() <<std::endl;
+		log.info("Executing callback from task 1 at {}", now.time_since_epoch().count());
 	};
 
 	sched.addPeriodicTask("task 1", 1000, f, error);
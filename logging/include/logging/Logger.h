@@ -0,0 +1,967 @@
+#pragma once
+#ifndef LOGGING_LOGGER_HEADER
+#define LOGGING_LOGGER_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <common/Utility.h>
+#include <thread/ActiveWorker.h>
+#include <thread/EventCount.h>
+#include <thread/Reclamation.h>
+#include <thread/SpscQueue.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace rboc { namespace utils { namespace logging
+{
+	//! Severity of a log message.
+	enum class Level : int
+	{
+		trace,
+		debug,
+		info,
+		warning,
+		error,
+		off     /*! < Only used as a threshold: nothing is logged. */
+	};
+
+	//! What a thread does when its buffer is full.
+	enum class OverflowPolicy
+	{
+		block,  /*! < Wait until the logger thread makes room. Nothing is lost. */
+		drop    /*! < Discard the message and count it. The thread never waits. */
+	};
+
+	//! class Sink
+	/**
+	 * Where the logger thread writes formatted lines. Only the logger thread,
+	 * or a thread flushing the logger, calls it, never two at the same time.
+	 * A sink must not throw nor log to the logger it belongs to.
+	 */
+	class Sink
+	{
+		public:
+
+		//! Destructor
+		virtual ~Sink() = default;
+
+		//! write
+		/**
+		 * \param lines the formatted lines, each one ending with a newline.
+		 * \param count the number of lines.
+		 */
+		virtual void write(const std::string* lines, size_t count) = 0;
+
+		//! flush
+		/**
+		 * Pushes buffered output, if any, to its destination.
+		 */
+		virtual void flush() {}
+	};
+
+	//! class FileSink
+	/**
+	 * Writes lines to a file descriptor, a whole batch per writev call. The
+	 * descriptor is not closed.
+	 */
+	class FileSink : public Sink
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param fd the descriptor to write to, i.e. 1 for the standard output.
+		 */
+		explicit FileSink(int fd)
+			: _fd(fd)
+		{}
+
+		void write(const std::string* lines, size_t count) override
+		{
+#if defined(_WIN32)
+			for (size_t i = 0; i < count; ++i)
+			{
+				::_write(_fd, lines[i].data(), static_cast<unsigned>(lines[i].size()));
+			}
+#else
+			const size_t max_vectors = IOV_MAX < 1024 ? IOV_MAX : 1024;
+			struct iovec vectors[1024];
+			while (count > 0)
+			{
+				size_t n = count < max_vectors ? count : max_vectors;
+				for (size_t i = 0; i < n; ++i)
+				{
+					vectors[i].iov_base = const_cast<char*>(lines[i].data());
+					vectors[i].iov_len = lines[i].size();
+				}
+				writeAll(vectors, n);
+				lines += n;
+				count -= n;
+			}
+#endif
+		}
+
+		private:
+
+#if !defined(_WIN32)
+		// Retries short writes and interruptions. Gives up on any other error.
+		void writeAll(struct iovec* vectors, size_t count)
+		{
+			while (count > 0)
+			{
+				auto written = ::writev(_fd, vectors, static_cast<int>(count));
+				if (written < 0)
+				{
+					if (errno == EINTR) continue;
+					return;
+				}
+				auto left = static_cast<size_t>(written);
+				while (count > 0 && left >= vectors->iov_len)
+				{
+					left -= vectors->iov_len;
+					++vectors;
+					--count;
+				}
+				if (count > 0)
+				{
+					vectors->iov_base = static_cast<char*>(vectors->iov_base) + left;
+					vectors->iov_len -= left;
+				}
+			}
+		}
+#endif
+
+		int _fd;
+	};
+
+	namespace details
+	{
+		inline const char* levelName(Level level) noexcept
+		{
+			switch (level)
+			{
+				case Level::trace:   return "TRACE";
+				case Level::debug:   return "DEBUG";
+				case Level::info:    return "INFO ";
+				case Level::warning: return "WARN ";
+				case Level::error:   return "ERROR";
+				default:             return "     ";
+			}
+		}
+
+		//! A small number naming the calling thread in log lines.
+		inline unsigned threadNumber() noexcept
+		{
+			static std::atomic<unsigned> next_thread{1};
+			static thread_local unsigned number = next_thread.fetch_add(1, std::memory_order_relaxed);
+			return number;
+		}
+
+		//! How an argument is kept until it is formatted: by value, C strings as std::string.
+		template<typename T>
+		struct Captured
+		{
+			using type = typename std::decay<T>::type;
+		};
+
+		template<>
+		struct Captured<const char*>
+		{
+			using type = std::string;
+		};
+
+		template<>
+		struct Captured<char*>
+		{
+			using type = std::string;
+		};
+
+		template<typename T>
+		using CapturedType = typename Captured<typename std::decay<T>::type>::type;
+
+		inline void appendArg(std::string& out, const std::string& value)
+		{
+			out += value;
+		}
+
+		inline void appendArg(std::string& out, bool value)
+		{
+			out += value ? "true" : "false";
+		}
+
+		inline void appendArg(std::string& out, char value)
+		{
+			out += value;
+		}
+
+		template<typename T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+		appendArg(std::string& out, T value)
+		{
+			char buffer[32];
+			auto n = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+			out.append(buffer, static_cast<size_t>(n));
+		}
+
+		template<typename T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+		appendArg(std::string& out, T value)
+		{
+			char buffer[32];
+			auto n = std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+			out.append(buffer, static_cast<size_t>(n));
+		}
+
+		template<typename T>
+		typename std::enable_if<std::is_floating_point<T>::value>::type
+		appendArg(std::string& out, T value)
+		{
+			char buffer[32];
+			auto n = std::snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(value));
+			out.append(buffer, static_cast<size_t>(n));
+		}
+
+		template<typename T>
+		typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_same<T, std::string>::value>::type
+		appendArg(std::string& out, const T& value)
+		{
+			std::ostringstream stream;
+			stream << value;
+			out += stream.str();
+		}
+
+		inline void formatTo(std::string& out, const char* format)
+		{
+			out += format;
+		}
+
+		//! Replaces each "{}" of format with the next argument. Arguments left
+		//! over are appended, separated by spaces.
+		template<typename T, typename... Rest>
+		void formatTo(std::string& out, const char* format, const T& arg, const Rest&... rest)
+		{
+			const char* p = format;
+			while (*p != '\0' && !(p[0] == '{' && p[1] == '}'))
+			{
+				++p;
+			}
+			out.append(format, static_cast<size_t>(p - format));
+			if (*p == '\0')
+			{
+				out += ' ';
+				appendArg(out, arg);
+				formatTo(out, "", rest...);
+				return;
+			}
+			appendArg(out, arg);
+			formatTo(out, p + 2, rest...);
+		}
+
+		template<typename Tuple, std::size_t... Seq>
+		void formatTuple(std::string& out, const char* format, const Tuple& args, utilities::IndexSequence<Seq...>)
+		{
+			formatTo(out, format, std::get<Seq>(args)...);
+		}
+
+		//! class Message
+		/**
+		 * A log call waiting to be formatted: the format string, which must
+		 * outlive the logger (a string literal), and a copy of the arguments.
+		 * Arguments small enough are stored inline, so logging them does not
+		 * allocate; larger ones go to the heap.
+		 */
+		class Message
+		{
+			public:
+
+			Message() = default;
+
+			template<typename... A>
+			Message(Level level, const char* format, A&&... args)
+				: _level(level)
+				, _time(std::chrono::system_clock::now())
+				, _thread(threadNumber())
+				, _format(format)
+				, _ops(&OpsFor<std::tuple<CapturedType<A>...>>::ops)
+			{
+				using Args = std::tuple<CapturedType<A>...>;
+				if (OpsFor<Args>::inlined)
+				{
+					::new (static_cast<void*>(&_storage)) Args(std::forward<A>(args)...);
+				}
+				else
+				{
+					*reinterpret_cast<Args**>(&_storage) = new Args(std::forward<A>(args)...);
+				}
+			}
+
+			Message(Message&& other) noexcept
+			{
+				take(other);
+			}
+
+			Message& operator=(Message&& other) noexcept
+			{
+				if (this != &other)
+				{
+					destroy();
+					take(other);
+				}
+				return *this;
+			}
+
+			Message(const Message& other) = delete;
+			Message& operator=(const Message& other) = delete;
+
+			~Message()
+			{
+				destroy();
+			}
+
+			//! Appends "<time> <level> [<thread>] <message>\n" to out.
+			void formatLine(std::string& out) const
+			{
+				using namespace std::chrono;
+				auto since_epoch = duration_cast<microseconds>(_time.time_since_epoch()).count();
+				auto seconds = static_cast<std::time_t>(since_epoch / 1000000);
+				std::tm utc;
+#if defined(_WIN32)
+				gmtime_s(&utc, &seconds);
+#else
+				gmtime_r(&seconds, &utc);
+#endif
+				char buffer[64];
+				auto n = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+				n += static_cast<size_t>(std::snprintf(buffer + n, sizeof(buffer) - n, ".%06dZ %s [%u] ",
+					static_cast<int>(since_epoch % 1000000), levelName(_level), _thread));
+				out.append(buffer, n);
+				if (_ops != nullptr)
+				{
+					_ops->format(out, _format, &_storage);
+				}
+				out += '\n';
+			}
+
+			private:
+
+			static constexpr size_t kInlineSize = 96;
+			using Storage = std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type;
+
+			//! What a message needs to know about the type of its arguments.
+			struct Ops
+			{
+				void (*format)(std::string& out, const char* format, const void* storage);
+				void (*relocate)(void* to, void* from) noexcept;
+				void (*destroy)(void* storage) noexcept;
+			};
+
+			template<typename Args>
+			struct OpsFor
+			{
+				static constexpr bool inlined = sizeof(Args) <= kInlineSize
+					&& alignof(Args) <= alignof(std::max_align_t)
+					&& std::is_nothrow_move_constructible<Args>::value;
+
+				static const Args& get(const void* storage) noexcept
+				{
+					return inlined ? *static_cast<const Args*>(storage) : **static_cast<Args* const*>(storage);
+				}
+
+				static void format(std::string& out, const char* format, const void* storage)
+				{
+					formatTuple(out, format, get(storage),
+						typename utilities::GenerateSequence<std::tuple_size<Args>::value>::type{});
+				}
+
+				static void relocate(void* to, void* from) noexcept
+				{
+					relocateImpl(to, from, std::integral_constant<bool, inlined>{});
+				}
+
+				static void destroy(void* storage) noexcept
+				{
+					destroyImpl(storage, std::integral_constant<bool, inlined>{});
+				}
+
+				static void relocateImpl(void* to, void* from, std::true_type) noexcept
+				{
+					auto args = static_cast<Args*>(from);
+					::new (to) Args(std::move(*args));
+					args->~Args();
+				}
+
+				static void relocateImpl(void* to, void* from, std::false_type) noexcept
+				{
+					*static_cast<Args**>(to) = *static_cast<Args**>(from);
+				}
+
+				static void destroyImpl(void* storage, std::true_type) noexcept
+				{
+					static_cast<Args*>(storage)->~Args();
+				}
+
+				static void destroyImpl(void* storage, std::false_type) noexcept
+				{
+					delete *static_cast<Args**>(storage);
+				}
+
+				static const Ops ops;
+			};
+
+			void take(Message& other) noexcept
+			{
+				_level = other._level;
+				_time = other._time;
+				_thread = other._thread;
+				_format = other._format;
+				_ops = other._ops;
+				if (_ops != nullptr)
+				{
+					_ops->relocate(&_storage, &other._storage);
+					other._ops = nullptr;
+				}
+			}
+
+			void destroy() noexcept
+			{
+				if (_ops != nullptr)
+				{
+					_ops->destroy(&_storage);
+					_ops = nullptr;
+				}
+			}
+
+			Level _level = Level::info;
+			std::chrono::system_clock::time_point _time;
+			unsigned _thread = 0;
+			const char* _format = "";
+			const Ops* _ops = nullptr;
+			Storage _storage;
+		};
+
+		template<typename Args>
+		const Message::Ops Message::OpsFor<Args>::ops = {
+			&Message::OpsFor<Args>::format, &Message::OpsFor<Args>::relocate, &Message::OpsFor<Args>::destroy };
+
+		template<typename Args>
+		constexpr bool Message::OpsFor<Args>::inlined;
+
+		//! The messages of one thread, consumed by the logger thread.
+		struct ThreadBuffer
+		{
+			explicit ThreadBuffer(size_t capacity)
+				: queue(capacity)
+			{}
+
+			threading::SpscQueue<Message> queue;
+			std::atomic<bool> in_use{true};
+			ThreadBuffer* next = nullptr;
+		};
+
+		//! The part of a Logger producer threads keep alive: the buffers and the
+		//! wake up channels. See threading::details::ThreadRecords.
+		class LoggerState
+		{
+			public:
+
+			using Record = ThreadBuffer;
+
+			explicit LoggerState(size_t capacity)
+				: _capacity(capacity)
+			{
+				if (capacity == 0)
+				{
+					throw std::invalid_argument("buffer capacity must be positive");
+				}
+			}
+
+			LoggerState(const LoggerState&) = delete;
+			LoggerState& operator=(const LoggerState&) = delete;
+
+			~LoggerState()
+			{
+				auto buffer = _buffers.load(std::memory_order_acquire);
+				while (buffer != nullptr)
+				{
+					auto next = buffer->next;
+					delete buffer;
+					buffer = next;
+				}
+			}
+
+			//! Gives the calling thread a buffer, reusing the one of a finished thread if possible.
+			ThreadBuffer* acquire()
+			{
+				for (auto buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+				{
+					bool expected = false;
+					if (!buffer->in_use.load(std::memory_order_relaxed)
+						&& buffer->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					{
+						return buffer;
+					}
+				}
+				auto buffer = new ThreadBuffer(_capacity);
+				buffer->next = _buffers.load(std::memory_order_relaxed);
+				while (!_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+				{}
+				return buffer;
+			}
+
+			//! Called when the owner thread exits. Its pending messages are still written.
+			void release(ThreadBuffer* buffer) noexcept
+			{
+				buffer->in_use.store(false, std::memory_order_release);
+			}
+
+			void close() noexcept
+			{
+				_closed.store(true, std::memory_order_release);
+			}
+
+			bool closed() const noexcept
+			{
+				return _closed.load(std::memory_order_acquire);
+			}
+
+			ThreadBuffer* buffers() const noexcept
+			{
+				return _buffers.load(std::memory_order_acquire);
+			}
+
+			threading::EventCount work;   // The logger thread parks here while every buffer is empty.
+			threading::EventCount space;  // Blocked producers park here while their buffer is full.
+			std::atomic<uint64_t> dropped{0};
+
+			private:
+
+			const size_t _capacity;
+			std::atomic<bool> _closed{false};
+			std::atomic<ThreadBuffer*> _buffers{nullptr};
+		};
+	}
+
+	//! class Logger
+	/**
+	 * An asynchronous logger. A log call copies its arguments into the calling
+	 * thread's own buffer, a wait-free SpscQueue, and returns: no lock, no
+	 * formatting and no syscall on the calling thread. The logger's
+	 * ActiveWorker drains every buffer, formats the messages and hands them to
+	 * the sink in batches, i.e. one writev call for up to batch_size lines.
+	 *
+	 * Messages of one thread are written in the order they were logged;
+	 * messages of different threads may interleave in any order, each line
+	 * carries its timestamp and thread number.
+	 *
+	 * Formats use "{}" placeholders, and must outlive the logger (string
+	 * literals do). Arguments are copied, C strings as std::string, and
+	 * formatted later with operator<< unless they are numbers or strings.
+	 *
+	 * \code
+	 * Logger log{std::make_shared<FileSink>(1)};
+	 * pool.addTask([&]{ log.info("task {} done in {} us", id, elapsed); });
+	 * \endcode
+	 */
+	class Logger
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param sink where the lines are written.
+		 * \param buffer_capacity the number of messages each thread can have pending, rounded up to a power of two.
+		 * \param policy what a thread does when its buffer is full.
+		 * \param level the least severe level logged.
+		 * \param batch_size the maximum number of lines handed to the sink at once.
+		 */
+		explicit Logger(std::shared_ptr<Sink> sink, size_t buffer_capacity = 1024,
+			OverflowPolicy policy = OverflowPolicy::block, Level level = Level::info, size_t batch_size = 256)
+			: _state(std::make_shared<details::LoggerState>(buffer_capacity))
+			, _sink(std::move(sink))
+			, _policy(policy)
+			, _level(static_cast<int>(level))
+			, _lines(batch_size == 0 ? 1 : batch_size)
+		{
+			threading::ThreadOptions options;
+			options.name = "logger"; // Its CPU shows apart in top -H and perf.
+			_worker.configureThread(options);
+			_loop = _worker.addWork([this]{ drainLoop(); });
+		}
+
+		//! Copy constructor
+		Logger(const Logger& other) = delete;
+		//! Copy assignment
+		Logger& operator=(const Logger& other) = delete;
+
+		//! Destructor
+		/**
+		 * Writes every pending message. No thread may be logging anymore.
+		 */
+		~Logger()
+		{
+			flushOnCrash(false);
+			_running.store(false, std::memory_order_release);
+			_state->work.notifyAll();
+			_loop.wait();
+			_state->close();
+			threading::details::threadRecords<details::LoggerState>().drop(_state.get());
+		}
+
+		//! log
+		/**
+		 * Queues a message. Under OverflowPolicy::block it waits while the
+		 * calling thread's buffer is full. Must not be called from a sink.
+		 * \param level the severity of the message.
+		 * \param format the format, with "{}" where each argument goes.
+		 * \param args the arguments, copied.
+		 * \return false if the message was dropped or its level is disabled.
+		 */
+		template<typename... A>
+		bool log(Level level, const char* format, A&&... args)
+		{
+			if (!enabled(level)) return false;
+			auto& buffer = threading::details::threadRecords<details::LoggerState>().get(_state);
+			details::Message message(level, format, std::forward<A>(args)...);
+			while (!buffer.queue.tryPush(std::move(message))) // message is only moved from on success.
+			{
+				if (_policy == OverflowPolicy::drop)
+				{
+					_state->dropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				_state->work.notify();
+				auto key = _state->space.prepareWait();
+				if (buffer.queue.tryPush(std::move(message)))
+				{
+					_state->space.cancelWait();
+					break;
+				}
+				_state->space.wait(key);
+			}
+			_state->work.notify(); // No syscall unless the logger thread is asleep.
+			return true;
+		}
+
+		//! trace
+		template<typename... A>
+		bool trace(const char* format, A&&... args)
+		{
+			return log(Level::trace, format, std::forward<A>(args)...);
+		}
+
+		//! debug
+		template<typename... A>
+		bool debug(const char* format, A&&... args)
+		{
+			return log(Level::debug, format, std::forward<A>(args)...);
+		}
+
+		//! info
+		template<typename... A>
+		bool info(const char* format, A&&... args)
+		{
+			return log(Level::info, format, std::forward<A>(args)...);
+		}
+
+		//! warning
+		template<typename... A>
+		bool warning(const char* format, A&&... args)
+		{
+			return log(Level::warning, format, std::forward<A>(args)...);
+		}
+
+		//! error
+		template<typename... A>
+		bool error(const char* format, A&&... args)
+		{
+			return log(Level::error, format, std::forward<A>(args)...);
+		}
+
+		//! enabled
+		/**
+		 * \return true if messages of the given level are logged.
+		 */
+		bool enabled(Level level) const noexcept
+		{
+			return level != Level::off && static_cast<int>(level) >= _level.load(std::memory_order_relaxed);
+		}
+
+		//! setLevel
+		/**
+		 * \param level the least severe level logged, Level::off to log nothing.
+		 */
+		void setLevel(Level level) noexcept
+		{
+			_level.store(static_cast<int>(level), std::memory_order_relaxed);
+		}
+
+		//! flush
+		/**
+		 * Writes, from the calling thread, every message queued so far and
+		 * flushes the sink. Messages logged by this thread before the call are
+		 * written when it returns.
+		 */
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock(_drain_mtx);
+			drainLocked();
+			_sink->flush();
+		}
+
+		//! dropped
+		/**
+		 * \return the number of messages discarded under OverflowPolicy::drop.
+		 */
+		uint64_t dropped() const noexcept
+		{
+			return _state->dropped.load(std::memory_order_relaxed);
+		}
+
+		//! flushOnCrash
+		/**
+		 * Makes this logger write its pending messages when the process
+		 * crashes: on SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT, and from
+		 * std::terminate. The previous handlers run afterwards. Only one logger
+		 * at a time can flush on crash; the last one enabled wins.
+		 *
+		 * This is best effort: formatting and writing from a signal handler is
+		 * not async-signal-safe, and messages being drained by a crashing
+		 * logger thread are lost.
+		 * \param enable false to remove the handlers.
+		 */
+		void flushOnCrash(bool enable = true)
+		{
+			std::lock_guard<std::mutex> lock(crashMutex());
+			auto& current = crashLogger();
+			if (enable)
+			{
+				if (current.exchange(this) == nullptr)
+				{
+					installCrashHandlers();
+				}
+			}
+			else
+			{
+				Logger* self = this;
+				if (current.compare_exchange_strong(self, nullptr))
+				{
+					removeCrashHandlers();
+				}
+			}
+		}
+
+		private:
+
+		void drainLoop()
+		{
+			while (true)
+			{
+				size_t drained;
+				{
+					std::lock_guard<std::mutex> lock(_drain_mtx);
+					drained = drainLocked();
+				}
+				if (drained != 0) continue;
+				if (!_running.load(std::memory_order_acquire)) break;
+				auto key = _state->work.prepareWait();
+				if (!_running.load(std::memory_order_acquire) || pending())
+				{
+					_state->work.cancelWait();
+					continue;
+				}
+				_state->work.wait(key);
+			}
+			std::lock_guard<std::mutex> lock(_drain_mtx);
+			drainLocked();
+			_sink->flush();
+		}
+
+		bool pending() const noexcept
+		{
+			for (auto buffer = _state->buffers(); buffer != nullptr; buffer = buffer->next)
+			{
+				if (!buffer->queue.empty()) return true;
+			}
+			return false;
+		}
+
+		// Called with _drain_mtx held: the buffers have one consumer at a time.
+		size_t drainLocked()
+		{
+			size_t drained = 0;
+			details::Message message;
+			for (auto buffer = _state->buffers(); buffer != nullptr; buffer = buffer->next)
+			{
+				while (buffer->queue.tryPop(message))
+				{
+					auto& line = _lines[_count++];
+					line.clear();
+					message.formatLine(line);
+					if (_count == _lines.size()) writeLines();
+					++drained;
+				}
+			}
+			auto dropped = _state->dropped.load(std::memory_order_relaxed);
+			if (dropped != _reported_drops)
+			{
+				details::Message report(Level::warning, "{} messages dropped, the log buffers were full", dropped - _reported_drops);
+				_reported_drops = dropped;
+				auto& line = _lines[_count++];
+				line.clear();
+				report.formatLine(line);
+			}
+			writeLines();
+			if (drained != 0)
+			{
+				_state->space.notifyAll(); // No syscall unless a producer waits for room.
+			}
+			return drained;
+		}
+
+		void writeLines()
+		{
+			if (_count == 0) return;
+			_sink->write(_lines.data(), _count);
+			_count = 0;
+		}
+
+		// Crash handling: one logger at a time, reachable from the handlers.
+		static std::atomic<Logger*>& crashLogger() noexcept
+		{
+			static std::atomic<Logger*> logger{nullptr};
+			return logger;
+		}
+
+		static std::mutex& crashMutex() noexcept
+		{
+			static std::mutex mtx;
+			return mtx;
+		}
+
+		struct CrashHandlers
+		{
+#if defined(SIGBUS)
+			static constexpr int kSignals = 5;
+#else
+			static constexpr int kSignals = 4;
+#endif
+			int signals[kSignals] = { SIGSEGV, SIGILL, SIGFPE, SIGABRT
+#if defined(SIGBUS)
+				, SIGBUS
+#endif
+			};
+			void (*previous[kSignals])(int) = {};
+			std::terminate_handler previous_terminate = nullptr;
+		};
+
+		static CrashHandlers& crashHandlers() noexcept
+		{
+			static CrashHandlers handlers;
+			return handlers;
+		}
+
+		static void installCrashHandlers()
+		{
+			auto& handlers = crashHandlers();
+			for (int i = 0; i < CrashHandlers::kSignals; ++i)
+			{
+				handlers.previous[i] = std::signal(handlers.signals[i], &Logger::onSignal);
+			}
+			handlers.previous_terminate = std::set_terminate(&Logger::onTerminate);
+		}
+
+		static void removeCrashHandlers()
+		{
+			auto& handlers = crashHandlers();
+			for (int i = CrashHandlers::kSignals - 1; i >= 0; --i)
+			{
+				std::signal(handlers.signals[i], handlers.previous[i] == SIG_ERR ? SIG_DFL : handlers.previous[i]);
+			}
+			std::set_terminate(handlers.previous_terminate);
+		}
+
+		// Writes what it can: waits a little for the logger thread to finish its
+		// batch, but never for ever, since it may be the crashing thread.
+		static void crashFlush() noexcept
+		{
+			auto logger = crashLogger().exchange(nullptr);
+			if (logger == nullptr) return;
+			std::unique_lock<std::mutex> lock(logger->_drain_mtx, std::defer_lock);
+			for (int attempt = 0; attempt < 100 && !lock.try_lock(); ++attempt)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			if (!lock.owns_lock()) return;
+			try
+			{
+				logger->drainLocked();
+				logger->_sink->flush();
+			}
+			catch (...)
+			{}
+		}
+
+		static void onSignal(int signal)
+		{
+			crashFlush();
+			auto& handlers = crashHandlers();
+			for (int i = 0; i < CrashHandlers::kSignals; ++i)
+			{
+				if (handlers.signals[i] == signal)
+				{
+					auto previous = handlers.previous[i];
+					std::signal(signal, previous == SIG_ERR || previous == SIG_IGN ? SIG_DFL : previous);
+					break;
+				}
+			}
+			std::raise(signal);
+		}
+
+		static void onTerminate()
+		{
+			crashFlush();
+			auto previous = crashHandlers().previous_terminate;
+			if (previous != nullptr) previous();
+			std::abort();
+		}
+
+		std::shared_ptr<details::LoggerState> _state;
+		std::shared_ptr<Sink> _sink;
+		const OverflowPolicy _policy;
+		std::atomic<int> _level;
+		std::atomic<bool> _running{true};
+		std::mutex _drain_mtx;             /*! < Held while draining: by the logger thread, flush() or a crash. */
+		std::vector<std::string> _lines;   // The batch being built. Lines keep their capacity between batches.
+		size_t _count = 0;                 // Lines of the batch in use.
+		uint64_t _reported_drops = 0;
+		std::future<void> _loop;
+		threading::ActiveWorker<void> _worker; // Last: its thread stops before the members it uses go.
+	};
+
+}}} // rboc::utils::logging
+#endif // LOGGING_LOGGER_HEADER
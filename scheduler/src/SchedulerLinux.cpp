@@ -1,6 +1,7 @@
 #include <scheduler/Scheduler.h>
 #include <iostream>
 
+#include <cerrno>
 #include <signal.h>
 #include <time.h>
 
@@ -0,0 +1,58 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <common/Histogram.h>
+#include <sstream>
+
+using namespace rboc::utils::metrics;
+
+TEST_CASE("HdrHistogram tests should pass", "[histogram]")
+{
+	SECTION("Percentiles of a uniform distribution should be within precision")
+	{
+		HdrHistogram hist(3600000000ull, 3);
+		for (uint64_t i = 1; i <= 100000; ++i)
+		{
+			hist.record(i);
+		}
+		CHECK(hist.count() == 100000);
+		CHECK(hist.min() == 1);
+		CHECK(hist.max() == 100000);
+		CHECK(hist.mean() == Approx(50000.5));
+		CHECK(hist.valueAtPercentile(50.0) == Approx(50000).epsilon(0.001));
+		CHECK(hist.valueAtPercentile(99.0) == Approx(99000).epsilon(0.001));
+		CHECK(hist.valueAtPercentile(99.99) == Approx(99990).epsilon(0.001));
+		CHECK(hist.valueAtPercentile(100.0) == 100000);
+	}
+	SECTION("Small values should be exact")
+	{
+		HdrHistogram hist;
+		hist.record(0);
+		hist.record(7, 3);
+		CHECK(hist.count() == 4);
+		CHECK(hist.valueAtPercentile(25.0) == 1);
+		CHECK(hist.valueAtPercentile(100.0) == 7);
+	}
+	SECTION("Outliers should land in the tail")
+	{
+		HdrHistogram hist;
+		hist.record(1000, 9999);
+		hist.record(50000000);
+		CHECK(hist.valueAtPercentile(99.9) == Approx(1000).epsilon(0.001));
+		CHECK(hist.valueAtPercentile(99.995) == Approx(50000000).epsilon(0.001));
+	}
+	SECTION("Merge and dump should work")
+	{
+		HdrHistogram a, b;
+		a.record(10);
+		b.record(20);
+		a.merge(b);
+		CHECK(a.count() == 2);
+		CHECK(a.max() == 20);
+		std::ostringstream out;
+		a.dump(out);
+		CHECK(out.str().find("Total count = 2") != std::string::npos);
+		HdrHistogram other(1000, 2);
+		CHECK_THROWS_AS(a.merge(other), std::invalid_argument);
+	}
+}
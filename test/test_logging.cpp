@@ -0,0 +1,280 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <logging/Logger.h>
+#include <algorithm>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace rboc::utils::logging;
+
+namespace // Anonymous namespace for test helpers
+{
+	//! Keeps every line written, and optionally holds the logger thread until opened.
+	class MemorySink : public Sink
+	{
+		public:
+
+		void write(const std::string* lines, size_t count) override
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			_holding = !_open;
+			_cond.wait(lock, [this]{ return _open; });
+			_holding = false;
+			_lines.insert(_lines.end(), lines, lines + count);
+		}
+
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			_open = false;
+		}
+
+		void open()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				_open = true;
+			}
+			_cond.notify_all();
+		}
+
+		//! true while the logger thread waits in write for open().
+		bool holding()
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			return _holding;
+		}
+
+		std::vector<std::string> lines()
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			return _lines;
+		}
+
+		//! The text after the "<time> <level> [<thread>] " prefix, without the newline.
+		std::vector<std::string> messages()
+		{
+			std::vector<std::string> result;
+			for (const auto& line : lines())
+			{
+				auto start = line.find("] ");
+				result.push_back(line.substr(start + 2, line.size() - start - 3));
+			}
+			return result;
+		}
+
+		private:
+
+		std::mutex _mtx;
+		std::condition_variable _cond;
+		bool _open = true;
+		bool _holding = false;
+		std::vector<std::string> _lines;
+	};
+
+	struct Point
+	{
+		int x;
+		int y;
+	};
+
+	std::ostream& operator<<(std::ostream& out, const Point& point)
+	{
+		return out << '(' << point.x << ", " << point.y << ')';
+	}
+}
+
+TEST_CASE("Logger tests should pass", "[logger]")
+{
+	SECTION("Messages should be formatted with their arguments as they were when logged")
+	{
+		auto sink = std::make_shared<MemorySink>();
+		{
+			Logger log{sink};
+			std::string name = "worker";
+			char buffer[16];
+			std::strcpy(buffer, "before");
+			log.info("{} {} took {} us", name, 7, 1.5);
+			log.warning("buffer {} flag {} point {}", buffer, true, Point{1, 2});
+			log.error("no placeholders", 'x', 42u);
+			name = "changed";
+			std::strcpy(buffer, "after");
+			log.flush();
+			auto messages = sink->messages();
+			REQUIRE(messages.size() == 3);
+			CHECK(messages[0] == "worker 7 took 1.5 us");
+			CHECK(messages[1] == "buffer before flag true point (1, 2)");
+			CHECK(messages[2] == "no placeholders x 42");
+			auto lines = sink->lines();
+			CHECK(lines[0].find(" INFO  [") != std::string::npos);
+			CHECK(lines[1].find(" WARN  [") != std::string::npos);
+			CHECK(lines[2].find(" ERROR [") != std::string::npos);
+			CHECK(lines[0].back() == '\n');
+		}
+	}
+	SECTION("Messages below the level should not be logged")
+	{
+		auto sink = std::make_shared<MemorySink>();
+		Logger log{sink, 64, OverflowPolicy::block, Level::warning};
+		CHECK_FALSE(log.info("hidden"));
+		CHECK(log.error("shown"));
+		log.setLevel(Level::debug);
+		CHECK(log.enabled(Level::debug));
+		CHECK_FALSE(log.enabled(Level::trace));
+		CHECK(log.debug("shown too"));
+		log.setLevel(Level::off);
+		CHECK_FALSE(log.error("hidden too"));
+		log.flush();
+		CHECK(sink->messages() == (std::vector<std::string>{"shown", "shown too"}));
+	}
+	SECTION("Large arguments should be logged too")
+	{
+		auto sink = std::make_shared<MemorySink>();
+		{
+			Logger log{sink};
+			std::string long_text(200, 'a');
+			log.info("{} {} {} {} {}", long_text, long_text, 1, 2, 3);
+		}
+		REQUIRE(sink->messages().size() == 1);
+		CHECK(sink->messages()[0].size() == 200 * 2 + 7);
+	}
+	SECTION("Every message of every thread should be written, in order per thread")
+	{
+		auto sink = std::make_shared<MemorySink>();
+		const int threads = 4;
+		const int messages = 2000;
+		{
+			Logger log{sink, 16, OverflowPolicy::block, Level::info, 32};
+			std::vector<std::thread> producers;
+			for (int t = 0; t < threads; ++t)
+			{
+				producers.emplace_back([&log, t, messages]
+				{
+					for (int i = 0; i < messages; ++i)
+					{
+						log.info("{} {}", t, i);
+					}
+				});
+			}
+			for (auto& producer : producers)
+			{
+				producer.join();
+			}
+		}
+		auto written = sink->messages();
+		REQUIRE(written.size() == threads * messages);
+		std::vector<int> next(threads, 0);
+		bool ordered = true;
+		for (const auto& message : written)
+		{
+			int t = 0, i = 0;
+			std::sscanf(message.c_str(), "%d %d", &t, &i);
+			ordered = ordered && i == next[t];
+			next[t] = i + 1;
+		}
+		CHECK(ordered);
+	}
+	SECTION("The drop policy should discard messages while the buffer is full and report them")
+	{
+		auto sink = std::make_shared<MemorySink>();
+		{
+			Logger log{sink, 4, OverflowPolicy::drop, Level::info, 1};
+			sink->close();
+			log.info("first");
+			while (!sink->holding()) // The logger thread holds "first", the buffer is empty.
+			{
+				std::this_thread::yield();
+			}
+			while (log.info("filling"))
+			{}
+			CHECK(log.dropped() == 1);
+			for (int i = 0; i < 10; ++i)
+			{
+				log.info("dropped");
+			}
+			CHECK(log.dropped() == 11);
+			sink->open();
+		}
+		auto messages = sink->messages();
+		CHECK(messages.size() == 6);
+		CHECK(std::count(messages.begin(), messages.end(), "filling") == 4);
+		CHECK(std::count(messages.begin(), messages.end(), "dropped") == 0);
+		CHECK(messages.back() == "11 messages dropped, the log buffers were full");
+	}
+	SECTION("A bad buffer capacity should throw")
+	{
+		CHECK_THROWS_AS(Logger(std::make_shared<MemorySink>(), 0), std::invalid_argument);
+	}
+#if !defined(_WIN32)
+	SECTION("The file sink should write the whole batch")
+	{
+		int fds[2];
+		REQUIRE(::pipe(fds) == 0);
+		{
+			Logger log{std::make_shared<FileSink>(fds[1])};
+			for (int i = 0; i < 100; ++i)
+			{
+				log.info("line {}", i);
+			}
+		}
+		::close(fds[1]);
+		std::string output;
+		char buffer[4096];
+		ssize_t n;
+		while ((n = ::read(fds[0], buffer, sizeof(buffer))) > 0)
+		{
+			output.append(buffer, static_cast<size_t>(n));
+		}
+		::close(fds[0]);
+		CHECK(std::count(output.begin(), output.end(), '\n') == 100);
+		CHECK(output.find("] line 0\n") != std::string::npos);
+		CHECK(output.find("] line 99\n") != std::string::npos);
+	}
+	SECTION("Pending messages should be written when the process crashes")
+	{
+		int fds[2];
+		REQUIRE(::pipe(fds) == 0);
+		pid_t child = ::fork();
+		REQUIRE(child >= 0);
+		if (child == 0)
+		{
+			::close(fds[0]);
+			std::signal(SIGABRT, SIG_DFL); // Not the test framework's handler.
+			Logger log{std::make_shared<FileSink>(fds[1]), 1024, OverflowPolicy::block, Level::info};
+			log.flushOnCrash();
+			for (int i = 0; i < 1000; ++i)
+			{
+				log.error("about to crash {}", i);
+			}
+			std::abort(); // Most messages are still in the buffer.
+		}
+		::close(fds[1]);
+		std::string output;
+		char buffer[4096];
+		ssize_t n;
+		while ((n = ::read(fds[0], buffer, sizeof(buffer))) > 0)
+		{
+			output.append(buffer, static_cast<size_t>(n));
+		}
+		::close(fds[0]);
+		int status = 0;
+		::waitpid(child, &status, 0);
+		CHECK(WIFSIGNALED(status));
+		CHECK(WTERMSIG(status) == SIGABRT);
+		CHECK(std::count(output.begin(), output.end(), '\n') == 1000);
+		CHECK(output.find("] about to crash 999\n") != std::string::npos);
+	}
+#endif
+}
@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <common/Metrics.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace rboc::utils::metrics;
+
+namespace // Anonymous namespace for test helpers
+{
+	//! Runs f(thread index) on `threads` threads and joins them.
+	template<typename F>
+	void runThreads(int threads, F f)
+	{
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back(f, t);
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+}
+
+TEST_CASE("Sharded metrics tests should pass", "[metrics]")
+{
+	SECTION("Counters should sum the increments of every thread")
+	{
+		ShardedCounter counter{4};
+		CHECK(counter.shards() == 4);
+		CHECK(counter.value() == 0);
+		runThreads(8, [&counter](int t)
+		{
+			for (int i = 0; i < 10000; ++i)
+			{
+				counter.increment();
+			}
+			counter.increment(t);
+		});
+		CHECK(counter.value() == 8 * 10000 + 28);
+		counter.reset();
+		CHECK(counter.value() == 0);
+		CHECK(ShardedCounter{3}.shards() == 4);
+		CHECK_THROWS_AS(ShardedCounter{0}, std::invalid_argument);
+	}
+	SECTION("Gauges should add up levels raised and lowered by different threads")
+	{
+		ShardedGauge gauge{2};
+		runThreads(4, [&gauge](int t)
+		{
+			for (int i = 0; i < 1000; ++i)
+			{
+				if (t % 2 == 0) gauge.increment(); else gauge.decrement();
+			}
+			gauge.add(5);
+		});
+		CHECK(gauge.value() == 20);
+	}
+	SECTION("Histograms should merge the values of every thread")
+	{
+		ShardedHistogram histogram{1000000, 3, 4};
+		runThreads(4, [&histogram](int t)
+		{
+			for (uint64_t i = 1; i <= 1000; ++i)
+			{
+				histogram.record(i + static_cast<uint64_t>(t) * 1000);
+			}
+		});
+		auto merged = histogram.snapshot();
+		CHECK(merged.count() == 4000);
+		CHECK(merged.min() == 1);
+		CHECK(merged.max() == 4000);
+		CHECK(merged.valueAtPercentile(50.0) == Approx(2000).epsilon(0.001));
+		histogram.reset();
+		CHECK(histogram.snapshot().count() == 0);
+	}
+	SECTION("Threads that exit should give their shard to the next ones")
+	{
+		std::vector<size_t> churned(32);
+		for (int t = 0; t < 32; ++t)
+		{
+			runThreads(1, [&churned, t](int){ churned[t] = details::threadShard(); });
+		}
+		CHECK(std::count(churned.begin(), churned.end(), churned[0]) == 32);
+
+		const int live = 4;
+		std::vector<size_t> ordinals(live);
+		std::atomic<int> arrived{0};
+		runThreads(live, [&](int t)
+		{
+			ordinals[t] = details::threadShard();
+			arrived.fetch_add(1);
+			while (arrived.load() < live) // Keep every ordinal taken until all are.
+			{
+				std::this_thread::yield();
+			}
+		});
+		std::sort(ordinals.begin(), ordinals.end());
+		CHECK(std::unique(ordinals.begin(), ordinals.end()) == ordinals.end());
+		CHECK(ordinals.back() <= static_cast<size_t>(live)); // Besides these, at most the main thread holds one.
+	}
+}
@@ -0,0 +1,128 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <common/ReadMostly.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rboc::utils::rcu;
+
+namespace // Anonymous namespace for test helpers
+{
+	std::atomic<int> live_versions{0};
+
+	//! A version whose two fields must always match, counting live instances.
+	struct Version
+	{
+		Version(int v = 0)
+			: a(v)
+			, b(-v)
+		{
+			live_versions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Version(const Version& other)
+			: a(other.a)
+			, b(other.b)
+		{
+			live_versions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		~Version()
+		{
+			live_versions.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		int a;
+		int b;
+	};
+}
+
+TEST_CASE("ReadMostly tests should pass", "[read_mostly]")
+{
+	live_versions = 0;
+	SECTION("Readers should see the version current when they read")
+	{
+		ReadMostly<std::map<std::string, int>> flags;
+		CHECK(flags.read()->empty());
+		flags.update([](std::map<std::string, int>& copy) { copy["fast_path"] = 1; });
+		auto before = flags.read();
+		flags.update([](std::map<std::string, int>& copy) { copy["fast_path"] = 2; });
+		CHECK(before->at("fast_path") == 1);
+		CHECK(flags.read()->at("fast_path") == 2);
+		CHECK(flags.load().size() == 1);
+	}
+	SECTION("Replaced versions should be reclaimed once their readers leave")
+	{
+		{
+			ReadMostly<Version> config{Version(1)};
+			CHECK(live_versions == 1);
+			{
+				auto snapshot = config.read();
+				auto nested = config.read();
+				config.store(Version(2));
+				CHECK(config.pending() == 1);
+				config.reclaim();
+				CHECK(config.pending() == 1);
+				CHECK(snapshot->a == 1);
+				CHECK(nested->a == 1);
+			}
+			config.reclaim();
+			CHECK(config.pending() == 0);
+			CHECK(live_versions == 1);
+			config.store(Version(3)); // No reader: reclaimed right away.
+			CHECK(config.pending() == 0);
+			CHECK(config.load().a == 3);
+		}
+		CHECK(live_versions == 0);
+	}
+	SECTION("Concurrent readers should never see a torn or freed version")
+	{
+		ReadMostly<Version> config{Version(0)};
+		std::atomic<bool> done{false};
+		std::atomic<int> torn{0};
+		std::vector<std::thread> readers;
+		for (int r = 0; r < 4; ++r)
+		{
+			readers.emplace_back([&]
+			{
+				while (!done.load(std::memory_order_relaxed))
+				{
+					auto snapshot = config.read();
+					if (snapshot->a != -snapshot->b)
+					{
+						torn.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			});
+		}
+		std::thread writer([&]
+		{
+			for (int i = 1; i <= 2000; ++i)
+			{
+				if (i % 2 == 0)
+				{
+					config.store(Version(i));
+				}
+				else
+				{
+					config.update([i](Version& copy) { copy.a = i; copy.b = -i; });
+				}
+			}
+		});
+		writer.join();
+		done = true;
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+		config.synchronize();
+		CHECK(torn == 0);
+		CHECK(config.pending() == 0);
+		CHECK(config.load().a == 2000);
+		CHECK(live_versions == 1);
+	}
+}
@@ -2,10 +2,44 @@
 #include <catch.hpp>
 
 #include <utility>
+#include <functional>
+#include <algorithm>
+#include <vector>
+#include <numeric>
+#include <random>
 #include <thread/ActiveWorker.h>
 #include <thread/Threadpool.h>
+#include <thread/EventCount.h>
+#include <thread/TaskAllocator.h>
+#include <thread/RateLimitedExecutor.h>
+#include <thread/Trace.h>
+#include <thread/BlockingRegion.h>
+#include <thread/WorkerLocal.h>
+#include <thread/TaskGroup.h>
+#include <thread/ForkJoin.h>
+#include <thread/Algorithms.h>
+#include <thread/Channel.h>
+#include <thread/Pipeline.h>
+#include <thread/SpscQueue.h>
+#include <thread/Reclamation.h>
+#include <thread/ConcurrentHashMap.h>
+#include <thread/Synchronization.h>
+#include <thread/PoolBarrier.h>
+#include <thread/ThreadOptions.h>
+#include <thread/Reactor.h>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <stdexcept>
 #include <common/Utility.h>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
 using namespace rboc::utils;
 using namespace rboc::utils::threading;
 
@@ -25,6 +59,20 @@ namespace // Anonymous namespace for test functions
 	};
 }
 
+namespace // Anonymous namespace for fork-join helpers
+{
+	long fib(ForkJoin& fj, int n)
+	{
+		if (n < 12)
+		{
+			return n < 2 ? n : fib(fj, n - 1) + fib(fj, n - 2);
+		}
+		long a = 0, b = 0;
+		fj.invoke([&]{ a = fib(fj, n - 1); }, [&]{ b = fib(fj, n - 2); });
+		return a + b;
+	}
+}
+
 TEST_CASE("Active Worker tests should pass", "[active_worker]")
 {
 	SECTION("ActiveWorker<int, int> should pass")
@@ -92,3 +140,1505 @@ TEST_CASE("ThreadPool tests should pass", "[thread_pool]")
 		CHECK(inc == 10000);		
 	}
 }
+
+TEST_CASE("EventCount tests should pass", "[event_count]")
+{
+	SECTION("Notify without waiters should be a no-op")
+	{
+		EventCount ec;
+		CHECK_FALSE(ec.hasWaiters());
+		ec.notify();
+		ec.notifyAll();
+		auto key = ec.prepareWait();
+		CHECK(ec.hasWaiters());
+		ec.cancelWait();
+		CHECK_FALSE(ec.hasWaiters());
+		CHECK(ec.prepareWait() == key); // No notification was consumed.
+		ec.cancelWait();
+	}
+	SECTION("A parked consumer should see every published item")
+	{
+		EventCount ec;
+		std::atomic<int> published{0};
+		int consumed = 0;
+		const int items = 10000;
+		std::thread consumer([&]
+		{
+			while (consumed < items)
+			{
+				if (published.load() > consumed) { ++consumed; continue; }
+				auto key = ec.prepareWait();
+				if (published.load() > consumed) { ec.cancelWait(); continue; }
+				ec.wait(key);
+			}
+		});
+		for (int i = 0; i < items; ++i)
+		{
+			published.fetch_add(1);
+			ec.notify();
+		}
+		consumer.join();
+		CHECK(consumed == items);
+	}
+}
+
+TEST_CASE("TaskAllocator tests should pass", "[task_allocator]")
+{
+	SECTION("Blocks should be recycled by the allocating thread")
+	{
+		TaskAllocator<char> alloc;
+		auto p = alloc.allocate(1000);
+		alloc.deallocate(p, 1000);
+		auto q = alloc.allocate(1000);
+		CHECK(p == q);
+		alloc.deallocate(q, 1000);
+	}
+	SECTION("Blocks freed by another thread should return to their origin")
+	{
+		TaskAllocator<char> alloc;
+		auto p = alloc.allocate(2000);
+		std::thread other([&]
+		{
+			alloc.deallocate(p, 2000);
+			flushTaskAllocatorCache();
+		});
+		other.join();
+		auto q = alloc.allocate(2000);
+		CHECK(p == q);
+		alloc.deallocate(q, 2000);
+	}
+	SECTION("Requests whose size overflows should throw bad_alloc")
+	{
+		TaskAllocator<char> bytes;
+		CHECK_THROWS_AS(bytes.allocate(SIZE_MAX), std::bad_alloc);
+		CHECK_THROWS_AS(bytes.allocate(SIZE_MAX - 8), std::bad_alloc);
+		TaskAllocator<uint64_t> words;
+		CHECK_THROWS_AS(words.allocate(SIZE_MAX / sizeof(uint64_t) + 1), std::bad_alloc);
+		CHECK_THROWS_AS(words.allocate(SIZE_MAX / 4), std::bad_alloc);
+	}
+	SECTION("Workers and pools should accept the allocator")
+	{
+		ActiveWorker<int, int> worker;
+		auto fut = worker.addWork(std::allocator_arg, TaskAllocator<char>{}, increment, 1);
+		CHECK(fut.get() == 2);
+
+		std::atomic<int> inc{0};
+		ThreadPool<void> tp{4};
+		std::vector<std::future<void>> results;
+		for (size_t i = 0; i < 10000; i++)
+		{
+			results.emplace_back(tp.addTask(std::allocator_arg, TaskAllocator<char>{}, [&inc]{ ++inc; }));
+		}
+		std::for_each(results.begin(), results.end(), [](std::future<void>& fut) { fut.get(); });
+		CHECK(inc == 10000);
+	}
+}
+
+TEST_CASE("Deadline tasks should be shed when expired", "[deadline]")
+{
+	SECTION("ActiveWorker should drop expired tasks at dequeue time")
+	{
+		ActiveWorker<int> worker;
+		std::promise<void> gate;
+		auto gate_future = gate.get_future().share();
+		auto blocker = worker.addWork([gate_future]{ gate_future.wait(); return 0; });
+
+		auto now = std::chrono::steady_clock::now();
+		bool executed = false;
+		auto expired = worker.addWork(now + std::chrono::milliseconds(1), [&executed]{ executed = true; return 1; });
+		auto alive = worker.addWork(now + std::chrono::hours(1), []{ return 2; });
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		gate.set_value();
+		CHECK(blocker.get() == 0);
+		CHECK_THROWS_AS(expired.get(), TaskExpiredException);
+		CHECK(alive.get() == 2);
+		CHECK_FALSE(executed);
+		CHECK(worker.shedCount() == 1);
+	}
+	SECTION("ThreadPool should count shed tasks across workers")
+	{
+		ThreadPool<int, int> tp{2};
+		auto past = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+		auto f1 = tp.addTask(past, increment, 1);
+		auto f2 = tp.addTask(past, increment, 2);
+		auto f3 = tp.addTask(std::chrono::steady_clock::now() + std::chrono::hours(1), increment, 3);
+		CHECK_THROWS_AS(f1.get(), TaskExpiredException);
+		CHECK_THROWS_AS(f2.get(), TaskExpiredException);
+		CHECK(f3.get() == 4);
+		CHECK(tp.shedCount() == 2);
+	}
+}
+
+TEST_CASE("RateLimitedExecutor tests should pass", "[rate_limited_executor]")
+{
+	SECTION("Tasks beyond the burst should be released at the configured rate")
+	{
+		ThreadPool<int, int> tp{2};
+		RateLimitedExecutor<int, int> executor(tp, 200.0, 5);
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::future<int>> results;
+		for (int i = 0; i < 25; ++i)
+		{
+			results.emplace_back(executor.addTask(increment, i));
+		}
+		for (int i = 0; i < 25; ++i)
+		{
+			CHECK(results[i].get() == i + 1);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		// 5 tasks ride the burst, the other 20 need 100ms worth of tokens.
+		CHECK(elapsed >= std::chrono::milliseconds(90));
+		CHECK(executor.pending() == 0);
+	}
+	SECTION("Invalid rates should be rejected")
+	{
+		ThreadPool<void> tp{1};
+		CHECK_THROWS_AS(RateLimitedExecutor<void>(tp, 0.0, 1), std::invalid_argument);
+		CHECK_THROWS_AS(RateLimitedExecutor<void>(tp, std::nan(""), 1), std::invalid_argument);
+		CHECK_THROWS_AS(RateLimitedExecutor<void>(tp, std::numeric_limits<double>::infinity(), 1), std::invalid_argument);
+	}
+	SECTION("A tiny rate should hold tasks back without spinning")
+	{
+		ThreadPool<void> tp{1};
+		std::atomic<int> released{0};
+		{
+			RateLimitedExecutor<void> executor(tp, 1e-300, 1);
+			executor.addTask([&released]{ ++released; }).get();
+			executor.addTask([&released]{ ++released; });
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			CHECK(executor.pending() == 1);
+		}
+		CHECK(released.load() == 1);
+	}
+}
+
+TEST_CASE("Task tracing should record submit, start and end events", "[trace]")
+{
+#if RBOC_THREADING_TRACE
+	trace::clear();
+	trace::enable();
+	{
+		ThreadPool<int, int> tp{2};
+		auto f1 = tp.addTask(increment, 1);
+		auto f2 = tp.addTask(increment, 2);
+		CHECK(f1.get() == 2);
+		CHECK(f2.get() == 3);
+	}
+	trace::disable();
+	std::ostringstream out;
+	CHECK(trace::writeChromeTrace(out) == 0);
+	auto json = out.str();
+	auto count = [&json](const std::string& needle)
+	{
+		size_t n = 0;
+		for (auto pos = json.find(needle); pos != std::string::npos; pos = json.find(needle, pos + 1)) ++n;
+		return n;
+	};
+	CHECK(json.find("\"traceEvents\"") != std::string::npos);
+	CHECK(count("\"ph\":\"i\"") == 2);
+	CHECK(count("\"ph\":\"B\"") == 2);
+	CHECK(count("\"ph\":\"E\"") == 2);
+	trace::clear();
+#else
+	trace::enable();
+	CHECK_FALSE(trace::enabled());
+#endif
+}
+
+TEST_CASE("Blocking regions should be compensated by the pool", "[blocking_region]")
+{
+	SECTION("A task queued behind a blocked task should still run")
+	{
+		ThreadPool<void> tp{1};
+		std::promise<void> unblock;
+		auto unblocked = unblock.get_future();
+		auto blocked = tp.addTask([&unblocked]
+		{
+			BlockingRegion region;
+			unblocked.wait();
+		});
+		// Same (single) worker: only a compensating thread can run this one.
+		auto releaser = tp.addTask([&unblock]{ unblock.set_value(); });
+		CHECK(releaser.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+		CHECK(blocked.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+	}
+	SECTION("New tasks should avoid blocked workers")
+	{
+		ThreadPool<int> tp{2};
+		std::promise<void> unblock;
+		auto unblocked = unblock.get_future().share();
+		std::atomic_bool inside{false};
+		auto blocked = tp.addTask([&]
+		{
+			return blocking([&]
+			{
+				inside = true;
+				unblocked.wait();
+				return 1;
+			});
+		});
+		while (!inside) std::this_thread::yield();
+		std::vector<std::future<int>> results;
+		for (int i = 0; i < 100; ++i)
+		{
+			results.emplace_back(tp.addTask([]{ return 2; }));
+		}
+		for (auto& result : results)
+		{
+			CHECK(result.get() == 2);
+		}
+		unblock.set_value();
+		CHECK(blocked.get() == 1);
+	}
+	SECTION("Outside a pool a region should be a no-op")
+	{
+		CHECK(blocking([]{ return 3; }) == 3);
+		ActiveWorker<int> worker;
+		CHECK(worker.addWork([]{ BlockingRegion region; return 4; }).get() == 4);
+		CHECK_FALSE(worker.blocked());
+	}
+}
+
+TEST_CASE("WorkerLocal should give every worker its own instance", "[worker_local]")
+{
+	SECTION("Tasks should know the worker running them")
+	{
+		ThreadPool<size_t> tp{3};
+		CHECK_FALSE(tp.currentWorker());
+		std::vector<std::future<size_t>> results;
+		for (int i = 0; i < 30; ++i)
+		{
+			results.emplace_back(tp.addTask([&tp]{ return tp.currentWorker() ? *tp.currentWorker() : tp.size(); }));
+		}
+		for (auto& result : results)
+		{
+			CHECK(result.get() < tp.size());
+		}
+	}
+	SECTION("Per-worker counters should combine to the total")
+	{
+		ThreadPool<void> tp{4};
+		WorkerLocal<int> counters{tp};
+		std::vector<std::future<void>> results;
+		for (int i = 0; i < 10000; ++i)
+		{
+			results.emplace_back(tp.addTask([&counters]{ ++counters.local(); }));
+		}
+		for (auto& result : results)
+		{
+			result.get();
+		}
+		CHECK(counters.combine(0, std::plus<int>()) == 10000);
+		int instances = 0;
+		counters.forEach([&instances](int&){ ++instances; });
+		CHECK(instances <= 4);
+	}
+	SECTION("Threads outside the pool should get their own instance")
+	{
+		ThreadPool<void> tp{2};
+		WorkerLocal<std::vector<int>> buffers{tp, []{ return std::vector<int>(1, 7); }};
+		buffers.local().push_back(8);
+		CHECK(buffers.local().size() == 2);
+		tp.addTask([&buffers]{ buffers.local().push_back(9); }).get();
+		CHECK(buffers.combine(size_t(0), [](size_t acc, const std::vector<int>& v){ return acc + v.size(); }) == 4);
+	}
+}
+
+TEST_CASE("TaskGroup tests should pass", "[task_group]")
+{
+	SECTION("wait should return once every task has run")
+	{
+		ThreadPool<void> tp{4};
+		std::atomic<int> count{0};
+		TaskGroup group{tp};
+		for (int i = 0; i < 1000; ++i)
+		{
+			group.run([&count]{ ++count; });
+		}
+		group.wait();
+		CHECK(count == 1000);
+		group.wait(); // Nothing outstanding.
+	}
+	SECTION("The first exception should be rethrown and cancel the rest")
+	{
+		ThreadPool<void> tp{1};
+		std::promise<void> gate;
+		auto opened = gate.get_future().share();
+		std::atomic<int> count{0};
+		TaskGroup group{tp};
+		group.run([opened]{ opened.wait(); throw std::runtime_error("failed"); });
+		for (int i = 0; i < 100; ++i)
+		{
+			group.run([&count]{ ++count; });
+		}
+		gate.set_value();
+		CHECK_THROWS_AS(group.wait(), std::runtime_error);
+		CHECK(count == 0);
+		CHECK_FALSE(group.cancelled());
+		group.run([&count]{ ++count; });
+		CHECK_NOTHROW(group.wait());
+		CHECK(count == 1);
+	}
+	SECTION("Nested groups should not deadlock a single worker")
+	{
+		ThreadPool<void> tp{1};
+		std::atomic<int> count{0};
+		TaskGroup outer{tp};
+		for (int i = 0; i < 4; ++i)
+		{
+			outer.run([&tp, &count]
+			{
+				TaskGroup inner{tp};
+				for (int j = 0; j < 10; ++j)
+				{
+					inner.run([&count]{ ++count; });
+				}
+				inner.wait();
+			});
+		}
+		outer.wait();
+		CHECK(count == 40);
+	}
+}
+
+TEST_CASE("ForkJoin spawn and sync should pass", "[fork_join]")
+{
+	SECTION("Recursive invoke should compute the serial result")
+	{
+		ThreadPool<void> tp{4};
+		ForkJoin fj{tp};
+		CHECK(fib(fj, 25) == 75025);
+		CHECK(tp.addTask([&fj]{ CHECK(fib(fj, 20) == 6765); }).wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	}
+	SECTION("A scope should join every spawned child")
+	{
+		ThreadPool<void> tp{3};
+		ForkJoin fj{tp};
+		std::vector<int> values(1000, 0);
+		{
+			SyncScope scope{fj};
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				scope.spawn([&values, i]{ values[i] = static_cast<int>(i); });
+			}
+			scope.sync();
+		}
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			CHECK(values[i] == static_cast<int>(i));
+		}
+	}
+	SECTION("Child exceptions should be rethrown by sync")
+	{
+		ThreadPool<void> tp{2};
+		ForkJoin fj{tp};
+		SyncScope scope{fj};
+		scope.spawn([]{ throw std::runtime_error("child"); });
+		scope.spawn([]{});
+		CHECK_THROWS_AS(scope.sync(), std::runtime_error);
+		CHECK_NOTHROW(scope.sync());
+	}
+#if defined(__linux__)
+	SECTION("A joiner with nothing to take should sleep while a stolen child runs")
+	{
+		ThreadPool<void> tp{2};
+		ForkJoin fj{tp};
+		std::atomic<bool> started{false};
+		auto before = details::threadCpuTime(pthread_self());
+		fj.invoke([&started]
+		{
+			while (!started.load()) // Let a helper steal the child.
+			{
+				std::this_thread::yield();
+			}
+		}, [&started]
+		{
+			started = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		});
+		CHECK(details::threadCpuTime(pthread_self()) - before < std::chrono::milliseconds(100));
+	}
+#endif
+}
+
+TEST_CASE("Parallel algorithms should match the sequential ones", "[algorithms]")
+{
+	ThreadPool<void> tp{4};
+	const size_t grain = 64; // Small enough to exercise the parallel paths.
+	std::mt19937 rng(42);
+	std::vector<int> input(100000);
+	for (auto& x : input)
+	{
+		x = static_cast<int>(rng() % 1000);
+	}
+
+	SECTION("sort")
+	{
+		auto values = input;
+		parallel::sort(tp, values.begin(), values.end(), std::greater<int>(), grain);
+		auto expected = input;
+		std::sort(expected.begin(), expected.end(), std::greater<int>());
+		CHECK(values == expected);
+		std::vector<std::string> words{"pear", "apple", "fig"};
+		parallel::sort(tp, words.begin(), words.end());
+		CHECK(words == (std::vector<std::string>{"apple", "fig", "pear"}));
+	}
+	SECTION("sort of types left empty by a move")
+	{
+		std::vector<std::string> words;
+		for (size_t i = 0; i < 20000; ++i)
+		{
+			words.push_back("a long enough prefix to be on the heap " + std::to_string(input[i]) + "/" + std::to_string(i));
+		}
+		auto expected = words;
+		std::sort(expected.begin(), expected.end());
+		parallel::sort(tp, words.begin(), words.end(), std::less<std::string>(), grain);
+		CHECK(words == expected);
+
+		std::vector<std::unique_ptr<int>> pointers;
+		for (size_t i = 0; i < 20000; ++i)
+		{
+			pointers.emplace_back(new int(input[i]));
+		}
+		parallel::sort(tp, pointers.begin(), pointers.end(),
+			[](const std::unique_ptr<int>& a, const std::unique_ptr<int>& b){ return *a < *b; }, grain);
+		std::vector<int> sorted_values;
+		for (const auto& pointer : pointers)
+		{
+			REQUIRE(pointer != nullptr);
+			sorted_values.push_back(*pointer);
+		}
+		auto expected_values = std::vector<int>(input.begin(), input.begin() + 20000);
+		std::sort(expected_values.begin(), expected_values.end());
+		CHECK(sorted_values == expected_values);
+	}
+	SECTION("transform")
+	{
+		std::vector<long> out(input.size());
+		auto end = parallel::transform(tp, input.begin(), input.end(), out.begin(), [](int x){ return 2L * x; }, grain);
+		CHECK(end == out.end());
+		for (size_t i = 0; i < input.size(); ++i)
+		{
+			REQUIRE(out[i] == 2L * input[i]);
+		}
+	}
+	SECTION("scans")
+	{
+		std::vector<int> expected(input.size());
+		std::partial_sum(input.begin(), input.end(), expected.begin());
+		std::vector<int> out(input.size());
+		parallel::inclusiveScan(tp, input.begin(), input.end(), out.begin(), std::plus<int>(), grain);
+		CHECK(out == expected);
+
+		auto in_place = input;
+		parallel::exclusiveScan(tp, in_place.begin(), in_place.end(), in_place.begin(), 10, std::plus<int>(), grain);
+		CHECK(in_place[0] == 10);
+		for (size_t i = 1; i < input.size(); ++i)
+		{
+			REQUIRE(in_place[i] == expected[i - 1] + 10);
+		}
+	}
+	SECTION("partition")
+	{
+		auto values = input;
+		auto pred = [](int x){ return x % 3 == 0; };
+		auto split = parallel::partition(tp, values.begin(), values.end(), pred, grain);
+		CHECK(std::all_of(values.begin(), split, pred));
+		CHECK(std::none_of(split, values.end(), pred));
+		CHECK(split - values.begin() == std::count_if(input.begin(), input.end(), pred));
+		auto sorted_in = input, sorted_out = values;
+		std::sort(sorted_in.begin(), sorted_in.end());
+		std::sort(sorted_out.begin(), sorted_out.end());
+		CHECK(sorted_in == sorted_out);
+	}
+	SECTION("copyIf")
+	{
+		auto pred = [](int x){ return x < 100; };
+		std::vector<int> expected;
+		std::copy_if(input.begin(), input.end(), std::back_inserter(expected), pred);
+		std::vector<int> out(input.size());
+		auto end = parallel::copyIf(tp, input.begin(), input.end(), out.begin(), pred, grain);
+		out.erase(end, out.end());
+		CHECK(out == expected);
+	}
+	SECTION("find")
+	{
+		auto values = input;
+		values[70000] = 5000;
+		values[90000] = 5000;
+		CHECK(parallel::find(tp, values.begin(), values.end(), 5000, grain) - values.begin() == 70000);
+		CHECK(parallel::find(tp, values.begin(), values.end(), -1, grain) == values.end());
+		CHECK(parallel::findIf(tp, values.begin(), values.end(), [](int x){ return x >= 0; }, grain) == values.begin());
+	}
+}
+
+TEST_CASE("Pipeline tests should pass", "[pipeline]")
+{
+	SECTION("Items should flow through every stage in order")
+	{
+		Pipeline<std::string> pipeline{8};
+		auto numbers = pipeline.serial("parse", [](std::string&& s){ return std::stoi(s); })
+			.serial("square", [](int&& x){ return x * x; });
+		std::thread producer([&numbers]
+		{
+			for (int i = 0; i < 100; ++i)
+			{
+				numbers.push(std::to_string(i));
+			}
+			numbers.close();
+		});
+		std::vector<int> out;
+		int value = 0;
+		while (numbers.pop(value))
+		{
+			out.push_back(value);
+		}
+		producer.join();
+		numbers.wait();
+		REQUIRE(out.size() == 100);
+		for (int i = 0; i < 100; ++i)
+		{
+			CHECK(out[i] == i * i);
+		}
+		auto stats = numbers.stats();
+		REQUIRE(stats.size() == 2);
+		CHECK(stats[0].name == "parse");
+		CHECK(stats[1].items == 100);
+	}
+	SECTION("Parallel stages and sinks should see every item once")
+	{
+		Pipeline<int> pipeline{4};
+		std::atomic<long> sum{0};
+		auto sink = pipeline.parallel("double", 3, [](int&& x){ return 2L * x; })
+			.serial("sum", [&sum](long&& x){ sum += x; });
+		for (int i = 1; i <= 1000; ++i)
+		{
+			CHECK(sink.push(i));
+		}
+		sink.close();
+		sink.wait();
+		CHECK(sum == 1001000);
+		auto stats = sink.stats();
+		CHECK(stats[0].width == 3);
+		CHECK(stats[0].capacity == 4);
+		CHECK(stats[1].queued == 0);
+	}
+	SECTION("A failing stage should stop the pipeline and rethrow")
+	{
+		Pipeline<int> pipeline{2};
+		auto sink = pipeline.serial("check", [](int&& x){ if (x == 10) throw std::runtime_error("bad"); return x; })
+			.serial("drop", [](int&&){});
+		bool accepted = true;
+		for (int i = 0; i < 1000 && accepted; ++i)
+		{
+			accepted = sink.push(i);
+		}
+		CHECK_FALSE(accepted);
+		CHECK_THROWS_AS(sink.wait(), std::runtime_error);
+	}
+}
+
+namespace // Anonymous namespace for channel helpers
+{
+	//! An item with no default constructor that counts the live instances.
+	struct Counted
+	{
+		Counted(int v, std::shared_ptr<std::atomic<int>> l) : value(v), live(std::move(l)) { ++*live; }
+		Counted(Counted&& other) noexcept : value(other.value), live(other.live) { ++*live; }
+		Counted& operator=(Counted&& other) noexcept { value = other.value; return *this; }
+		~Counted() { --*live; }
+
+		int value;
+		std::shared_ptr<std::atomic<int>> live;
+	};
+}
+
+TEST_CASE("Channel tests should pass", "[channel]")
+{
+	SECTION("Items need no default constructor and are destroyed with the channel")
+	{
+		auto live = std::make_shared<std::atomic<int>>(0);
+		{
+			Channel<Counted> channel{8};
+			for (int i = 0; i < 6; ++i)
+			{
+				REQUIRE(channel.send(Counted{i, live}));
+			}
+			std::vector<Counted> received;
+			CHECK(channel.recvBatch(std::back_inserter(received), 2) == 2);
+			CHECK(received[0].value == 0);
+			CHECK(received[1].value == 1);
+			CHECK(live->load() == 6);
+		}
+		CHECK(live->load() == 0);
+	}
+	SECTION("Non-blocking operations should report full, empty and closed")
+	{
+		Channel<std::unique_ptr<int>> channel{3};
+		CHECK(channel.capacity() == 4);
+		std::unique_ptr<int> item;
+		CHECK(channel.tryRecv(item) == ChannelStatus::empty);
+		for (int i = 0; i < 4; ++i)
+		{
+			CHECK(channel.trySend(std::unique_ptr<int>(new int(i))) == ChannelStatus::success);
+		}
+		auto rejected = std::unique_ptr<int>(new int(4));
+		CHECK(channel.trySend(std::move(rejected)) == ChannelStatus::full);
+		CHECK(rejected); // Left untouched.
+		CHECK(channel.size() == 4);
+		channel.close();
+		CHECK(channel.trySend(std::move(rejected)) == ChannelStatus::closed);
+		for (int i = 0; i < 4; ++i)
+		{
+			REQUIRE(channel.tryRecv(item) == ChannelStatus::success);
+			CHECK(*item == i);
+		}
+		CHECK(channel.tryRecv(item) == ChannelStatus::closed);
+		CHECK_FALSE(channel.recv(item));
+	}
+	SECTION("Timed operations should give up")
+	{
+		Channel<int> channel{1};
+		CHECK(channel.capacity() == 2);
+		int item = 0;
+		CHECK(channel.recvFor(item, std::chrono::milliseconds(10)) == ChannelStatus::timeout);
+		CHECK(channel.sendFor(1, std::chrono::milliseconds(10)) == ChannelStatus::success);
+		CHECK(channel.sendFor(2, std::chrono::milliseconds(10)) == ChannelStatus::success);
+		CHECK(channel.sendFor(3, std::chrono::milliseconds(10)) == ChannelStatus::timeout);
+		CHECK(channel.recvFor(item, std::chrono::milliseconds(10)) == ChannelStatus::success);
+		CHECK(item == 1);
+	}
+	SECTION("Every item should be received exactly once by several consumers")
+	{
+		Channel<int> channel{16};
+		const int producers = 3, per_producer = 20000;
+		std::atomic<size_t> sent{0};
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p)
+		{
+			threads.emplace_back([&channel, &sent, p, per_producer]
+			{
+				std::vector<int> batch;
+				for (int i = 0; i < per_producer; ++i)
+				{
+					batch.push_back(p * per_producer + i);
+					if (batch.size() == 7 || i + 1 == per_producer)
+					{
+						sent += channel.sendBatch(batch.begin(), batch.end());
+						batch.clear();
+					}
+				}
+			});
+		}
+		std::vector<std::vector<int>> received(3);
+		std::vector<std::thread> consumers;
+		for (size_t c = 0; c < received.size(); ++c)
+		{
+			consumers.emplace_back([&channel, &received, c]
+			{
+				int item = 0;
+				if (c == 0)
+				{
+					while (channel.recvBatch(std::back_inserter(received[c]), 5) != 0) {}
+				}
+				else
+				{
+					while (channel.recv(item)) received[c].push_back(item);
+				}
+			});
+		}
+		for (auto& t : threads) t.join();
+		CHECK(sent == static_cast<size_t>(producers * per_producer));
+		channel.close();
+		for (auto& t : consumers) t.join();
+		std::vector<int> all;
+		for (auto& part : received)
+		{
+			all.insert(all.end(), part.begin(), part.end());
+		}
+		std::sort(all.begin(), all.end());
+		REQUIRE(all.size() == static_cast<size_t>(producers * per_producer));
+		for (size_t i = 0; i < all.size(); ++i)
+		{
+			REQUIRE(all[i] == static_cast<int>(i));
+		}
+	}
+}
+
+namespace // Anonymous namespace for reclamation helpers
+{
+	std::atomic<int> reclaimed_nodes{0};
+
+	struct CountedNode
+	{
+		explicit CountedNode(int node_value, CountedNode* next_node = nullptr)
+			: value(node_value)
+			, next(next_node)
+		{}
+
+		~CountedNode()
+		{
+			reclaimed_nodes.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		int value;
+		CountedNode* next;
+	};
+}
+
+TEST_CASE("Memory reclamation tests should pass", "[reclamation]")
+{
+	reclaimed_nodes = 0;
+	SECTION("Objects retired by an epoch domain should wait for pinned threads")
+	{
+		EpochDomain domain{4};
+		{
+			EpochGuard guard{domain};
+			EpochGuard nested{domain};
+			for (int i = 0; i < 10; ++i)
+			{
+				domain.retire(new CountedNode(i));
+			}
+			domain.collect();
+			CHECK(reclaimed_nodes == 0);
+		}
+		domain.collect();
+		CHECK(reclaimed_nodes == 10);
+		CHECK(domain.epoch() >= 2);
+	}
+	SECTION("Destroying an epoch domain should reclaim what is still retired")
+	{
+		{
+			EpochDomain domain;
+			EpochGuard guard{domain};
+			domain.retire(new CountedNode(1));
+		}
+		CHECK(reclaimed_nodes == 1);
+	}
+	SECTION("Pool workers should reclaim between tasks")
+	{
+		ThreadPool<void> pool{1};
+		EpochDomain domain{1024};
+		pool.addTask([&domain]
+		{
+			EpochGuard guard{domain};
+			for (int i = 0; i < 10; ++i)
+			{
+				domain.retire(new CountedNode(i));
+			}
+		}).get();
+		// The first boundary seals and advances, the second advances and reclaims.
+		pool.addTask([]{}).get();
+		pool.addTask([]{}).get();
+		CHECK(reclaimed_nodes == 10);
+	}
+	SECTION("A lock-free stack should reclaim every node it pops")
+	{
+		const int threads = 4;
+		const int count = 20000;
+		std::atomic<int> popped{0};
+		{
+			EpochDomain domain{32};
+			std::atomic<CountedNode*> head{nullptr};
+			std::vector<std::thread> workers;
+			for (int t = 0; t < threads; ++t)
+			{
+				workers.emplace_back([&]
+				{
+					for (int i = 0; i < count; ++i)
+					{
+						auto node = new CountedNode(i, head.load(std::memory_order_relaxed));
+						while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+						{}
+						EpochGuard guard{domain};
+						auto top = head.load(std::memory_order_acquire);
+						while (top != nullptr && !head.compare_exchange_weak(top, top->next, std::memory_order_acquire, std::memory_order_acquire))
+						{}
+						if (top != nullptr)
+						{
+							domain.retire(top);
+							popped.fetch_add(1, std::memory_order_relaxed);
+						}
+					}
+				});
+			}
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+			CHECK(head.load() == nullptr);
+		}
+		CHECK(popped == threads * count);
+		CHECK(reclaimed_nodes == threads * count);
+	}
+	SECTION("Hazard pointers should keep the protected object alive")
+	{
+		HazardDomain domain{1};
+		std::atomic<CountedNode*> shared{new CountedNode(7)};
+		{
+			HazardPointer hazard{domain};
+			auto node = hazard.protect(shared);
+			REQUIRE(node != nullptr);
+			shared.store(nullptr);
+			domain.retire(node);
+			domain.retire(new CountedNode(8));
+			domain.collect();
+			CHECK(reclaimed_nodes == 1);
+			CHECK(node->value == 7);
+			hazard.reset();
+			domain.collect();
+			CHECK(reclaimed_nodes == 2);
+		}
+		std::thread retiring([&domain]{ domain.retire(new CountedNode(9)); });
+		retiring.join(); // Left to the domain when the thread exits.
+		domain.collect();
+		CHECK(reclaimed_nodes == 3);
+	}
+}
+
+TEST_CASE("ConcurrentHashMap tests should pass", "[concurrent_hash_map]")
+{
+	SECTION("Insert, assign, find, compute and erase should behave like a map")
+	{
+		ConcurrentHashMap<std::string, int> map{4};
+		CHECK(map.empty());
+		CHECK(map.insertOrAssign("one", 1));
+		CHECK_FALSE(map.insertOrAssign("one", 11));
+		CHECK(map.insertOrAssign("two", 2));
+		CHECK(map.size() == 2);
+		CHECK(map.find("one").value() == 11);
+		CHECK_FALSE(map.find("three").has_value());
+		CHECK(map.contains("two"));
+
+		auto increment = [](const optional::Optional<int>& current) { return optional::Optional<int>(current.value_or(0) + 1); };
+		CHECK(map.compute("two", increment).value() == 3);
+		CHECK(map.compute("three", increment).value() == 1);
+		auto remove = [](const optional::Optional<int>&) { return optional::Optional<int>(); };
+		CHECK_FALSE(map.compute("three", remove).has_value());
+		CHECK_FALSE(map.contains("three"));
+
+		CHECK(map.erase("one"));
+		CHECK_FALSE(map.erase("one"));
+		CHECK(map.size() == 1);
+		map.clear();
+		CHECK(map.empty());
+		CHECK_FALSE(map.contains("two"));
+	}
+	SECTION("The table should grow and keep every entry")
+	{
+		ConcurrentHashMap<int, int> map{2};
+		auto initial = map.bucketCount();
+		for (int i = 0; i < 1000; ++i)
+		{
+			map.insertOrAssign(i, i * i);
+		}
+		CHECK(map.bucketCount() > initial);
+		CHECK(map.size() == 1000);
+		bool found = true;
+		for (int i = 0; i < 1000; ++i)
+		{
+			found = found && map.find(i).value_or(-1) == i * i;
+		}
+		CHECK(found);
+		long sum = 0;
+		map.forEach([&sum](int key, int) { sum += key; });
+		CHECK(sum == 999 * 1000 / 2);
+	}
+	SECTION("Readers should see consistent values while pool tasks write")
+	{
+		ConcurrentHashMap<int, std::pair<int, int>> map{8};
+		ThreadPool<void> pool{4};
+		std::atomic<int> torn{0};
+		std::vector<std::future<void>> results;
+		for (int t = 0; t < 4; ++t)
+		{
+			results.emplace_back(pool.addTask([&map, &torn, t]
+			{
+				for (int i = 0; i < 5000; ++i)
+				{
+					auto key = i % 257;
+					if (t % 2 == 0)
+					{
+						map.insertOrAssign(key, std::make_pair(i, -i));
+						map.compute(key + 1000, [](const optional::Optional<std::pair<int, int>>& current)
+						{
+							auto count = current.has_value() ? current.value().first + 1 : 1;
+							return optional::Optional<std::pair<int, int>>(std::make_pair(count, -count));
+						});
+					}
+					else
+					{
+						auto value = map.find(key);
+						if (value.has_value() && value.value().first != -value.value().second)
+						{
+							torn.fetch_add(1, std::memory_order_relaxed);
+						}
+						if (i % 7 == 0)
+						{
+							map.erase(key);
+						}
+					}
+				}
+			}));
+		}
+		for (auto& result : results)
+		{
+			result.get();
+		}
+		CHECK(torn == 0);
+		long computed = 0;
+		for (int key = 1000; key < 1257; ++key)
+		{
+			computed += map.find(key).value_or(std::make_pair(0, 0)).first;
+		}
+		CHECK(computed == 2 * 5000);
+	}
+}
+
+TEST_CASE("SpscQueue tests should pass", "[spsc_queue]")
+{
+	SECTION("The ring should report full and empty and wrap around")
+	{
+		SpscQueue<std::unique_ptr<int>> queue{3};
+		CHECK(queue.capacity() == 4);
+		std::unique_ptr<int> item;
+		CHECK_FALSE(queue.tryPop(item));
+		for (int lap = 0; lap < 3; ++lap)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				CHECK(queue.tryPush(std::unique_ptr<int>(new int(i))));
+			}
+			auto rejected = std::unique_ptr<int>(new int(4));
+			CHECK_FALSE(queue.tryPush(std::move(rejected)));
+			CHECK(rejected);
+			CHECK(queue.size() == 4);
+			for (int i = 0; i < 4; ++i)
+			{
+				REQUIRE(queue.tryPop(item));
+				CHECK(*item == i);
+			}
+			CHECK(queue.empty());
+		}
+		CHECK(queue.tryPush(std::unique_ptr<int>(new int(5)))); // Destroyed with the queue.
+	}
+	SECTION("Items should arrive in order across threads")
+	{
+		SpscQueue<int> queue{64};
+		const int count = 200000;
+		std::thread producer([&queue, count]
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				while (!queue.tryPush(i)) std::this_thread::yield();
+			}
+		});
+		bool ordered = true;
+		int item = 0;
+		for (int expected = 0; expected < count; ++expected)
+		{
+			while (!queue.tryPop(item)) std::this_thread::yield();
+			ordered = ordered && (item == expected);
+		}
+		producer.join();
+		CHECK(ordered);
+	}
+	SECTION("A single producer ActiveWorker should run every task in order")
+	{
+		ActiveWorker<int, int> worker{SingleProducer{8}};
+		std::vector<std::future<int>> results;
+		for (int i = 0; i < 1000; ++i)
+		{
+			results.emplace_back(worker.addWork([](int x){ return x * 2; }, i));
+		}
+		for (int i = 0; i < 1000; ++i)
+		{
+			CHECK(results[i].get() == i * 2);
+		}
+		std::vector<int> order;
+		{
+			ActiveWorker<void> drained{SingleProducer{4}};
+			for (int i = 0; i < 100; ++i)
+			{
+				drained.addWork([&order, i]{ order.push_back(i); });
+			}
+		}
+		REQUIRE(order.size() == 100);
+		CHECK(std::is_sorted(order.begin(), order.end()));
+	}
+}
+
+TEST_CASE("Futex synchronization primitives should pass", "[synchronization]")
+{
+	SECTION("A latch should release its waiters once counted down to zero")
+	{
+		Latch latch{4};
+		CHECK_FALSE(latch.tryWait());
+		std::atomic<int> arrived{0};
+		std::atomic<int> released_early{0};
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&]
+			{
+				arrived.fetch_add(1);
+				latch.arriveAndWait();
+				if (arrived.load() != 4) released_early.fetch_add(1);
+			});
+		}
+		latch.wait();
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(latch.tryWait());
+		CHECK(released_early.load() == 0);
+		Latch open{0};
+		open.wait();
+		CHECK(open.tryWait());
+		CHECK_THROWS_AS(Latch{-1}, std::invalid_argument);
+	}
+	SECTION("A barrier should keep its threads in the same phase and run the completion once per phase")
+	{
+		const int parties = 4;
+		const int phases = 200;
+		std::atomic<int> work{0};
+		std::atomic<int> mismatches{0};
+		int completions = 0;
+		Barrier barrier{parties, [&]
+		{
+			++completions;
+			if (work.load() != completions * parties) mismatches.fetch_add(1);
+		}};
+		std::vector<std::thread> threads;
+		for (int t = 0; t < parties; ++t)
+		{
+			threads.emplace_back([&]
+			{
+				for (int phase = 0; phase < phases; ++phase)
+				{
+					work.fetch_add(1);
+					barrier.arriveAndWait();
+					if (work.load() < (phase + 1) * parties) mismatches.fetch_add(1);
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(completions == phases);
+		CHECK(barrier.phase() == phases);
+		CHECK(mismatches.load() == 0);
+		CHECK_THROWS_AS(Barrier{0}, std::invalid_argument);
+	}
+	SECTION("Dropping out of a barrier should shrink the next phases")
+	{
+		Barrier barrier{2};
+		std::thread leaver([&barrier]{ barrier.arriveAndDrop(); });
+		barrier.arriveAndWait();
+		leaver.join();
+		barrier.arriveAndWait(); // Alone now.
+		CHECK(barrier.phase() == 2);
+		auto token = barrier.arrive();
+		barrier.wait(token);
+		CHECK(barrier.phase() == 3);
+	}
+	SECTION("A counting semaphore should bound the threads holding it")
+	{
+		CountingSemaphore semaphore{2};
+		std::atomic<int> holding{0};
+		std::atomic<int> most{0};
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 6; ++t)
+		{
+			threads.emplace_back([&]
+			{
+				for (int i = 0; i < 200; ++i)
+				{
+					semaphore.acquire();
+					auto now = holding.fetch_add(1) + 1;
+					auto seen = most.load();
+					while (now > seen && !most.compare_exchange_weak(seen, now))
+					{}
+					std::this_thread::yield();
+					holding.fetch_sub(1);
+					semaphore.release();
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(most.load() <= 2);
+		CHECK(semaphore.available() == 2);
+	}
+	SECTION("Semaphore try operations should not block for ever")
+	{
+		CountingSemaphore semaphore{1};
+		CHECK(semaphore.tryAcquire());
+		CHECK_FALSE(semaphore.tryAcquire());
+		auto start = std::chrono::steady_clock::now();
+		CHECK_FALSE(semaphore.tryAcquireFor(std::chrono::milliseconds(20)));
+		CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+		std::thread releaser([&semaphore]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			semaphore.release(3);
+		});
+		CHECK(semaphore.tryAcquireFor(std::chrono::seconds(10)));
+		releaser.join();
+		CHECK(semaphore.available() == 2);
+		CHECK_THROWS_AS(CountingSemaphore{-1}, std::invalid_argument);
+	}
+	SECTION("A released waiter should be able to destroy the latch or semaphore at once")
+	{
+		for (int i = 0; i < 200; ++i)
+		{
+			std::unique_ptr<Latch> latch{new Latch{1}};
+			std::unique_ptr<CountingSemaphore> semaphore{new CountingSemaphore{0}};
+			Latch* raw_latch = latch.get();
+			CountingSemaphore* raw_semaphore = semaphore.get();
+			std::thread signaller([raw_latch, raw_semaphore]
+			{
+				raw_latch->countDown();
+				raw_semaphore->release();
+			});
+			latch->wait();
+			latch.reset();
+			semaphore->acquire();
+			semaphore.reset();
+			signaller.join();
+		}
+		SUCCEED();
+	}
+}
+
+TEST_CASE("PoolBarrier tests should pass", "[pool_barrier]")
+{
+	SECTION("Phase loops with more participants than workers should complete")
+	{
+		ThreadPool<void> pool{2};
+		const size_t parties = 6;
+		const size_t phases = 50;
+		std::vector<int> current(parties, 0);
+		std::vector<int> next(parties, 0);
+		PoolBarrier barrier{pool, parties, [&]{ std::swap(current, next); }};
+		// Each step every cell becomes its value plus its left neighbour's.
+		barrier.run(phases, [&](size_t party, size_t)
+		{
+			next[party] = current[party] + current[(party + parties - 1) % parties] + 1;
+		});
+		std::vector<int> check(parties, 0);
+		for (size_t phase = 0; phase < phases; ++phase)
+		{
+			std::vector<int> step(parties);
+			for (size_t party = 0; party < parties; ++party)
+			{
+				step[party] = check[party] + check[(party + parties - 1) % parties] + 1;
+			}
+			check.swap(step);
+		}
+		CHECK(current == check);
+	}
+	SECTION("A failing participant should stop the loop and rethrow")
+	{
+		ThreadPool<void> pool{2};
+		PoolBarrier barrier{pool, 3};
+		std::atomic<int> calls{0};
+		CHECK_THROWS_AS(barrier.run(100, [&](size_t party, size_t phase)
+		{
+			calls.fetch_add(1);
+			if (party == 1 && phase == 3) throw std::runtime_error("failed");
+		}), std::runtime_error);
+		CHECK(calls.load() == 3 * 4);
+	}
+}
+
+#if defined(__linux__)
+TEST_CASE("Thread options tests should pass", "[thread_options]")
+{
+	auto threadNice = []
+	{
+		return getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+	};
+	SECTION("A worker should start with the nice value and prefaulted stack asked for")
+	{
+		ThreadOptions options;
+		options.nice = 5;
+		options.prefault_stack = 128 * 1024;
+		ActiveWorker<int> worker{options};
+		auto status = worker.threadStatus();
+		CHECK(status.ok());
+		CHECK(status.nice == OptionStatus::applied);
+		CHECK(status.stack_prefault == OptionStatus::applied);
+		CHECK(status.scheduling == OptionStatus::notRequested);
+		CHECK(status.message.empty());
+		CHECK(worker.addWork(threadNice).get() == 5);
+		CHECK(threadNice() != 5); // Only the worker thread was changed.
+	}
+	SECTION("Reconfiguring should happen between tasks and keep the worker running")
+	{
+		ActiveWorker<int> worker;
+		CHECK(worker.threadStatus().ok());
+		CHECK(worker.addWork(threadNice).get() != 7);
+		ThreadOptions options;
+		options.nice = 7;
+		CHECK(worker.configureThread(options).ok());
+		CHECK(worker.addWork(threadNice).get() == 7);
+	}
+	SECTION("A rejected priority should be reported, not thrown")
+	{
+		ThreadOptions options;
+		options.policy = SchedulingPolicy::fifo;
+		options.priority = 1000;
+		ActiveWorker<void> worker{options};
+		auto status = worker.threadStatus();
+		CHECK_FALSE(status.ok());
+		CHECK((status.scheduling == OptionStatus::failed || status.scheduling == OptionStatus::denied));
+		CHECK(status.message.find("SCHED_FIFO") == 0);
+		worker.addWork([]{}).get(); // Still running tasks.
+	}
+	SECTION("A real-time class should be applied or denied according to the privileges")
+	{
+		ThreadOptions options;
+		options.policy = SchedulingPolicy::roundRobin;
+		options.priority = 1;
+		ActiveWorker<int> worker{options};
+		auto status = worker.threadStatus();
+		auto policy = worker.addWork([]
+		{
+			int policy = 0;
+			sched_param param;
+			pthread_getschedparam(pthread_self(), &policy, &param);
+			return policy;
+		}).get();
+		if (status.scheduling == OptionStatus::applied)
+		{
+			CHECK(policy == SCHED_RR);
+			CHECK(status.message.empty());
+		}
+		else
+		{
+			CHECK(status.scheduling == OptionStatus::denied);
+			CHECK(policy == SCHED_OTHER);
+			CHECK_FALSE(status.message.empty());
+		}
+	}
+	SECTION("Locking memory should be applied or denied, never thrown")
+	{
+		pid_t child = ::fork(); // mlockall affects the whole process: not this one.
+		REQUIRE(child >= 0);
+		if (child == 0)
+		{
+			ThreadOptions options;
+			options.lock_memory = true;
+			ActiveWorker<void> worker{options};
+			auto status = worker.threadStatus().memory_lock;
+			::_exit(status == OptionStatus::applied || status == OptionStatus::denied ? 0 : 1);
+		}
+		int status = 0;
+		::waitpid(child, &status, 0);
+		CHECK(WIFEXITED(status));
+		CHECK(WEXITSTATUS(status) == 0);
+	}
+	SECTION("A pool should configure every worker and report each one")
+	{
+		ThreadOptions options;
+		options.nice = 3;
+		ThreadPool<int> pool{3, options};
+		auto statuses = pool.threadStatus();
+		REQUIRE(statuses.size() == 3);
+		for (const auto& status : statuses)
+		{
+			CHECK(status.ok());
+		}
+		std::vector<std::future<int>> nices;
+		for (int i = 0; i < 6; ++i)
+		{
+			nices.push_back(pool.addTask(threadNice));
+		}
+		for (auto& nice : nices)
+		{
+			CHECK(nice.get() == 3);
+		}
+		options.nice = 4;
+		CHECK(pool.configureThreads(options).size() == 3);
+		CHECK(pool.addTask(threadNice).get() == 4);
+	}
+	SECTION("Workers should carry the names asked for, pool workers with their index")
+	{
+		auto threadName = []
+		{
+			char name[32] = {};
+			pthread_getname_np(pthread_self(), name, sizeof(name));
+			return std::string(name);
+		};
+		ThreadOptions options;
+		options.name = "logger";
+		ActiveWorker<std::string> worker{options};
+		CHECK(worker.threadStatus().naming == OptionStatus::applied);
+		CHECK(worker.addWork(threadName).get() == "logger");
+
+		options.name = "averyverylongpoolname";
+		ThreadPool<std::string> pool{2, options};
+		std::vector<std::string> names;
+		for (int i = 0; i < 2; ++i)
+		{
+			names.push_back(pool.addTask(threadName).get());
+		}
+		std::sort(names.begin(), names.end());
+		CHECK(names == (std::vector<std::string>{"averyverylong/0", "averyverylong/1"}));
+	}
+	SECTION("Worker CPU time should count running tasks, not waiting ones")
+	{
+		auto spin = [](std::chrono::milliseconds amount)
+		{
+			auto start = details::threadCpuTime(pthread_self());
+			while (details::threadCpuTime(pthread_self()) - start < amount)
+			{}
+		};
+		ThreadPool<void> pool{2};
+		auto idle = pool.cpuTime();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		CHECK(pool.cpuTime() - idle < std::chrono::milliseconds(25));
+		std::vector<std::future<void>> busy;
+		for (int i = 0; i < 2; ++i)
+		{
+			busy.push_back(pool.addTask([spin]{ spin(std::chrono::milliseconds(40)); }));
+		}
+		for (auto& task : busy)
+		{
+			task.get();
+		}
+		CHECK(pool.cpuTime() - idle >= std::chrono::milliseconds(80));
+
+		ActiveWorker<void> worker;
+		auto before = worker.cpuTime();
+		worker.addWork([]{ std::this_thread::sleep_for(std::chrono::milliseconds(50)); }).get();
+		CHECK(worker.cpuTime() - before < std::chrono::milliseconds(25));
+	}
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("Reactor tests should pass", "[reactor]")
+{
+	auto nonBlockingPipe = [](int fds[2])
+	{
+		REQUIRE(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+	};
+	ThreadPool<void> pool{2};
+	SECTION("A future should complete once its fd is readable, and not before")
+	{
+		int fds[2];
+		nonBlockingPipe(fds);
+		{
+			Reactor reactor{pool};
+			auto ready = reactor.whenReady(fds[0], Reactor::readable);
+			CHECK(ready.wait_for(std::chrono::milliseconds(20)) == std::future_status::timeout);
+			char byte = 'x';
+			REQUIRE(::write(fds[1], &byte, 1) == 1);
+			CHECK((ready.get() & Reactor::readable) != 0);
+			CHECK(reactor.size() == 0);
+		}
+		::close(fds[0]);
+		::close(fds[1]);
+	}
+	SECTION("Continuations should run on the pool and return their result")
+	{
+		int sockets[2];
+		REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sockets) == 0);
+		{
+			Reactor reactor{pool};
+			auto received = reactor.whenReady(sockets[1], Reactor::readable, [&](uint32_t)
+			{
+				char buffer[16] = {};
+				auto n = ::read(sockets[1], buffer, sizeof(buffer));
+				bool on_pool = pool.currentWorker().has_value();
+				return std::make_pair(std::string(buffer, n > 0 ? static_cast<size_t>(n) : 0), on_pool);
+			});
+			auto sent = reactor.whenReady(sockets[0], Reactor::writable, [&](uint32_t)
+			{
+				return ::write(sockets[0], "hello", 5);
+			});
+			CHECK(sent.get() == 5);
+			auto result = received.get();
+			CHECK(result.first == "hello");
+			CHECK(result.second);
+		}
+		::close(sockets[0]);
+		::close(sockets[1]);
+	}
+	SECTION("A watch should run once per readiness, one call at a time, until unwatched")
+	{
+		EventFd events;
+		Reactor reactor{pool};
+		std::atomic<int> running{0};
+		std::atomic<bool> overlapped{false};
+		std::atomic<uint64_t> consumed{0};
+		auto id = reactor.watch(events.fd(), Reactor::readable, [&](uint32_t)
+		{
+			if (running.fetch_add(1) != 0) overlapped = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			consumed.fetch_add(events.consume());
+			running.fetch_sub(1);
+		});
+		for (int i = 0; i < 50; ++i)
+		{
+			events.signal();
+			if (i % 10 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (consumed.load() < 50 && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		CHECK(consumed.load() == 50);
+		CHECK_FALSE(overlapped.load());
+		CHECK(reactor.unwatch(id));
+		CHECK_FALSE(reactor.unwatch(id));
+		CHECK(reactor.size() == 0);
+	}
+	SECTION("A peer closing its end should complete the readers")
+	{
+		int fds[2];
+		nonBlockingPipe(fds);
+		Reactor reactor{pool};
+		auto ready = reactor.whenReady(fds[0], Reactor::readable);
+		::close(fds[1]);
+		CHECK((ready.get() & (Reactor::readable | Reactor::hangup)) != 0);
+		CHECK(reactor.unwatchAll(fds[0]) == 0);
+		::close(fds[0]);
+	}
+	SECTION("Removed and pending watches should fail their futures")
+	{
+		int fds[2];
+		nonBlockingPipe(fds);
+		std::future<uint32_t> pending;
+		std::future<int> continuation;
+		{
+			Reactor reactor{pool};
+			auto removed = reactor.whenReady(fds[0], Reactor::readable);
+			auto also_removed = reactor.whenReady(fds[0], Reactor::readable, [](uint32_t){ return 1; });
+			CHECK(reactor.unwatchAll(fds[0]) == 2);
+			CHECK_THROWS_AS(removed.get(), std::system_error);
+			CHECK_THROWS_AS(also_removed.get(), std::system_error);
+			pending = reactor.whenReady(fds[0], Reactor::readable);
+			continuation = reactor.whenReady(fds[0], Reactor::readable, [](uint32_t){ return 1; });
+		}
+		CHECK_THROWS_AS(pending.get(), std::system_error);
+		CHECK_THROWS_AS(continuation.get(), std::system_error);
+		::close(fds[0]);
+		::close(fds[1]);
+	}
+	SECTION("Unsupported fds should be rejected when watched")
+	{
+		Reactor reactor{pool};
+		CHECK_THROWS_AS(reactor.whenReady(-1, Reactor::readable), std::system_error);
+		CHECK(reactor.size() == 0);
+	}
+}
+#endif
@@ -3,13 +3,603 @@
 #define THREADING_ACTIVEWORKER_HEADER
 
 #include <deque>
+#include <functional>
 #include <future>
+#include <memory>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 #include <type_traits>
 #include <common/Utility.h>
+#include <thread/BlockingRegion.h>
+#include <thread/EventCount.h>
+#include <thread/SpscQueue.h>
+#include <thread/Synchronization.h>
+#include <thread/TaskAllocator.h>
+#include <thread/ThreadOptions.h>
+#include <thread/Trace.h>
 
 namespace rboc { namespace utils { namespace threading
 {
+	//! Point in time after which a queued task is no longer worth running.
+	using Deadline = std::chrono::steady_clock::time_point;
+
+	//! Selects the single producer mode of an ActiveWorker.
+	/**
+	 * For workers fed by exactly one thread: tasks go through a wait-free
+	 * SpscQueue of the given capacity instead of the locked deque. The
+	 * producer waits while the queue is full. addWork must never be called
+	 * concurrently and compensation (see BlockingRegion) is not available.
+	 */
+	struct SingleProducer
+	{
+		explicit SingleProducer(size_t queue_capacity = 1024)
+			: capacity(queue_capacity)
+		{}
+
+		size_t capacity;
+	};
+
+	//! class TaskExpiredException. 
+	/** 
+	 * Exception stored in the future of a task that was dropped because its
+	 * deadline expired while it was waiting in the queue.
+	 */
+	class TaskExpiredException : public std::exception
+	{
+		public:
+		TaskExpiredException() 
+		{}
+
+		virtual const char* what() const noexcept override
+		{
+			return "task deadline expired before execution";
+		}
+
+		virtual ~TaskExpiredException() noexcept = default;
+	};
+
+	namespace details
+	{
+		//! ExpiringTask
+		/**
+		 * Wraps a function so that it is dropped, instead of executed, when it is
+		 * dequeued after its deadline. The future is then completed with a
+		 * TaskExpiredException and the worker shed counter is incremented.
+		 */
+		template<typename F>
+		struct ExpiringTask
+		{
+			template<typename... A>
+			auto operator()(A&&... args) -> decltype(std::declval<F&>()(std::forward<A>(args)...))
+			{
+				if (std::chrono::steady_clock::now() > _deadline)
+				{
+					_shed->fetch_add(1, std::memory_order_relaxed);
+					throw TaskExpiredException();
+				}
+				return _f(std::forward<A>(args)...);
+			}
+
+			F _f;
+			Deadline _deadline;
+			std::atomic<uint64_t>* _shed;
+		};
+
+		template<typename F>
+		ExpiringTask<typename std::decay<F>::type> makeExpiringTask(F&& f, Deadline deadline, std::atomic<uint64_t>* shed)
+		{
+			return ExpiringTask<typename std::decay<F>::type>{std::forward<F>(f), deadline, shed};
+		}
+	}
+
+	namespace details
+	{
+		//! Identifies the executor a worker thread belongs to and its position in it.
+		struct WorkerIdentity
+		{
+			std::atomic<const void*> owner{nullptr};
+			std::atomic<size_t> index{0};
+		};
+
+		//! The identity of the worker running on the calling thread, null elsewhere.
+		inline const WorkerIdentity*& currentWorkerIdentity() noexcept
+		{
+			static thread_local const WorkerIdentity* identity = nullptr;
+			return identity;
+		}
+
+		//! TaskBoundaryHook
+		/**
+		 * Work a thread wants done between two tasks of the worker running on it,
+		 * i.e. advancing a memory reclamation epoch while no task holds references.
+		 * Hooks are registered per thread and must not throw.
+		 */
+		struct TaskBoundaryHook
+		{
+			//! Called by the worker thread after each task.
+			virtual void onTaskBoundary() noexcept = 0;
+
+			TaskBoundaryHook* next_hook = nullptr;
+
+			protected:
+
+			~TaskBoundaryHook() = default;
+		};
+
+		//! The hooks registered on the calling thread.
+		inline TaskBoundaryHook*& taskBoundaryHooks() noexcept
+		{
+			static thread_local TaskBoundaryHook* hooks = nullptr;
+			return hooks;
+		}
+
+		//! Registers hook on the calling thread.
+		inline void addTaskBoundaryHook(TaskBoundaryHook* hook) noexcept
+		{
+			hook->next_hook = taskBoundaryHooks();
+			taskBoundaryHooks() = hook;
+		}
+
+		//! Unregisters hook from the calling thread, if it is registered.
+		inline void removeTaskBoundaryHook(TaskBoundaryHook* hook) noexcept
+		{
+			for (auto link = &taskBoundaryHooks(); *link != nullptr; link = &(*link)->next_hook)
+			{
+				if (*link == hook)
+				{
+					*link = hook->next_hook;
+					return;
+				}
+			}
+		}
+
+		//! Runs the hooks of the calling thread. A hook may unregister itself.
+		inline void runTaskBoundaryHooks() noexcept
+		{
+			auto hook = taskBoundaryHooks();
+			while (hook != nullptr)
+			{
+				auto next = hook->next_hook;
+				hook->onTaskBoundary();
+				hook = next;
+			}
+		}
+
+		//! Runs a queued (task, arguments tuple) pair.
+		struct TupleTaskRunner
+		{
+			template<typename Task>
+			static void run(Task& task)
+			{
+				utilities::call_task(std::move(task.first), std::move(task.second));
+			}
+		};
+
+		//! Runs a queued task that takes no arguments.
+		struct PlainTaskRunner
+		{
+			template<typename Task>
+			static void run(Task& task)
+			{
+				task();
+			}
+		};
+
+		//! class WorkerBase
+		/**
+		 * The queue, the thread and the parking logic shared by every ActiveWorker.
+		 * \tparam Task the type stored in the queue.
+		 * \tparam Runner a type with a static run(Task&) that executes a task.
+		 * \tparam Drain true if queued tasks are still executed when the worker stops.
+		 *
+		 * When compensation is enabled (ThreadPool does it) a task that enters a
+		 * BlockingRegion makes the worker start, or wake, a compensating thread that
+		 * keeps running the queue until the region ends.
+		 */
+		template<typename Task, typename Runner, bool Drain>
+		class WorkerBase : private BlockingHandler
+		{
+			public:
+
+			//! Copy constructor
+			WorkerBase(const WorkerBase& other) = delete;
+			//! Copy assignment
+			WorkerBase& operator=(const WorkerBase& other) = delete;
+
+			//! shedCount
+			/**
+			 * \return the number of tasks dropped because their deadline expired.
+			 */
+			uint64_t shedCount() const
+			{
+				return _shed.load(std::memory_order_relaxed);
+			}
+
+			//! setCompensation
+			/**
+			 * Enables or disables compensating threads for tasks in a BlockingRegion.
+			 * Tasks of a compensated worker may run concurrently while one is blocked,
+			 * so it is meant for pools, not for workers that rely on FIFO execution.
+			 * It is ignored in single producer mode.
+			 * \param enabled true to compensate.
+			 */
+			void setCompensation(bool enabled)
+			{
+				_compensate.store(enabled, std::memory_order_relaxed);
+			}
+
+			//! setOwner
+			/**
+			 * Records the executor that owns this worker and the worker position in it,
+			 * so tasks can find out which worker runs them (see ThreadPool::currentWorker).
+			 * \param owner the owning executor.
+			 * \param index the position of the worker in the owner.
+			 */
+			void setOwner(const void* owner, size_t index)
+			{
+				_identity.index.store(index, std::memory_order_relaxed);
+				_identity.owner.store(owner, std::memory_order_release);
+			}
+
+			//! blocked
+			/**
+			 * \return true while some task of this worker is inside a compensated BlockingRegion.
+			 */
+			bool blocked() const
+			{
+				return _blocked.load(std::memory_order_relaxed) > 0;
+			}
+
+			//! configureThread
+			/**
+			 * Applies options to the worker thread, between two tasks, and waits
+			 * for the result: queued tasks may run before or after the change.
+			 * Compensating threads started afterwards get the same options,
+			 * name included. Must not be called from a task of this worker.
+			 * \param options the scheduling class, priority, nice value, memory locking and stack prefault.
+			 * \return what became of each option. Missing privileges are reported, not thrown.
+			 */
+			ThreadStatus configureThread(const ThreadOptions& options)
+			{
+				ThreadStatus status;
+				runOnWorker([&status, &options]{ status = applyThreadOptions(options); });
+				std::lock_guard<std::mutex> lock(_comp_mtx);
+				_options = options;
+				_thread_status = status;
+				return status;
+			}
+
+			//! threadStatus
+			/**
+			 * \return the outcome of the last configureThread.
+			 */
+			ThreadStatus threadStatus() const
+			{
+				std::lock_guard<std::mutex> lock(_comp_mtx);
+				return _thread_status;
+			}
+
+			//! cpuTime
+			/**
+			 * CPU time consumed by the worker thread and its compensating
+			 * threads, read from their CPU clocks. Compare it with the wall time
+			 * elapsed between two calls to get the utilisation of the worker.
+			 * \return the CPU time consumed so far, zero where unsupported.
+			 */
+			std::chrono::nanoseconds cpuTime() const
+			{
+				auto result = details::threadCpuTime(const_cast<std::thread&>(_worker).native_handle());
+				std::lock_guard<std::mutex> lock(_comp_mtx);
+				for (const auto& compensator : _compensators)
+				{
+					result += details::threadCpuTime(const_cast<std::thread&>(compensator).native_handle());
+				}
+				return result;
+			}
+
+			protected:
+
+			//! Default constructor
+			WorkerBase()
+				: _running(true)
+				, _queue{}
+				, _worker()
+			{}
+
+			//! Single producer constructor
+			explicit WorkerBase(const SingleProducer& mode)
+				: _running(true)
+				, _queue{}
+				, _spsc(new SpscQueue<Task>(mode.capacity))
+				, _worker()
+			{}
+
+			//! Destructor
+			~WorkerBase()
+			{
+				_running = false;
+				{
+					std::lock_guard<std::mutex> lock(_comp_mtx);
+					_comp_shutdown = true;
+				}
+				_comp_cond.notify_all();
+				_event.notifyAll();
+				_worker.join();
+				for (auto& compensator : _compensators)
+				{
+					compensator.join();
+				}
+			}
+
+			//! Starts the worker thread. Called by the derived constructor.
+			void start()
+			{
+				_worker = std::thread(&WorkerBase::work, this);
+			}
+
+			//! Queues a task and wakes the worker if it is parked.
+			void push(Task&& task)
+			{
+				if (_spsc)
+				{
+					pushSingle(std::move(task));
+					return;
+				}
+				uint64_t trace_id;
+				{
+					std::lock_guard<std::mutex> queue_lock(_mtx);				
+					_queue.emplace_back(std::move(task));
+					trace_id = _trace.pushed();
+				}
+				trace::record(trace::EventType::submit, trace_id);
+				_event.notify(); // No syscall unless the worker announced it is going to sleep.
+			}
+
+			std::atomic<uint64_t> _shed{0}; // Tasks dropped because of their deadline.
+
+			private:
+
+			// private functions.
+
+			// Runs f on the worker thread, the next time it looks for a task, and waits for it.
+			void runOnWorker(std::function<void()> f)
+			{
+				std::lock_guard<std::mutex> lock(_control_mtx);
+				Latch done{1};
+				_control = [&f, &done]{ f(); done.countDown(); };
+				_control_pending.store(true, std::memory_order_seq_cst);
+				_event.notifyAll(); // The worker may be parked; compensators just look again.
+				done.wait();
+			}
+
+			// Called by the worker thread between tasks.
+			void runControl()
+			{
+				if (_control_pending.exchange(false, std::memory_order_acq_rel))
+				{
+					auto control = std::move(_control);
+					control();
+				}
+			}
+
+			// Single producer mode: waits for room in the ring, then wakes the worker.
+			void pushSingle(Task&& task)
+			{
+				while (!_spsc->tryPush(std::move(task))) // task is only moved from on success.
+				{
+					auto key = _space.prepareWait();
+					if (_spsc->tryPush(std::move(task)))
+					{
+						_space.cancelWait();
+						break;
+					}
+					_space.wait(key);
+				}
+				trace::record(trace::EventType::submit, _trace.pushed());
+				_event.notify();
+			}
+
+			void work()
+			{			
+				BlockingHandlerScope scope(this);
+				currentWorkerIdentity() = &_identity; // Compensating threads keep no identity.
+
+				Task task;
+				uint64_t trace_id = 0;
+				while (nextTask(task, trace_id))
+				{
+					runTask(task, trace_id);
+				}
+			}
+
+			void runTask(Task& task, uint64_t trace_id)
+			{
+				trace::record(trace::EventType::start, trace_id);
+				Runner::run(task);
+				trace::record(trace::EventType::end, trace_id);
+				runTaskBoundaryHooks();
+			}
+
+			// Pops the next task, parking on the eventcount while the queue is empty.
+			bool nextTask(Task& task, uint64_t& trace_id)
+			{
+				while (true)
+				{
+					runControl();
+					if (!Drain && !_running) return false;
+					if (tryPop(task, trace_id)) return true;
+					if (!_running) return false;
+
+					flushTaskAllocatorCache(); // Give foreign blocks back before going idle.
+					auto key = _event.prepareWait();
+					if (!_running)
+					{
+						_event.cancelWait();
+						return Drain && tryPop(task, trace_id);
+					}
+					if (tryPop(task, trace_id))
+					{
+						_event.cancelWait();
+						return true;
+					}
+					if (_control_pending.load(std::memory_order_seq_cst))
+					{
+						_event.cancelWait();
+						continue;
+					}
+					_event.wait(key);
+				}
+			}
+
+			bool tryPop(Task& task, uint64_t& trace_id)
+			{
+				if (_spsc)
+				{
+					if (!_spsc->tryPop(task)) return false;
+					trace_id = _trace.popped();
+					_space.notify(); // No syscall unless the producer waits for room.
+					return true;
+				}
+				std::lock_guard<std::mutex> queue_lock(_mtx);
+				if (_queue.empty()) return false;
+				task = std::move(_queue.front());
+				_queue.pop_front();
+				trace_id = _trace.popped();
+				return true;
+			}
+
+			// Compensation: runs on the thread of the task that is about to block.
+			bool enterBlocking() noexcept override
+			{
+				if (!_compensate.load(std::memory_order_relaxed) || _spsc) return false;
+				std::lock_guard<std::mutex> lock(_comp_mtx);
+				if (_comp_shutdown) return false;
+				_blocked.store(++_comp_wanted, std::memory_order_relaxed);
+				if (_compensators.size() < static_cast<size_t>(_comp_wanted))
+				{
+					try
+					{
+						_compensators.emplace_back(&WorkerBase::compensate, this);
+					}
+					catch (...) // No thread to spare (EAGAIN) or no memory: block uncompensated.
+					{
+						_blocked.store(--_comp_wanted, std::memory_order_relaxed);
+						return false;
+					}
+				}
+				else
+				{
+					_comp_cond.notify_all();
+				}
+				return true;
+			}
+
+			void leaveBlocking() override
+			{
+				{
+					std::lock_guard<std::mutex> lock(_comp_mtx);
+					_blocked.store(--_comp_wanted, std::memory_order_relaxed);
+				}
+				_event.notifyAll(); // Wake parked compensators so the extra one retires.
+			}
+
+			// Body of a compensating thread: it idles until a task blocks and then
+			// runs the queue until there are more compensators than blocked tasks.
+			void compensate()
+			{
+				BlockingHandlerScope scope(this);
+				Task task;
+				uint64_t trace_id = 0;
+				std::unique_lock<std::mutex> lock(_comp_mtx);
+				if (_options.requested())
+				{
+					auto options = _options;
+					lock.unlock();
+					applyThreadOptions(options);
+					lock.lock();
+				}
+				while (true)
+				{
+					_comp_cond.wait(lock, [this]{ return _comp_active < _comp_wanted || _comp_shutdown; });
+					if (_comp_shutdown) break;
+					++_comp_active;
+					lock.unlock();
+					while (nextCompensatedTask(task, trace_id))
+					{
+						runTask(task, trace_id);
+					}
+					lock.lock();
+				}
+			}
+
+			bool nextCompensatedTask(Task& task, uint64_t& trace_id)
+			{
+				while (true)
+				{
+					if (retire()) return false;
+					if (tryPop(task, trace_id)) return true;
+
+					auto key = _event.prepareWait();
+					if (tryPop(task, trace_id))
+					{
+						_event.cancelWait();
+						return true;
+					}
+					if (retire())
+					{
+						_event.cancelWait();
+						return false;
+					}
+					_event.wait(key);
+				}
+			}
+
+			// True, and the compensator is no longer active, if it is not needed anymore.
+			bool retire()
+			{
+				std::lock_guard<std::mutex> lock(_comp_mtx);
+				if (_comp_active > _comp_wanted || _comp_shutdown)
+				{
+					--_comp_active;
+					return true;
+				}
+				return false;
+			}
+
+			// Private members.
+			std::atomic_bool _running;
+			std::deque<Task> _queue;
+			std::unique_ptr<SpscQueue<Task>> _spsc; // Replaces _queue in single producer mode.
+			std::thread _worker;
+			mutable std::mutex _mtx; // Mutex to protect the queue.
+			EventCount _event;       // Parks the worker while the queue is empty.
+			EventCount _space;       // Parks the single producer while _spsc is full.
+			trace::WorkerTrace _trace; // Task ids for tracing, protected by _mtx (pushed/popped by their only thread in single producer mode). Empty unless tracing is compiled in.
+			WorkerIdentity _identity;
+
+			std::mutex _control_mtx;              // Serializes runOnWorker calls.
+			std::function<void()> _control;       // Set by runOnWorker, run by the worker thread.
+			std::atomic<bool> _control_pending{false};
+
+			std::atomic_bool _compensate{false};
+			std::atomic<int> _blocked{0};         // Copy of _comp_wanted for lock-free reads.
+			mutable std::mutex _comp_mtx;         // Mutex to protect the compensation state below.
+			std::condition_variable _comp_cond;   // Idle compensators wait here.
+			int _comp_wanted = 0;                 // Tasks currently inside a compensated region.
+			int _comp_active = 0;                 // Compensators currently running the queue.
+			bool _comp_shutdown = false;
+			ThreadOptions _options;               // Applied to compensating threads when they start.
+			ThreadStatus _thread_status;
+			std::vector<std::thread> _compensators;
+		};
+	}
+
 	//! class ActiveWorker
 	/**
 	 * This is a worker class that has a detached thread that extract 
@@ -17,33 +607,58 @@ namespace rboc { namespace utils { namespace threading
 	 */
 	template<typename R, typename... Args>
 	class ActiveWorker
+		: public details::WorkerBase<std::pair<std::packaged_task<R(Args...)>, std::tuple<Args...>>, details::TupleTaskRunner, false>
 	{
 		public:
 
 		//! Default constructor
 		ActiveWorker()
-			: _running(true)
-			, _queue{}
-			, _worker()
 		{
-			_worker = std::thread(&ActiveWorker::work, this);
+			this->start();
 		}
 
-		//! Copy constructor
-		ActiveWorker(const ActiveWorker& other) = default;
-		//! Move constructor
-		ActiveWorker(ActiveWorker&& other) = default;
-		//! Destructor
-		~ActiveWorker()
+		//! Single producer constructor
+		/**
+		 * \param mode the capacity of the wait-free queue. See SingleProducer.
+		 */
+		explicit ActiveWorker(const SingleProducer& mode)
+			: details::WorkerBase<std::pair<std::packaged_task<R(Args...)>, std::tuple<Args...>>, details::TupleTaskRunner, false>(mode)
+		{
+			this->start();
+		}
+
+		//! Thread options constructor
+		/**
+		 * Starts the worker and applies options to its thread before any task
+		 * runs. See configureThread; the outcome is kept in threadStatus().
+		 * \param options the scheduling class, priority, nice value, memory locking and stack prefault.
+		 */
+		explicit ActiveWorker(const ThreadOptions& options)
 		{
-			_running = false;
-			_empty_queue_cond.notify_one();
-			_worker.join();
+			this->start();
+			this->configureThread(options);
 		}
+
+		//! Single producer and thread options constructor
+		/**
+		 * \param mode the capacity of the wait-free queue. See SingleProducer.
+		 * \param options applied to the worker thread. See configureThread.
+		 */
+		ActiveWorker(const SingleProducer& mode, const ThreadOptions& options)
+			: details::WorkerBase<std::pair<std::packaged_task<R(Args...)>, std::tuple<Args...>>, details::TupleTaskRunner, false>(mode)
+		{
+			this->start();
+			this->configureThread(options);
+		}
+
+		//! Copy constructor
+		ActiveWorker(const ActiveWorker& other) = delete;
+		//! Move constructor
+		ActiveWorker(ActiveWorker&& other) = delete;
 		//! Copy assignment
-		ActiveWorker& operator=(const ActiveWorker& other) = default;
+		ActiveWorker& operator=(const ActiveWorker& other) = delete;
 		//! Move assignment
-		ActiveWorker& operator=(ActiveWorker&& other) = default;
+		ActiveWorker& operator=(ActiveWorker&& other) = delete;
 		
 		/**
 		 * Adds work to the worker.
@@ -55,77 +670,118 @@ namespace rboc { namespace utils { namespace threading
 		{			
 			static_assert(sizeof...(args) == std::tuple_size<std::tuple<Args...>>::value,
 				"number of params in object declaration and adding work must match");
-			std::packaged_task<R(Args...)> task{std::forward<F>(f)};
-			auto result = task.get_future();
-			{
-				std::lock_guard<std::mutex> queue_lock(_mtx);				
-				_queue.emplace_back(std::make_pair(std::move(task), std::make_tuple(args...)));
-			}
-			_empty_queue_cond.notify_one();
-			return result;
+			return enqueue(std::packaged_task<R(Args...)>{std::forward<F>(f)}, args...);
 		}
 
-		private:
-		
-		// private functions.
-		void work()
-		{			
-			while (true)
-			{
-				std::unique_lock<std::mutex> cond_lock(_mtx);
-				_empty_queue_cond.wait(cond_lock, [this]{ return !_queue.empty() || !_running; });
-				
-				if (!_running) break;
+		/**
+		 * Adds work to the worker allocating the task and its shared state with alloc.
+		 * \param alloc the allocator to be used, i.e. TaskAllocator.
+		 * \param f the function to be executed by the worker
+		 * \param Args... the arguments to be passed to the function f.
+		 */
+		template<typename Alloc, typename F>
+		std::future<R> addWork(std::allocator_arg_t, const Alloc& alloc, F&& f, Args... args)
+		{
+			return enqueue(std::packaged_task<R(Args...)>{std::allocator_arg, alloc, std::forward<F>(f)}, args...);
+		}
 
-				auto task = std::move(_queue.front());
-				_queue.pop_front();
-				cond_lock.unlock();
-				utilities::call_task(std::move(task.first), std::move(task.second));
-			}
+		/**
+		 * Adds work that is dropped if it has not started by the deadline. The future
+		 * of a dropped task throws TaskExpiredException.
+		 * \param deadline the point in time after which the task is not executed.
+		 * \param f the function to be executed by the worker
+		 * \param Args... the arguments to be passed to the function f.
+		 */
+		template<typename F>
+		std::future<R> addWork(Deadline deadline, F&& f, Args... args)
+		{
+			return enqueue(std::packaged_task<R(Args...)>{details::makeExpiringTask(std::forward<F>(f), deadline, &this->_shed)}, args...);
+		}
+
+		//! post
+		/**
+		 * Enqueues an already built task. The caller is expected to have retrieved
+		 * its future, which is useful to forward tasks between executors.
+		 * \param task the task to be executed by the worker.
+		 * \param Args... the arguments to be passed to the task.
+		 */
+		void post(std::packaged_task<R(Args...)>&& task, Args... args)
+		{
+			this->push(std::make_pair(std::move(task), std::make_tuple(args...)));
 		}
 
-		// Private members.
-		std::atomic_bool _running;
-		std::deque<std::pair<std::packaged_task<R(Args...)>, std::tuple<Args...>>> _queue;
-		std::thread _worker;
-		mutable std::mutex _mtx; // Mutex to protect the queue and running bool.
-		std::condition_variable _empty_queue_cond;
+		private:
+
+		// private functions.
+		std::future<R> enqueue(std::packaged_task<R(Args...)>&& task, Args... args)
+		{
+			auto result = task.get_future();
+			post(std::move(task), args...);
+			return result;
+		}
 	};
 
 	//! Specialization for 0 argument functions.
+	/**
+	 * Pending tasks are drained before the worker stops.
+	 */
 	template<typename R>
 	class ActiveWorker<R>
+		: public details::WorkerBase<std::packaged_task<R()>, details::PlainTaskRunner, true>
 	{
 		public:
 
 		//! Default constructor
 		ActiveWorker()
-			: _running(true)
-			, _queue{}
-			, _worker()
 		{
-			_worker = std::thread(&ActiveWorker::work, this);
+			this->start();
+		}
+
+		//! Single producer constructor
+		/**
+		 * \param mode the capacity of the wait-free queue. See SingleProducer.
+		 */
+		explicit ActiveWorker(const SingleProducer& mode)
+			: details::WorkerBase<std::packaged_task<R()>, details::PlainTaskRunner, true>(mode)
+		{
+			this->start();
+		}
+
+		//! Thread options constructor
+		/**
+		 * Starts the worker and applies options to its thread before any task
+		 * runs. See configureThread; the outcome is kept in threadStatus().
+		 * \param options the scheduling class, priority, nice value, memory locking and stack prefault.
+		 */
+		explicit ActiveWorker(const ThreadOptions& options)
+		{
+			this->start();
+			this->configureThread(options);
+		}
+
+		//! Single producer and thread options constructor
+		/**
+		 * \param mode the capacity of the wait-free queue. See SingleProducer.
+		 * \param options applied to the worker thread. See configureThread.
+		 */
+		ActiveWorker(const SingleProducer& mode, const ThreadOptions& options)
+			: details::WorkerBase<std::packaged_task<R()>, details::PlainTaskRunner, true>(mode)
+		{
+			this->start();
+			this->configureThread(options);
 		}
 
 		//! Copy constructor
 		ActiveWorker(const ActiveWorker& other) = delete;
 		
 		//! Move constructor
-		ActiveWorker(ActiveWorker&& other) = default;
-		
-		//! Destructor
-		~ActiveWorker()
-		{
-			_running = false;
-			_empty_queue_cond.notify_one();
-			_worker.join();
-		}
+		ActiveWorker(ActiveWorker&& other) = delete;
 		
 		//! Copy assignment
 		ActiveWorker& operator=(const ActiveWorker& other) = delete;
 
 		//! Move assignment
-		ActiveWorker& operator=(ActiveWorker&& other) = default;
+		ActiveWorker& operator=(ActiveWorker&& other) = delete;
 		
 		//! addWork.
 		/** 
@@ -135,43 +791,56 @@ namespace rboc { namespace utils { namespace threading
 		template<typename F>
 		std::future<R> addWork(F&& f)
 		{			
-			std::packaged_task<R()> task{std::forward<F>(f)};
-			auto result = task.get_future();
-			{
-				std::lock_guard<std::mutex> queue_lock(_mtx);				
-				_queue.emplace_back(std::move(task));
-			}
-			_empty_queue_cond.notify_one();
-			return result;
+			return enqueue(std::packaged_task<R()>{std::forward<F>(f)});
 		}
 
-		private:
-
-		// private functions.
-		void work()
-		{			
-			while (true)
-			{
-				std::unique_lock<std::mutex> cond_lock(_mtx);
-				_empty_queue_cond.wait(cond_lock, [this](){ return !_queue.empty() || !_running; });
+		//! addWork.
+		/** 
+		 * Adds work to the worker allocating the task and its shared state with alloc.
+		 * \param alloc the allocator to be used, i.e. TaskAllocator.
+		 * \param f the function to be executed by the worker		
+		 */
+		template<typename Alloc, typename F>
+		std::future<R> addWork(std::allocator_arg_t, const Alloc& alloc, F&& f)
+		{
+			return enqueue(std::packaged_task<R()>{std::allocator_arg, alloc, std::forward<F>(f)});
+		}
 
-				if (!_running && _queue.empty()) break;
+		//! addWork.
+		/** 
+		 * Adds work that is dropped if it has not started by the deadline. The future
+		 * of a dropped task throws TaskExpiredException.
+		 * \param deadline the point in time after which the task is not executed.
+		 * \param f the function to be executed by the worker		
+		 */
+		template<typename F>
+		std::future<R> addWork(Deadline deadline, F&& f)
+		{
+			return enqueue(std::packaged_task<R()>{details::makeExpiringTask(std::forward<F>(f), deadline, &this->_shed)});
+		}
 
-				auto task = std::move(_queue.front());
-				_queue.pop_front();
-				cond_lock.unlock();
-				task();
-			}
+		//! post
+		/**
+		 * Enqueues an already built task. The caller is expected to have retrieved
+		 * its future, which is useful to forward tasks between executors.
+		 * \param task the task to be executed by the worker.
+		 */
+		void post(std::packaged_task<R()>&& task)
+		{
+			this->push(std::move(task));
 		}
 
-		// Private members.
-		std::atomic_bool _running;
-		std::deque<std::packaged_task<R()>> _queue;
-		std::thread _worker;
-		mutable std::mutex _mtx; // Mutex to protect the queue and running bool.
-		std::condition_variable _empty_queue_cond;
+		private:
+
+		// private functions.
+		std::future<R> enqueue(std::packaged_task<R()>&& task)
+		{
+			auto result = task.get_future();
+			post(std::move(task));
+			return result;
+		}
 	};
 
 }}} // rboc::utils::threading
 
-#endif // THREADING_ACTIVEWORKER_HEADER
\ No newline at end of file
+#endif // THREADING_ACTIVEWORKER_HEADER
@@ -0,0 +1,441 @@
+#pragma once
+#ifndef THREADING_ALGORITHMS_HEADER
+#define THREADING_ALGORITHMS_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include <thread/ForkJoin.h>
+#include <thread/TaskGroup.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading { namespace parallel
+{
+	//! Ranges with fewer elements than this are processed sequentially by default.
+	static constexpr std::size_t kDefaultGrain = 1 << 13;
+
+	namespace details
+	{
+		//! Number of chunks a range of n elements is split in: no chunk smaller
+		//! than grain and a few chunks per worker to absorb imbalance.
+		inline size_t chunkCount(const ThreadPool<void>& pool, size_t n, size_t grain) noexcept
+		{
+			grain = std::max<size_t>(grain, 1);
+			return std::max<size_t>(1, std::min(n / grain, pool.size() * 4));
+		}
+
+		//! True if a range of n elements should not be split.
+		inline bool sequential(const ThreadPool<void>& pool, size_t n, size_t grain) noexcept
+		{
+			return n <= grain || pool.size() < 2;
+		}
+
+		//! Calls f(chunk, begin, end) for every chunk of [0, n), the first chunk on
+		//! the calling thread and the others on the pool, and waits for all of them.
+		template<typename F>
+		void forEachChunk(ThreadPool<void>& pool, size_t n, size_t chunks, F&& f)
+		{
+			auto bound = [n, chunks](size_t chunk){ return n * chunk / chunks; };
+			TaskGroup group{pool};
+			for (size_t chunk = 1; chunk < chunks; ++chunk)
+			{
+				group.run([&f, &bound, chunk]{ f(chunk, bound(chunk), bound(chunk + 1)); });
+			}
+			f(size_t(0), bound(0), bound(1));
+			group.wait();
+		}
+
+		//! Merges the sorted ranges [first1, last1) and [first2, last2) into out,
+		//! moving the elements, splitting the work around the median of the larger range.
+		template<typename InIt, typename OutIt, typename Compare>
+		void merge(ForkJoin& fj, InIt first1, InIt last1, InIt first2, InIt last2, OutIt out, Compare comp, size_t grain)
+		{
+			auto n1 = static_cast<size_t>(last1 - first1);
+			auto n2 = static_cast<size_t>(last2 - first2);
+			if (n1 + n2 <= grain)
+			{
+				std::merge(std::make_move_iterator(first1), std::make_move_iterator(last1),
+					std::make_move_iterator(first2), std::make_move_iterator(last2), out, comp);
+				return;
+			}
+			if (n1 < n2)
+			{
+				merge(fj, first2, last2, first1, last1, out, comp, grain);
+				return;
+			}
+			auto mid1 = first1 + n1 / 2;
+			auto mid2 = std::lower_bound(first2, last2, *mid1, comp);
+			auto mid_out = out + (mid1 - first1) + (mid2 - first2);
+			*mid_out = std::move(*mid1);
+			fj.invoke([&]{ merge(fj, first1, mid1, first2, mid2, out, comp, grain); },
+				[&]{ merge(fj, mid1 + 1, last1, mid2, last2, mid_out + 1, comp, grain); });
+		}
+
+		//! Sorts [first, last). The result is left in [first, last), or in the
+		//! buffer starting at buffer if into_buffer is set.
+		template<typename RandomIt, typename BufferIt, typename Compare>
+		void mergeSort(ForkJoin& fj, RandomIt first, RandomIt last, BufferIt buffer, bool into_buffer,
+			Compare comp, size_t grain)
+		{
+			auto n = static_cast<size_t>(last - first);
+			if (n <= grain)
+			{
+				std::sort(first, last, comp);
+				if (into_buffer)
+				{
+					std::move(first, last, buffer);
+				}
+				return;
+			}
+			auto half = static_cast<std::ptrdiff_t>(n / 2);
+			// The halves are sorted into the other storage and merged back into ours.
+			fj.invoke([&]{ mergeSort(fj, first, first + half, buffer, !into_buffer, comp, grain); },
+				[&]{ mergeSort(fj, first + half, last, buffer + half, !into_buffer, comp, grain); });
+			if (into_buffer)
+			{
+				merge(fj, first, first + half, first + half, last, buffer, comp, grain);
+			}
+			else
+			{
+				merge(fj, buffer, buffer + half, buffer + half, buffer + n, first, comp, grain);
+			}
+		}
+	}
+
+	//! sort
+	/**
+	 * Sorts [first, last) with a parallel merge sort: the halves are sorted with
+	 * ForkJoin and merged by a parallel merge. The sort is not stable. It needs
+	 * a buffer of last - first elements, built by moving the range, so T only
+	 * has to be movable.
+	 * \param pool the pool that runs the work.
+	 * \param comp the comparison function.
+	 * \param grain ranges up to this size are sorted with std::sort.
+	 */
+	template<typename RandomIt, typename Compare>
+	void sort(ThreadPool<void>& pool, RandomIt first, RandomIt last, Compare comp, size_t grain = kDefaultGrain)
+	{
+		using T = typename std::iterator_traits<RandomIt>::value_type;
+		auto n = static_cast<size_t>(last - first);
+		if (details::sequential(pool, n, grain))
+		{
+			std::sort(first, last, comp);
+			return;
+		}
+		// The buffer holds the data now: sort it and leave the result back in [first, last).
+		std::vector<T> buffer(std::make_move_iterator(first), std::make_move_iterator(last));
+		ForkJoin fj{pool};
+		details::mergeSort(fj, buffer.begin(), buffer.end(), first, true, comp, std::max<size_t>(grain, 1));
+	}
+
+	//! sort
+	/**
+	 * Sorts [first, last) in ascending order. See sort with a comparison function.
+	 */
+	template<typename RandomIt>
+	void sort(ThreadPool<void>& pool, RandomIt first, RandomIt last)
+	{
+		sort(pool, first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+	}
+
+	//! transform
+	/**
+	 * Writes op(x) for every x in [first, last) to the range starting at out.
+	 * \return the end of the output range.
+	 */
+	template<typename RandomIt, typename OutIt, typename UnaryOp>
+	OutIt transform(ThreadPool<void>& pool, RandomIt first, RandomIt last, OutIt out, UnaryOp op,
+		size_t grain = kDefaultGrain)
+	{
+		auto n = static_cast<size_t>(last - first);
+		if (details::sequential(pool, n, grain))
+		{
+			return std::transform(first, last, out, op);
+		}
+		details::forEachChunk(pool, n, details::chunkCount(pool, n, grain), [&](size_t, size_t begin, size_t end)
+		{
+			std::transform(first + begin, first + end, out + begin, op);
+		});
+		return out + n;
+	}
+
+	//! inclusiveScan
+	/**
+	 * Writes the inclusive prefix sums of [first, last) under op to out, which
+	 * may be first. op must be associative. Two passes: chunk totals, then
+	 * chunk scans seeded with the sum of the previous chunks.
+	 * \return the end of the output range.
+	 */
+	template<typename RandomIt, typename OutIt, typename BinaryOp>
+	OutIt inclusiveScan(ThreadPool<void>& pool, RandomIt first, RandomIt last, OutIt out, BinaryOp op,
+		size_t grain = kDefaultGrain)
+	{
+		using T = typename std::iterator_traits<RandomIt>::value_type;
+		auto n = static_cast<size_t>(last - first);
+		if (n == 0)
+		{
+			return out;
+		}
+		if (details::sequential(pool, n, grain))
+		{
+			return std::partial_sum(first, last, out, op);
+		}
+		auto chunks = details::chunkCount(pool, n, grain);
+		std::vector<T> sums(chunks, *first);
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			sums[chunk] = std::accumulate(first + begin + 1, first + end, T(first[begin]), op);
+		});
+		for (size_t chunk = 1; chunk < chunks; ++chunk)
+		{
+			sums[chunk] = op(sums[chunk - 1], sums[chunk]);
+		}
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			T acc = (chunk == 0) ? T(first[begin]) : op(sums[chunk - 1], first[begin]);
+			out[begin] = acc;
+			for (auto i = begin + 1; i < end; ++i)
+			{
+				acc = op(acc, first[i]);
+				out[i] = acc;
+			}
+		});
+		return out + n;
+	}
+
+	//! inclusiveScan
+	/**
+	 * Inclusive prefix sums with operator+.
+	 */
+	template<typename RandomIt, typename OutIt>
+	OutIt inclusiveScan(ThreadPool<void>& pool, RandomIt first, RandomIt last, OutIt out)
+	{
+		return inclusiveScan(pool, first, last, out, std::plus<typename std::iterator_traits<RandomIt>::value_type>());
+	}
+
+	//! exclusiveScan
+	/**
+	 * Writes init, init op x0, init op x0 op x1... (without the last element) to
+	 * out, which may be first. op must be associative.
+	 * \return the end of the output range.
+	 */
+	template<typename RandomIt, typename OutIt, typename T, typename BinaryOp>
+	OutIt exclusiveScan(ThreadPool<void>& pool, RandomIt first, RandomIt last, OutIt out, T init, BinaryOp op,
+		size_t grain = kDefaultGrain)
+	{
+		auto n = static_cast<size_t>(last - first);
+		auto scanChunk = [&](T acc, size_t begin, size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+			{
+				T next = op(acc, first[i]); // Read before writing, out may alias first.
+				out[i] = std::move(acc);
+				acc = std::move(next);
+			}
+		};
+		if (details::sequential(pool, n, grain))
+		{
+			scanChunk(init, 0, n);
+			return out + n;
+		}
+		auto chunks = details::chunkCount(pool, n, grain);
+		std::vector<T> sums(chunks, init);
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			T acc = first[begin];
+			for (auto i = begin + 1; i < end; ++i)
+			{
+				acc = op(acc, first[i]);
+			}
+			sums[chunk] = acc;
+		});
+		// sums[c] becomes the seed of chunk c.
+		T seed = init;
+		for (size_t chunk = 0; chunk < chunks; ++chunk)
+		{
+			T total = sums[chunk];
+			sums[chunk] = seed;
+			seed = op(seed, total);
+		}
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			scanChunk(sums[chunk], begin, end);
+		});
+		return out + n;
+	}
+
+	//! exclusiveScan
+	/**
+	 * Exclusive prefix sums with operator+.
+	 */
+	template<typename RandomIt, typename OutIt, typename T>
+	OutIt exclusiveScan(ThreadPool<void>& pool, RandomIt first, RandomIt last, OutIt out, T init)
+	{
+		return exclusiveScan(pool, first, last, out, init, std::plus<T>());
+	}
+
+	//! partition
+	/**
+	 * Reorders [first, last) so the elements satisfying pred come first. Every
+	 * chunk is partitioned in parallel; then the misplaced elements, falses in
+	 * the head of the range and trues in its tail, are swapped pairwise in
+	 * parallel. It is not stable.
+	 * \return the first element of the second group.
+	 */
+	template<typename RandomIt, typename UnaryPredicate>
+	RandomIt partition(ThreadPool<void>& pool, RandomIt first, RandomIt last, UnaryPredicate pred,
+		size_t grain = kDefaultGrain)
+	{
+		auto n = static_cast<size_t>(last - first);
+		if (details::sequential(pool, n, grain))
+		{
+			return std::partition(first, last, pred);
+		}
+		auto chunks = details::chunkCount(pool, n, grain);
+		std::vector<size_t> splits(chunks);
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			splits[chunk] = static_cast<size_t>(std::partition(first + begin, first + end, pred) - first);
+		});
+
+		// Every chunk is now [trues][falses]; the final split point is the number of trues.
+		size_t split = 0;
+		for (size_t chunk = 0; chunk < chunks; ++chunk)
+		{
+			split += splits[chunk] - n * chunk / chunks;
+		}
+		// Runs of falses before split and runs of trues after it, in order.
+		std::vector<std::pair<size_t, size_t>> falses, trues;
+		for (size_t chunk = 0; chunk < chunks; ++chunk)
+		{
+			auto begin = n * chunk / chunks, end = n * (chunk + 1) / chunks;
+			if (splits[chunk] < split && splits[chunk] < end)
+			{
+				falses.emplace_back(splits[chunk], std::min(end, split));
+			}
+			if (splits[chunk] > split && begin < splits[chunk])
+			{
+				trues.emplace_back(std::max(begin, split), splits[chunk]);
+			}
+		}
+		// Offsets of every run in the sequence of misplaced elements.
+		auto offsets = [](const std::vector<std::pair<size_t, size_t>>& runs)
+		{
+			std::vector<size_t> result(1, 0);
+			for (const auto& run : runs)
+			{
+				result.push_back(result.back() + run.second - run.first);
+			}
+			return result;
+		};
+		auto false_offsets = offsets(falses);
+		auto true_offsets = offsets(trues);
+		auto misplaced = false_offsets.back(); // Equal to true_offsets.back().
+		if (misplaced == 0)
+		{
+			return first + split;
+		}
+		// Position of the k-th misplaced element.
+		auto locate = [](const std::vector<std::pair<size_t, size_t>>& runs, const std::vector<size_t>& offs, size_t k)
+		{
+			auto run = static_cast<size_t>(std::upper_bound(offs.begin(), offs.end(), k) - offs.begin()) - 1;
+			return runs[run].first + (k - offs[run]);
+		};
+		details::forEachChunk(pool, misplaced, details::chunkCount(pool, misplaced, grain),
+			[&](size_t, size_t begin, size_t end)
+		{
+			for (auto k = begin; k < end; ++k)
+			{
+				using std::swap;
+				swap(first[locate(falses, false_offsets, k)], first[locate(trues, true_offsets, k)]);
+			}
+		});
+		return first + split;
+	}
+
+	//! copyIf
+	/**
+	 * Copies the elements of [first, last) satisfying pred to out, keeping their
+	 * order. The elements are counted per chunk first so every chunk knows
+	 * where its output starts.
+	 * \return the end of the output range.
+	 */
+	template<typename RandomIt, typename OutIt, typename UnaryPredicate>
+	OutIt copyIf(ThreadPool<void>& pool, RandomIt first, RandomIt last, OutIt out, UnaryPredicate pred,
+		size_t grain = kDefaultGrain)
+	{
+		auto n = static_cast<size_t>(last - first);
+		if (details::sequential(pool, n, grain))
+		{
+			return std::copy_if(first, last, out, pred);
+		}
+		auto chunks = details::chunkCount(pool, n, grain);
+		std::vector<size_t> counts(chunks + 1, 0);
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			counts[chunk + 1] = static_cast<size_t>(std::count_if(first + begin, first + end, pred));
+		});
+		std::partial_sum(counts.begin(), counts.end(), counts.begin());
+		details::forEachChunk(pool, n, chunks, [&](size_t chunk, size_t begin, size_t end)
+		{
+			std::copy_if(first + begin, first + end, out + counts[chunk], pred);
+		});
+		return out + counts[chunks];
+	}
+
+	//! findIf
+	/**
+	 * Finds the first element of [first, last) satisfying pred. Chunks stop
+	 * early once an element before them has been found.
+	 * \return the element or last.
+	 */
+	template<typename RandomIt, typename UnaryPredicate>
+	RandomIt findIf(ThreadPool<void>& pool, RandomIt first, RandomIt last, UnaryPredicate pred,
+		size_t grain = kDefaultGrain)
+	{
+		auto n = static_cast<size_t>(last - first);
+		if (details::sequential(pool, n, grain))
+		{
+			return std::find_if(first, last, pred);
+		}
+		static constexpr size_t kBlock = 1024; // Elements checked between looks at the best result.
+		std::atomic<size_t> found{n};
+		details::forEachChunk(pool, n, details::chunkCount(pool, n, grain), [&](size_t, size_t begin, size_t end)
+		{
+			for (auto block = begin; block < end && block < found.load(std::memory_order_relaxed); block += kBlock)
+			{
+				auto block_end = std::min(end, block + kBlock);
+				auto it = std::find_if(first + block, first + block_end, pred);
+				if (it != first + block_end)
+				{
+					auto index = static_cast<size_t>(it - first);
+					auto best = found.load(std::memory_order_relaxed);
+					while (index < best && !found.compare_exchange_weak(best, index, std::memory_order_relaxed)) {}
+					return;
+				}
+			}
+		});
+		return first + found.load(std::memory_order_relaxed);
+	}
+
+	//! find
+	/**
+	 * Finds the first element of [first, last) equal to value.
+	 * \return the element or last.
+	 */
+	template<typename RandomIt, typename T>
+	RandomIt find(ThreadPool<void>& pool, RandomIt first, RandomIt last, const T& value, size_t grain = kDefaultGrain)
+	{
+		return findIf(pool, first, last, [&value](const typename std::iterator_traits<RandomIt>::value_type& x)
+		{
+			return x == value;
+		}, grain);
+	}
+
+}}}} // rboc::utils::threading::parallel
+#endif // THREADING_ALGORITHMS_HEADER
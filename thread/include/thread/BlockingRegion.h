@@ -0,0 +1,145 @@
+#pragma once
+#ifndef THREADING_BLOCKINGREGION_HEADER
+#define THREADING_BLOCKINGREGION_HEADER
+
+#include <utility>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! BlockingHandler
+		/**
+		 * Implemented by executors that can compensate for a worker thread that is
+		 * about to block, i.e. by running its queue on another thread meanwhile.
+		 */
+		class BlockingHandler
+		{
+			public:
+
+			//! Called by the worker thread before it blocks.
+			/**
+			 * Must not throw: regions are entered from noexcept waits, i.e. in
+			 * destructors. A handler that cannot compensate returns false.
+			 * \return true if the handler is compensating and expects leaveBlocking.
+			 */
+			virtual bool enterBlocking() noexcept = 0;
+
+			//! Called by the worker thread once it is runnable again.
+			virtual void leaveBlocking() = 0;
+
+			protected:
+
+			~BlockingHandler() = default;
+		};
+
+		//! The handler of the executor whose task is running on the calling thread.
+		inline BlockingHandler*& currentBlockingHandler() noexcept
+		{
+			static thread_local BlockingHandler* handler = nullptr;
+			return handler;
+		}
+
+		//! Nesting depth of blocking regions on the calling thread.
+		inline int& blockingDepth() noexcept
+		{
+			static thread_local int depth = 0;
+			return depth;
+		}
+
+		//! Installs a handler for the calling thread for the lifetime of the scope.
+		class BlockingHandlerScope
+		{
+			public:
+
+			explicit BlockingHandlerScope(BlockingHandler* handler) noexcept
+				: _previous(currentBlockingHandler())
+			{
+				currentBlockingHandler() = handler;
+			}
+
+			~BlockingHandlerScope()
+			{
+				currentBlockingHandler() = _previous;
+			}
+
+			BlockingHandlerScope(const BlockingHandlerScope&) = delete;
+			BlockingHandlerScope& operator=(const BlockingHandlerScope&) = delete;
+
+			private:
+
+			BlockingHandler* _previous;
+		};
+	}
+
+	//! class BlockingRegion
+	/**
+	 * Marks the enclosing scope as blocking (file I/O, sleeping, waiting on a
+	 * future...). When the calling thread is a ThreadPool worker, the pool stops
+	 * feeding it new tasks and a compensating thread runs its queue until the
+	 * region ends. Anywhere else it does nothing. Nested regions count once.
+	 *
+	 * \code
+	 * pool.addTask([&]
+	 * {
+	 *     BlockingRegion region;
+	 *     ::read(fd, buffer, size);
+	 * });
+	 * \endcode
+	 */
+	class BlockingRegion
+	{
+		public:
+
+		//! Default constructor
+		BlockingRegion()
+			: _handler(nullptr)
+		{
+			auto handler = details::currentBlockingHandler();
+			if (handler != nullptr && details::blockingDepth()++ == 0 && handler->enterBlocking())
+			{
+				_handler = handler;
+			}
+			_nested = (handler != nullptr);
+		}
+
+		//! Destructor
+		~BlockingRegion()
+		{
+			if (_nested)
+			{
+				--details::blockingDepth();
+			}
+			if (_handler != nullptr)
+			{
+				_handler->leaveBlocking();
+			}
+		}
+
+		//! Copy constructor
+		BlockingRegion(const BlockingRegion& other) = delete;
+		//! Copy assignment
+		BlockingRegion& operator=(const BlockingRegion& other) = delete;
+
+		private:
+
+		details::BlockingHandler* _handler; // Set only if the handler is compensating for us.
+		bool _nested;                       // True if the depth counter was incremented.
+	};
+
+	//! blocking
+	/**
+	 * Runs f inside a BlockingRegion.
+	 * \param f the blocking function.
+	 * \return whatever f returns.
+	 */
+	template<typename F>
+	auto blocking(F&& f) -> decltype(std::forward<F>(f)())
+	{
+		BlockingRegion region;
+		return std::forward<F>(f)();
+	}
+
+}}} // rboc::utils::threading
+
+#endif // THREADING_BLOCKINGREGION_HEADER
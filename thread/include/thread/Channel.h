@@ -0,0 +1,486 @@
+#pragma once
+#ifndef THREADING_CHANNEL_HEADER
+#define THREADING_CHANNEL_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <common/Utility.h>
+#include <thread/EventCount.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! Outcome of the non-blocking and timed channel operations.
+	enum class ChannelStatus
+	{
+		success, //!< The item was sent or received.
+		full,    //!< trySend found no room.
+		empty,   //!< tryRecv found no item.
+		timeout, //!< The timed operation gave up.
+		closed   //!< The channel is closed (and, for receivers, drained).
+	};
+
+	namespace details
+	{
+		//! One cell of the ring: the item and the sequence number that tells
+		//! producers and consumers whose turn it is.
+		template<typename T>
+		struct ChannelSlot
+		{
+			std::atomic<size_t> sequence;
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+			T* item() noexcept
+			{
+				return reinterpret_cast<T*>(&storage);
+			}
+		};
+
+		inline size_t roundUpToPowerOfTwo(size_t value) noexcept
+		{
+			size_t result = 2; // A single slot cannot tell a full ring from an empty one.
+			while (result < value)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+	}
+
+	//! class Channel
+	/**
+	 * A bounded multi-producer multi-consumer channel on a ring buffer with a
+	 * sequence number per slot (Vyukov's bounded queue): producers and
+	 * consumers claim slots with a single CAS on their own cursor and never
+	 * take a lock. Blocking operations park on an EventCount, so a receiver
+	 * waiting on an empty channel (or a sender on a full one) sleeps in the
+	 * kernel instead of spinning, and the other side pays no syscall when
+	 * nobody sleeps.
+	 *
+	 * send() blocks while the channel is full, which is how a slow consumer
+	 * pushes back on its producers, and recv() blocks while it is empty. The
+	 * try and timed variants report a ChannelStatus instead.
+	 *
+	 * Once closed, sends fail and receivers drain the remaining items before
+	 * recv() starts failing too. The closed flag lives in the producer cursor,
+	 * so a send either lands before the close or fails.
+	 *
+	 * T must be nothrow movable: an item is moved in and out of a slot after
+	 * the slot is claimed, and a throw there would leave it claimed for ever.
+	 */
+	template<typename T>
+	class Channel
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param capacity the maximum number of queued items, rounded up to a power of two
+		 * no smaller than 2. It must be positive.
+		 */
+		explicit Channel(size_t capacity)
+			: _capacity(checkedCapacity(capacity))
+			, _mask(_capacity - 1)
+			, _slots(new details::ChannelSlot<T>[_capacity])
+		{
+			static_assert(std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_assignable<T>::value,
+				"Channel items must be nothrow movable: a claimed slot cannot be given back");
+			for (size_t i = 0; i < _capacity; ++i)
+			{
+				_slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		//! Copy constructor
+		Channel(const Channel& other) = delete;
+		//! Copy assignment
+		Channel& operator=(const Channel& other) = delete;
+
+		//! Destructor
+		/**
+		 * Destroys the items still queued.
+		 */
+		~Channel()
+		{
+			while (popWith([](T&){}) == ChannelStatus::success) {}
+		}
+
+		//! trySend
+		/**
+		 * Queues value if there is room, without blocking.
+		 * \return success, full or closed. value is left untouched unless it was sent.
+		 */
+		ChannelStatus trySend(T&& value)
+		{
+			auto status = push(value);
+			if (status == ChannelStatus::success)
+			{
+				_not_empty.notify();
+			}
+			return status;
+		}
+
+		//! send
+		/**
+		 * Queues value, waiting for room if the channel is full.
+		 * \return false if the channel is closed; value is left untouched then.
+		 */
+		bool send(T&& value)
+		{
+			return sendUntil(std::move(value), std::chrono::steady_clock::time_point::max()) == ChannelStatus::success;
+		}
+
+		//! send
+		/**
+		 * Queues a copy of value. See send(T&&).
+		 */
+		bool send(const T& value)
+		{
+			T copy(value);
+			return send(std::move(copy));
+		}
+
+		//! sendFor
+		/**
+		 * Queues value, waiting at most timeout for room.
+		 * \return success, timeout or closed.
+		 */
+		template<typename Rep, typename Period>
+		ChannelStatus sendFor(T&& value, const std::chrono::duration<Rep, Period>& timeout)
+		{
+			return sendUntil(std::move(value), deadlineAfter(timeout));
+		}
+
+		//! sendUntil
+		/**
+		 * Queues value, waiting for room until deadline.
+		 * \return success, timeout or closed.
+		 */
+		ChannelStatus sendUntil(T&& value, std::chrono::steady_clock::time_point deadline)
+		{
+			auto status = waitFor(_not_full, ChannelStatus::full, deadline, [&]{ return push(value); });
+			if (status == ChannelStatus::success)
+			{
+				_not_empty.notify();
+			}
+			return status;
+		}
+
+		//! sendBatch
+		/**
+		 * Queues the items of [first, last) in order, moving them, waiting for
+		 * room as needed. Receivers are woken once per batch rather than per item.
+		 * \return the number of items sent, less than the batch size only if the channel was closed.
+		 */
+		template<typename It>
+		size_t sendBatch(It first, It last)
+		{
+			size_t sent = 0;
+			for (; first != last; ++first)
+			{
+				auto status = push(*first);
+				if (status == ChannelStatus::full)
+				{
+					if (sent != 0) _not_empty.notifyAll(); // Let receivers drain while we wait.
+					status = waitFor(_not_full, ChannelStatus::full, std::chrono::steady_clock::time_point::max(),
+						[&]{ return push(*first); });
+				}
+				if (status != ChannelStatus::success)
+				{
+					break;
+				}
+				++sent;
+			}
+			if (sent != 0)
+			{
+				_not_empty.notifyAll();
+			}
+			return sent;
+		}
+
+		//! tryRecv
+		/**
+		 * Takes the oldest item if there is one, without blocking.
+		 * \param value Output parameter that receives the item.
+		 * \return success, empty or closed (closed and drained).
+		 */
+		ChannelStatus tryRecv(T& value)
+		{
+			auto status = pop(value);
+			if (status == ChannelStatus::success)
+			{
+				_not_full.notify();
+			}
+			return status;
+		}
+
+		//! recv
+		/**
+		 * Takes the oldest item, waiting for one if the channel is empty.
+		 * \param value Output parameter that receives the item.
+		 * \return false if the channel is closed and empty.
+		 */
+		bool recv(T& value)
+		{
+			return recvUntil(value, std::chrono::steady_clock::time_point::max()) == ChannelStatus::success;
+		}
+
+		//! recvFor
+		/**
+		 * Takes the oldest item, waiting at most timeout for one.
+		 * \return success, timeout or closed.
+		 */
+		template<typename Rep, typename Period>
+		ChannelStatus recvFor(T& value, const std::chrono::duration<Rep, Period>& timeout)
+		{
+			return recvUntil(value, deadlineAfter(timeout));
+		}
+
+		//! recvUntil
+		/**
+		 * Takes the oldest item, waiting for one until deadline.
+		 * \return success, timeout or closed.
+		 */
+		ChannelStatus recvUntil(T& value, std::chrono::steady_clock::time_point deadline)
+		{
+			auto status = waitFor(_not_empty, ChannelStatus::empty, deadline, [&]{ return pop(value); });
+			if (status == ChannelStatus::success)
+			{
+				_not_full.notify();
+			}
+			return status;
+		}
+
+		//! recvBatch
+		/**
+		 * Waits for at least one item and then takes up to max_items without
+		 * waiting any longer. Senders are woken once per batch.
+		 * \param out an output iterator receiving the items in order.
+		 * \param max_items the maximum number of items to take.
+		 * \return the number of items received, 0 only if the channel is closed and drained.
+		 */
+		template<typename OutIt>
+		size_t recvBatch(OutIt out, size_t max_items)
+		{
+			if (max_items == 0)
+			{
+				return 0;
+			}
+			auto take = [&out](T& item){ *out++ = std::move(item); }; // Straight from the slot.
+			if (waitFor(_not_empty, ChannelStatus::empty, std::chrono::steady_clock::time_point::max(),
+				[&]{ return popWith(take); }) != ChannelStatus::success)
+			{
+				return 0;
+			}
+			size_t received = 1;
+			while (received < max_items && popWith(take) == ChannelStatus::success)
+			{
+				++received;
+			}
+			_not_full.notifyAll();
+			return received;
+		}
+
+		//! close
+		/**
+		 * Closes the channel and wakes every blocked sender and receiver.
+		 */
+		void close()
+		{
+			_tail.value.fetch_or(kClosed, std::memory_order_acq_rel);
+			_not_full.notifyAll();
+			_not_empty.notifyAll();
+		}
+
+		//! closed
+		bool closed() const noexcept
+		{
+			return (_tail.value.load(std::memory_order_acquire) & kClosed) != 0;
+		}
+
+		//! size
+		/**
+		 * \return the number of queued items. It may be stale by the time it is used.
+		 */
+		size_t size() const noexcept
+		{
+			auto head = _head.value.load(std::memory_order_acquire);
+			auto tail = _tail.value.load(std::memory_order_acquire) & ~kClosed;
+			return tail > head ? tail - head : 0;
+		}
+
+		//! capacity
+		size_t capacity() const noexcept
+		{
+			return _capacity;
+		}
+
+		private:
+
+		//! Set in the producer cursor once the channel is closed.
+		static constexpr size_t kClosed = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+		//! A cursor padded so that it never shares a cache line with the next member
+		//! (over-aligned allocation is not available before C++17).
+		struct Cursor
+		{
+			std::atomic<size_t> value{0};
+			char padding[utilities::kCacheLineSize - sizeof(std::atomic<size_t>)];
+		};
+
+		static size_t checkedCapacity(size_t capacity)
+		{
+			if (capacity == 0 || capacity > (kClosed >> 1))
+			{
+				throw std::invalid_argument("channel capacity must be positive");
+			}
+			return details::roundUpToPowerOfTwo(capacity);
+		}
+
+		template<typename Rep, typename Period>
+		static std::chrono::steady_clock::time_point deadlineAfter(const std::chrono::duration<Rep, Period>& timeout)
+		{
+			return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+		}
+
+		// Retries attempt, parking on event between tries, while it reports busy.
+		template<typename Attempt>
+		ChannelStatus waitFor(EventCount& event, ChannelStatus busy, std::chrono::steady_clock::time_point deadline,
+			Attempt attempt)
+		{
+			while (true)
+			{
+				auto status = attempt();
+				if (status != busy)
+				{
+					return status;
+				}
+				auto key = event.prepareWait();
+				status = attempt();
+				if (status != busy)
+				{
+					event.cancelWait();
+					return status;
+				}
+				if (deadline == std::chrono::steady_clock::time_point::max())
+				{
+					event.wait(key);
+				}
+				else if (!event.waitUntil(key, deadline))
+				{
+					return ChannelStatus::timeout;
+				}
+			}
+		}
+
+		// Destroys the item of a claimed consumer slot and gives the slot back to producers.
+		struct SlotRelease
+		{
+			details::ChannelSlot<T>* slot;
+			size_t sequence;
+
+			~SlotRelease()
+			{
+				slot->item()->~T();
+				slot->sequence.store(sequence, std::memory_order_release);
+			}
+		};
+
+		// Claims the next producer slot and moves value into it.
+		ChannelStatus push(T& value)
+		{
+			auto pos = _tail.value.load(std::memory_order_relaxed);
+			details::ChannelSlot<T>* slot;
+			while (true)
+			{
+				if (pos & kClosed)
+				{
+					return ChannelStatus::closed;
+				}
+				slot = &_slots[pos & _mask];
+				auto sequence = slot->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+				if (diff == 0)
+				{
+					if (_tail.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					return ChannelStatus::full; // The slot still holds the item of the previous lap.
+				}
+				else
+				{
+					pos = _tail.value.load(std::memory_order_relaxed);
+				}
+			}
+			::new (static_cast<void*>(slot->item())) T(std::move(value));
+			slot->sequence.store(pos + 1, std::memory_order_release);
+			return ChannelStatus::success;
+		}
+
+		// Claims the next consumer slot and moves its item into value.
+		ChannelStatus pop(T& value)
+		{
+			return popWith([&value](T& item){ value = std::move(item); });
+		}
+
+		// Claims the next consumer slot and hands its item to take. The item is
+		// destroyed and the slot recycled even if take throws.
+		template<typename Take>
+		ChannelStatus popWith(Take&& take)
+		{
+			auto pos = _head.value.load(std::memory_order_relaxed);
+			details::ChannelSlot<T>* slot;
+			while (true)
+			{
+				slot = &_slots[pos & _mask];
+				auto sequence = slot->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+				if (diff == 0)
+				{
+					if (_head.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					// Nothing published here yet. Closed and drained only if no
+					// producer claimed the slot before the channel was closed.
+					auto tail = _tail.value.load(std::memory_order_acquire);
+					return ((tail & kClosed) && (tail & ~kClosed) == pos) ? ChannelStatus::closed : ChannelStatus::empty;
+				}
+				else
+				{
+					pos = _head.value.load(std::memory_order_relaxed);
+				}
+			}
+			SlotRelease release{slot, pos + _mask + 1};
+			take(*slot->item());
+			return ChannelStatus::success;
+		}
+
+		const size_t _capacity;
+		const size_t _mask;
+		std::unique_ptr<details::ChannelSlot<T>[]> _slots;
+		char _padding[utilities::kCacheLineSize]; // Keeps the cursors off the read-only members.
+		Cursor _tail;  // Next position producers claim; its top bit is the closed flag.
+		Cursor _head;  // Next position consumers claim.
+		EventCount _not_empty;
+		EventCount _not_full;
+	};
+
+	template<typename T>
+	constexpr size_t Channel<T>::kClosed;
+
+}}} // rboc::utils::threading
+#endif // THREADING_CHANNEL_HEADER
@@ -0,0 +1,456 @@
+#pragma once
+#ifndef THREADING_CONCURRENTHASHMAP_HEADER
+#define THREADING_CONCURRENTHASHMAP_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <common/Optional.h>
+#include <common/Utility.h>
+#include <thread/Reclamation.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! Spreads the bits of a hash, std::hash of integers being the identity.
+		inline size_t mixHash(size_t hash) noexcept
+		{
+			uint64_t x = hash;
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdULL;
+			x ^= x >> 33;
+			x *= 0xc4ceb9fe1a85ec53ULL;
+			x ^= x >> 33;
+			return static_cast<size_t>(x);
+		}
+
+		//! An entry of the map. Entries are immutable once published but for their
+		//! link: assigning a key publishes a new entry and retires the old one.
+		template<typename Key, typename Value>
+		struct HashMapNode
+		{
+			template<typename V>
+			HashMapNode(size_t node_hash, const Key& node_key, V&& node_value, HashMapNode* next_node)
+				: hash(node_hash)
+				, key(node_key)
+				, value(std::forward<V>(node_value))
+				, next(next_node)
+			{}
+
+			const size_t hash;
+			const Key key;
+			const Value value;
+			std::atomic<HashMapNode*> next;
+		};
+
+		//! A power-of-two array of buckets, each one a list of nodes.
+		template<typename Node>
+		struct HashMapTable
+		{
+			explicit HashMapTable(size_t bucket_count)
+				: mask(bucket_count - 1)
+				, buckets(new std::atomic<Node*>[bucket_count])
+			{
+				for (size_t i = 0; i < bucket_count; ++i)
+				{
+					buckets[i].store(nullptr, std::memory_order_relaxed);
+				}
+			}
+
+			size_t size() const noexcept
+			{
+				return mask + 1;
+			}
+
+			std::atomic<Node*>& bucket(size_t hash) noexcept
+			{
+				return buckets[hash & mask];
+			}
+
+			const size_t mask;
+			std::unique_ptr<std::atomic<Node*>[]> buckets;
+		};
+
+		//! The lock of a group of buckets and the number of entries in them.
+		struct HashMapStripe
+		{
+			std::mutex mtx;
+			std::atomic<size_t> count{0}; // Written with mtx held.
+			char padding[utilities::kCacheLineSize];
+		};
+
+		inline size_t bucketPowerOfTwo(size_t n) noexcept
+		{
+			size_t result = 1;
+			while (result < n)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+	}
+
+	//! class ConcurrentHashMap
+	/**
+	 * A hash map for lookup tables shared by many threads, i.e. caches used by
+	 * pool tasks. Reads take no lock and write no shared memory besides their
+	 * thread's epoch: they walk the bucket lists under an EpochGuard. Writers
+	 * lock one of a fixed number of stripes, so writes to different stripes
+	 * proceed in parallel. A bucket always belongs to the same stripe, even
+	 * after the table has grown.
+	 *
+	 * Entries are immutable: assigning a key publishes a new entry and retires
+	 * the old one through the map's EpochDomain, so a reader never sees a value
+	 * being modified. Lookups therefore return copies.
+	 *
+	 * The table doubles when a stripe holds more entries than buckets; growing
+	 * locks every stripe while the entries are copied, readers are not blocked.
+	 *
+	 * Key and Value must be copy constructible; Hash and KeyEqual must be safe
+	 * to call concurrently.
+	 *
+	 * \code
+	 * ConcurrentHashMap<std::string, Route> routes;
+	 * routes.insertOrAssign("eu", route);
+	 * pool.addTask([&]{ if (auto route = routes.find("eu")) send(*route); });
+	 * \endcode
+	 */
+	template<typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+	class ConcurrentHashMap
+	{
+		using Node = details::HashMapNode<Key, Value>;
+		using Table = details::HashMapTable<Node>;
+
+		public:
+
+		//! Constructor
+		/**
+		 * \param stripes the number of writer locks, rounded up to a power of two. It must be positive.
+		 * \param initial_buckets the initial number of buckets, at least one per stripe.
+		 */
+		explicit ConcurrentHashMap(size_t stripes = 64, size_t initial_buckets = 0, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+			: _stripe_count(checkedStripes(stripes))
+			, _stripes(new details::HashMapStripe[_stripe_count])
+			, _initial_buckets(details::bucketPowerOfTwo(std::max(initial_buckets, _stripe_count)))
+			, _table(new Table(_initial_buckets))
+			, _hash(hash)
+			, _equal(equal)
+		{}
+
+		//! Copy constructor
+		ConcurrentHashMap(const ConcurrentHashMap& other) = delete;
+		//! Copy assignment
+		ConcurrentHashMap& operator=(const ConcurrentHashMap& other) = delete;
+
+		//! Destructor
+		/**
+		 * No other thread may be using the map.
+		 */
+		~ConcurrentHashMap()
+		{
+			auto table = _table.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < table->size(); ++i)
+			{
+				auto node = table->buckets[i].load(std::memory_order_relaxed);
+				while (node != nullptr)
+				{
+					auto next = node->next.load(std::memory_order_relaxed);
+					delete node;
+					node = next;
+				}
+			}
+			delete table;
+		}
+
+		//! find
+		/**
+		 * Lock-free lookup.
+		 * \return a copy of the value of key, or nullopt if key is not in the map.
+		 */
+		optional::Optional<Value> find(const Key& key) const
+		{
+			auto hash = hashOf(key);
+			EpochGuard guard{_domain};
+			if (auto node = lookup(hash, key))
+			{
+				return node->value;
+			}
+			return optional::nullopt;
+		}
+
+		//! contains
+		/**
+		 * Lock-free lookup.
+		 * \return true if key is in the map.
+		 */
+		bool contains(const Key& key) const
+		{
+			auto hash = hashOf(key);
+			EpochGuard guard{_domain};
+			return lookup(hash, key) != nullptr;
+		}
+
+		//! insertOrAssign
+		/**
+		 * Inserts key or replaces its value.
+		 * \return true if key was inserted, false if it was assigned.
+		 */
+		bool insertOrAssign(const Key& key, Value value)
+		{
+			bool inserted = false;
+			update(key, [&value, &inserted](const Node* current)
+			{
+				inserted = current == nullptr;
+				return optional::Optional<Value>(std::move(value));
+			});
+			return inserted;
+		}
+
+		//! erase
+		/**
+		 * Removes key from the map.
+		 * \return true if key was in the map.
+		 */
+		bool erase(const Key& key)
+		{
+			bool erased = false;
+			update(key, [&erased](const Node* current)
+			{
+				erased = current != nullptr;
+				return optional::Optional<Value>();
+			});
+			return erased;
+		}
+
+		//! compute
+		/**
+		 * Atomically replaces the value of key with the result of f. f runs with
+		 * the stripe of key locked, so it must be short and must not use the map.
+		 * \param f a function taking the current value, as a const optional::Optional<Value>&,
+		 * and returning an optional::Optional<Value>: the new value, or nullopt to erase key.
+		 * \return the value returned by f.
+		 */
+		template<typename F>
+		optional::Optional<Value> compute(const Key& key, F f)
+		{
+			optional::Optional<Value> result;
+			update(key, [&f, &result](const Node* current)
+			{
+				result = current != nullptr ? f(optional::Optional<Value>(current->value)) : f(optional::Optional<Value>());
+				return result;
+			});
+			return result;
+		}
+
+		//! clear
+		/**
+		 * Removes every entry and shrinks the table back to its initial size.
+		 */
+		void clear()
+		{
+			auto locks = lockAll();
+			replaceTable(new Table(_initial_buckets));
+			for (size_t i = 0; i < _stripe_count; ++i)
+			{
+				_stripes[i].count.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		//! forEach
+		/**
+		 * Calls f(key, value) for the entries of the map, without locking. Entries
+		 * inserted or erased meanwhile may or may not be visited.
+		 */
+		template<typename F>
+		void forEach(F f) const
+		{
+			EpochGuard guard{_domain};
+			auto table = _table.load(std::memory_order_acquire);
+			for (size_t i = 0; i < table->size(); ++i)
+			{
+				for (auto node = table->buckets[i].load(std::memory_order_acquire); node != nullptr; node = node->next.load(std::memory_order_acquire))
+				{
+					f(node->key, node->value);
+				}
+			}
+		}
+
+		//! size
+		/**
+		 * \return the number of entries. Only exact when no writer is running.
+		 */
+		size_t size() const noexcept
+		{
+			size_t result = 0;
+			for (size_t i = 0; i < _stripe_count; ++i)
+			{
+				result += _stripes[i].count.load(std::memory_order_relaxed);
+			}
+			return result;
+		}
+
+		//! empty
+		bool empty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		//! bucketCount
+		/**
+		 * \return the current number of buckets.
+		 */
+		size_t bucketCount() const noexcept
+		{
+			EpochGuard guard{_domain};
+			return _table.load(std::memory_order_acquire)->size();
+		}
+
+		private:
+
+		static size_t checkedStripes(size_t stripes)
+		{
+			if (stripes == 0)
+			{
+				throw std::invalid_argument("stripe count must be positive");
+			}
+			return details::bucketPowerOfTwo(stripes);
+		}
+
+		size_t hashOf(const Key& key) const
+		{
+			return details::mixHash(_hash(key));
+		}
+
+		details::HashMapStripe& stripeOf(size_t hash) const noexcept
+		{
+			return _stripes[hash & (_stripe_count - 1)];
+		}
+
+		// Walks the bucket of key. The caller holds an EpochGuard.
+		const Node* lookup(size_t hash, const Key& key) const
+		{
+			auto table = _table.load(std::memory_order_acquire);
+			for (auto node = table->bucket(hash).load(std::memory_order_acquire); node != nullptr; node = node->next.load(std::memory_order_acquire))
+			{
+				if (node->hash == hash && _equal(node->key, key))
+				{
+					return node;
+				}
+			}
+			return nullptr;
+		}
+
+		// Replaces the entry of key by the value returned by f(current entry or null),
+		// or removes it if f returns nullopt. Grows the table afterwards if needed.
+		template<typename F>
+		void update(const Key& key, F f)
+		{
+			auto hash = hashOf(key);
+			auto& stripe = stripeOf(hash);
+			const Table* grown_from = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(stripe.mtx);
+				auto table = _table.load(std::memory_order_relaxed); // Growing needs this lock too.
+				auto link = &table->bucket(hash);
+				auto current = link->load(std::memory_order_relaxed);
+				while (current != nullptr && !(current->hash == hash && _equal(current->key, key)))
+				{
+					link = &current->next;
+					current = link->load(std::memory_order_relaxed);
+				}
+				auto value = f(static_cast<const Node*>(current));
+				auto next = current != nullptr ? current->next.load(std::memory_order_relaxed) : nullptr;
+				auto count = stripe.count.load(std::memory_order_relaxed);
+				if (value)
+				{
+					link->store(new Node(hash, current != nullptr ? current->key : key, std::move(*value), next), std::memory_order_release);
+					if (current == nullptr)
+					{
+						stripe.count.store(++count, std::memory_order_relaxed);
+					}
+				}
+				else if (current != nullptr)
+				{
+					link->store(next, std::memory_order_release);
+					stripe.count.store(--count, std::memory_order_relaxed);
+				}
+				if (current != nullptr)
+				{
+					_domain.retire(current);
+				}
+				if (count > table->size() / _stripe_count)
+				{
+					grown_from = table;
+				}
+			}
+			if (grown_from != nullptr)
+			{
+				grow(grown_from);
+			}
+		}
+
+		std::vector<std::unique_lock<std::mutex>> lockAll()
+		{
+			std::vector<std::unique_lock<std::mutex>> locks;
+			locks.reserve(_stripe_count);
+			for (size_t i = 0; i < _stripe_count; ++i)
+			{
+				locks.emplace_back(_stripes[i].mtx);
+			}
+			return locks;
+		}
+
+		// Doubles the table unless another writer already did.
+		void grow(const Table* seen)
+		{
+			auto locks = lockAll();
+			auto table = _table.load(std::memory_order_relaxed);
+			if (table != seen) return;
+			std::unique_ptr<Table> bigger(new Table(table->size() * 2));
+			for (size_t i = 0; i < table->size(); ++i)
+			{
+				for (auto node = table->buckets[i].load(std::memory_order_relaxed); node != nullptr; node = node->next.load(std::memory_order_relaxed))
+				{
+					auto& bucket = bigger->bucket(node->hash);
+					bucket.store(new Node(node->hash, node->key, node->value, bucket.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+				}
+			}
+			replaceTable(bigger.release());
+		}
+
+		// Publishes table and retires the current one with its nodes. Every stripe is locked.
+		void replaceTable(Table* table)
+		{
+			auto old = _table.exchange(table, std::memory_order_acq_rel);
+			for (size_t i = 0; i < old->size(); ++i)
+			{
+				auto node = old->buckets[i].load(std::memory_order_relaxed);
+				while (node != nullptr)
+				{
+					auto next = node->next.load(std::memory_order_relaxed);
+					_domain.retire(node);
+					node = next;
+				}
+			}
+			_domain.retire(old);
+		}
+
+		mutable EpochDomain _domain; // Declared first: destroyed last, with the nodes still retired.
+		const size_t _stripe_count;
+		std::unique_ptr<details::HashMapStripe[]> _stripes;
+		const size_t _initial_buckets;
+		std::atomic<Table*> _table;
+		Hash _hash;
+		KeyEqual _equal;
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_CONCURRENTHASHMAP_HEADER
@@ -0,0 +1,171 @@
+#pragma once
+#ifndef THREADING_EVENTCOUNT_HEADER
+#define THREADING_EVENTCOUNT_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread/Futex.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! class EventCount
+	/**
+	 * An eventcount lets consumers park on an arbitrary condition without a
+	 * condition variable. A consumer announces that it is about to sleep with
+	 * prepareWait(), re-checks its condition and then either cancels or waits.
+	 * Producers publish their data and call notify(), which costs a single
+	 * load and no syscall when nobody has announced a wait.
+	 *
+	 * Usage (consumer):
+	 * \code
+	 * auto key = ec.prepareWait();
+	 * if (condition()) { ec.cancelWait(); }
+	 * else { ec.wait(key); }
+	 * \endcode
+	 *
+	 * Both sides issue a seq_cst fence, between announcing the wait and the
+	 * re-check and between publishing and looking for waiters, so callers may
+	 * check and publish their condition with plain acquire and release
+	 * operations: either the consumer sees the data or the producer sees the
+	 * consumer.
+	 */
+	class EventCount
+	{
+		public:
+
+		//! Token returned by prepareWait to be handed to wait.
+		using Key = uint32_t;
+
+		//! Default constructor
+		EventCount() noexcept
+			: _epoch(0)
+			, _waiters(0)
+		{}
+
+		//! Copy constructor
+		EventCount(const EventCount& other) = delete;
+		//! Copy assignment
+		EventCount& operator=(const EventCount& other) = delete;
+
+		//! prepareWait
+		/**
+		 * Announces that the calling thread is about to sleep. The condition must
+		 * be re-checked after this call and before calling wait.
+		 * \return the key to be passed to wait.
+		 */
+		Key prepareWait() noexcept
+		{
+			_waiters.fetch_add(1, std::memory_order_seq_cst);
+			// Pairs with the fence in doNotify. The caller re-checks its condition
+			// with acquire loads, which may not be ordered after a seq_cst store.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return _epoch.load(std::memory_order_seq_cst);
+		}
+
+		//! cancelWait
+		/**
+		 * Withdraws a previous prepareWait because the condition became true.
+		 */
+		void cancelWait() noexcept
+		{
+			_waiters.fetch_sub(1, std::memory_order_seq_cst);
+		}
+
+		//! wait
+		/**
+		 * Parks the calling thread until a notification newer than key arrives.
+		 * \param key the value returned by prepareWait.
+		 */
+		void wait(Key key) noexcept
+		{
+			while (_epoch.load(std::memory_order_acquire) == key)
+			{
+				details::futexWait(&_epoch, key);
+			}
+			_waiters.fetch_sub(1, std::memory_order_seq_cst);
+		}
+
+		//! waitUntil
+		/**
+		 * Parks the calling thread until a notification newer than key arrives or
+		 * the deadline passes.
+		 * \param key the value returned by prepareWait.
+		 * \param deadline the point in time at which to give up.
+		 * \return false if the deadline passed without a notification.
+		 */
+		bool waitUntil(Key key, std::chrono::steady_clock::time_point deadline) noexcept
+		{
+			bool notified = true;
+			while (_epoch.load(std::memory_order_acquire) == key)
+			{
+				auto now = std::chrono::steady_clock::now();
+				if (now >= deadline)
+				{
+					notified = false;
+					break;
+				}
+				details::futexWaitFor(&_epoch, key, deadline - now);
+			}
+			_waiters.fetch_sub(1, std::memory_order_seq_cst);
+			return notified;
+		}
+
+		//! notify
+		/**
+		 * Wakes one waiter, if any. The data the waiter is looking for must have
+		 * been published before this call.
+		 */
+		void notify() noexcept
+		{
+			doNotify(false);
+		}
+
+		//! notifyAll
+		/**
+		 * Wakes every waiter, if any.
+		 */
+		void notifyAll() noexcept
+		{
+			doNotify(true);
+		}
+
+		//! hasWaiters
+		/**
+		 * \return true if some thread has announced it is going to sleep.
+		 */
+		bool hasWaiters() const noexcept
+		{
+			return _waiters.load(std::memory_order_seq_cst) != 0;
+		}
+
+		private:
+
+		void doNotify(bool all) noexcept
+		{
+			// Pairs with the fence in prepareWait: either we see the waiter or
+			// the waiter sees whatever the producer published before notifying.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_waiters.load(std::memory_order_relaxed) == 0)
+			{
+				return;
+			}
+			_epoch.fetch_add(1, std::memory_order_seq_cst);
+			if (all)
+			{
+				details::futexWakeAll(&_epoch);
+			}
+			else
+			{
+				details::futexWake(&_epoch, 1);
+			}
+		}
+
+		// Private members.
+		std::atomic<uint32_t> _epoch;   // Bumped on every notification that finds waiters.
+		std::atomic<uint32_t> _waiters; // Number of threads between prepareWait and wait/cancelWait.
+	};
+
+}}} // rboc::utils::threading
+
+#endif // THREADING_EVENTCOUNT_HEADER
@@ -0,0 +1,425 @@
+#pragma once
+#ifndef THREADING_FORKJOIN_HEADER
+#define THREADING_FORKJOIN_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <common/Utility.h>
+#include <thread/ActiveWorker.h>
+#include <thread/Synchronization.h>
+#include <thread/TaskAllocator.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	class ForkJoin;
+	class SyncScope;
+
+	namespace details
+	{
+		//! A spawned child. It is allocated with TaskAllocator and frees itself once run.
+		struct ForkJoinJob
+		{
+			void (*invoke)(ForkJoinJob*);
+			SyncScope* scope;
+		};
+
+		template<typename F>
+		struct ForkJoinJobImpl : ForkJoinJob
+		{
+			template<typename U>
+			ForkJoinJobImpl(void (*run)(ForkJoinJob*), SyncScope* owner, U&& u)
+				: f(std::forward<U>(u))
+			{
+				invoke = run;
+				scope = owner;
+			}
+
+			F f;
+		};
+
+		//! A worker deque: the owner pushes and pops at the back (newest first),
+		//! thieves take from the front (oldest first).
+		struct ForkJoinDeque
+		{
+			ForkJoinDeque() = default;
+			ForkJoinDeque(const ForkJoinDeque&) = delete;
+			ForkJoinDeque& operator=(const ForkJoinDeque&) = delete;
+
+			void push(ForkJoinJob* job)
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				jobs.push_back(job);
+				size.store(jobs.size(), std::memory_order_release);
+			}
+
+			ForkJoinJob* pop()
+			{
+				if (size.load(std::memory_order_acquire) == 0) return nullptr;
+				std::lock_guard<std::mutex> lock(mtx);
+				if (jobs.empty()) return nullptr;
+				auto job = jobs.back();
+				jobs.pop_back();
+				size.store(jobs.size(), std::memory_order_release);
+				return job;
+			}
+
+			ForkJoinJob* steal()
+			{
+				if (size.load(std::memory_order_acquire) == 0) return nullptr;
+				std::lock_guard<std::mutex> lock(mtx);
+				if (jobs.empty()) return nullptr;
+				auto job = jobs.front();
+				jobs.pop_front();
+				size.store(jobs.size(), std::memory_order_release);
+				return job;
+			}
+
+			std::mutex mtx;
+			std::deque<ForkJoinJob*> jobs;
+			std::atomic<size_t> size{0};
+			char padding[utilities::kCacheLineSize];
+		};
+
+		//! Decrements a count whose futex word carries the waiters bit, clearing
+		//! the bit and waking the sleepers when it reaches zero. Nothing but the
+		//! futex address is touched afterwards, so a woken waiter may destroy it.
+		inline void countOut(std::atomic<uint32_t>& word) noexcept
+		{
+			auto address = &word;
+			auto old = address->load(std::memory_order_relaxed);
+			uint32_t next;
+			do
+			{
+				next = (old & ~kWaitersBit) == 1 ? 0 : old - 1;
+			}
+			while (!address->compare_exchange_weak(old, next, std::memory_order_release, std::memory_order_relaxed));
+			if (next == 0 && (old & kWaitersBit) != 0)
+			{
+				futexWakeAll(address);
+			}
+		}
+
+		//! Cheap per-thread random numbers to pick steal victims.
+		inline uint32_t nextVictimSeed() noexcept
+		{
+			static thread_local uint32_t state = static_cast<uint32_t>(
+				std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	}
+
+	//! class ForkJoin
+	/**
+	 * Work-stealing fork-join on top of a ThreadPool<void>, for recursive
+	 * divide-and-conquer code. Every pool worker gets a deque of spawned
+	 * children (see SyncScope). A worker runs its own children newest first,
+	 * depth first, which keeps the working set in its cache; idle workers
+	 * steal the oldest child of a random victim, which is usually the biggest
+	 * chunk of remaining work.
+	 *
+	 * Idle workers are recruited with helper tasks posted to the pool when
+	 * children are spawned; a helper keeps stealing until it finds no work and
+	 * then returns the worker to the pool. Threads that are not workers of the
+	 * pool share one extra deque.
+	 *
+	 * C++ cannot steal the continuation of a spawn, so children are what gets
+	 * stolen and sync() helps: while its children run elsewhere the syncing
+	 * thread runs other pending children instead of blocking. Once there is
+	 * nothing left to take it sleeps on a futex until its last child ends.
+	 *
+	 * \code
+	 * ForkJoin fj{pool};
+	 * long fib(ForkJoin& fj, int n)
+	 * {
+	 *     if (n < 20) return serialFib(n);
+	 *     long a, b;
+	 *     fj.invoke([&]{ a = fib(fj, n - 1); }, [&]{ b = fib(fj, n - 2); });
+	 *     return a + b;
+	 * }
+	 * \endcode
+	 */
+	class ForkJoin
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param pool the pool whose workers run the children. It must outlive this object.
+		 */
+		explicit ForkJoin(ThreadPool<void>& pool)
+			: _pool(pool)
+			, _size(pool.size())
+			, _deques(new details::ForkJoinDeque[pool.size() + 1])
+		{}
+
+		//! Copy constructor
+		ForkJoin(const ForkJoin& other) = delete;
+		//! Copy assignment
+		ForkJoin& operator=(const ForkJoin& other) = delete;
+
+		//! Destructor
+		/**
+		 * Waits for the helpers still looking for work to leave.
+		 */
+		~ForkJoin()
+		{
+			uint32_t helpers;
+			while (((helpers = _helpers.load(std::memory_order_acquire)) & ~details::kWaitersBit) != 0)
+			{
+				details::sleepOn(_helpers, helpers);
+			}
+		}
+
+		//! invoke
+		/**
+		 * Runs f and g in parallel: g is spawned and f runs on the calling thread.
+		 * \throw the first exception thrown by f or g.
+		 */
+		template<typename F, typename G>
+		void invoke(F&& f, G&& g);
+
+		private:
+
+		friend class SyncScope;
+
+		// Deque of the calling thread: its worker's one or the shared external one.
+		details::ForkJoinDeque& localDeque() noexcept
+		{
+			auto identity = details::currentWorkerIdentity();
+			if (identity != nullptr && identity->owner.load(std::memory_order_acquire) == &_pool)
+			{
+				return _deques[identity->index.load(std::memory_order_relaxed)];
+			}
+			return _deques[_size];
+		}
+
+		void push(details::ForkJoinJob* job)
+		{
+			localDeque().push(job);
+			recruit();
+		}
+
+		// Posts a helper if some worker may be idle.
+		void recruit()
+		{
+			auto helpers = _helpers.load(std::memory_order_relaxed);
+			while ((helpers & ~details::kWaitersBit) < _size)
+			{
+				if (_helpers.compare_exchange_weak(helpers, helpers + 1, std::memory_order_acq_rel))
+				{
+					try
+					{
+						_pool.post(std::packaged_task<void()>(std::allocator_arg, TaskAllocator<char>(), [this]{ help(); }));
+					}
+					catch (...)
+					{
+						leave();
+					}
+					return;
+				}
+			}
+		}
+
+		// Takes the newest local child or steals the oldest child of a victim.
+		details::ForkJoinJob* take()
+		{
+			auto& local = localDeque();
+			if (auto job = local.pop())
+			{
+				return job;
+			}
+			auto count = _size + 1;
+			auto start = details::nextVictimSeed() % count;
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto& victim = _deques[(start + i) % count];
+				if (&victim == &local) continue;
+				if (auto job = victim.steal())
+				{
+					return job;
+				}
+			}
+			return nullptr;
+		}
+
+		// Body of a helper task.
+		void help()
+		{
+			int idle = 0;
+			while (idle < 64)
+			{
+				if (auto job = take())
+				{
+					job->invoke(job);
+					idle = 0;
+				}
+				else
+				{
+					++idle;
+					std::this_thread::yield();
+				}
+			}
+			leave();
+		}
+
+		// Counts a helper out, waking the destructor if it sleeps.
+		void leave() noexcept
+		{
+			details::countOut(_helpers); // Last access to this.
+		}
+
+		ThreadPool<void>& _pool;
+		size_t _size;
+		std::unique_ptr<details::ForkJoinDeque[]> _deques; // One per worker plus the external one.
+		std::atomic<uint32_t> _helpers{0}; // Helper tasks posted and not finished, plus the waiters bit.
+	};
+
+	//! class SyncScope
+	/**
+	 * A fork-join frame: children spawned through it are joined by sync(),
+	 * which is also called by the destructor.
+	 *
+	 * \code
+	 * SyncScope scope{fj};
+	 * for (auto& child : node.children) scope.spawn([&child]{ aggregate(child); });
+	 * scope.sync();
+	 * \endcode
+	 */
+	class SyncScope
+	{
+		public:
+
+		//! Constructor
+		explicit SyncScope(ForkJoin& fj)
+			: _fj(fj)
+		{}
+
+		//! Copy constructor
+		SyncScope(const SyncScope& other) = delete;
+		//! Copy assignment
+		SyncScope& operator=(const SyncScope& other) = delete;
+
+		//! Destructor
+		/**
+		 * Joins the children still running. Their errors are discarded.
+		 */
+		~SyncScope()
+		{
+			join();
+		}
+
+		//! spawn
+		/**
+		 * Pushes f on the calling thread's deque, where it may be stolen.
+		 * \param f the function to be executed, taking no arguments.
+		 */
+		template<typename F>
+		void spawn(F&& f)
+		{
+			using Job = details::ForkJoinJobImpl<typename std::decay<F>::type>;
+			TaskAllocator<Job> alloc;
+			auto job = alloc.allocate(1);
+			::new (static_cast<void*>(job)) Job(&SyncScope::run<Job>, this, std::forward<F>(f));
+			_pending.fetch_add(1, std::memory_order_relaxed);
+			_fj.push(job);
+		}
+
+		//! sync
+		/**
+		 * Waits for every child spawned so far, running pending children meanwhile.
+		 * \throw the first exception thrown by a child, which is then cleared.
+		 */
+		void sync()
+		{
+			join();
+			std::exception_ptr error;
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				std::swap(error, _error);
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		private:
+
+		template<typename Job>
+		static void run(details::ForkJoinJob* base)
+		{
+			auto job = static_cast<Job*>(base);
+			auto scope = job->scope;
+			try
+			{
+				job->f();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(scope->_mtx);
+				if (!scope->_error)
+				{
+					scope->_error = std::current_exception();
+				}
+			}
+			job->~Job();
+			TaskAllocator<Job>().deallocate(job, 1);
+			details::countOut(scope->_pending); // Last access to scope.
+		}
+
+		// Runs pending children until every child of this scope has ended. A
+		// thread with nothing left to take spins a little, then sleeps.
+		void join() noexcept
+		{
+			int idle = 0;
+			uint32_t pending;
+			while (((pending = _pending.load(std::memory_order_acquire)) & ~details::kWaitersBit) != 0)
+			{
+				if (auto job = _fj.take())
+				{
+					job->invoke(job);
+					idle = 0;
+				}
+				else if (++idle > 64)
+				{
+					details::sleepOn(_pending, pending);
+				}
+				else if (idle > 16)
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		ForkJoin& _fj;
+		std::atomic<uint32_t> _pending{0}; // Children spawned and not finished, plus the waiters bit.
+		std::mutex _mtx; /*! < Protects _error. */
+		std::exception_ptr _error;
+	};
+
+	template<typename F, typename G>
+	void ForkJoin::invoke(F&& f, G&& g)
+	{
+		SyncScope scope{*this};
+		scope.spawn(std::forward<G>(g));
+		std::forward<F>(f)(); // If f throws, the scope destructor still joins g.
+		scope.sync();
+	}
+
+}}} // rboc::utils::threading
+#endif // THREADING_FORKJOIN_HEADER
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef THREADING_FUTEX_HEADER
+#define THREADING_FUTEX_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+
+#if defined(__linux__)
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <algorithm>
+#include <thread>
+#endif
+
+namespace rboc { namespace utils { namespace threading { namespace details
+{
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+		"futex words must be plain 32 bit integers");
+
+	//! futexWait
+	/**
+	 * Blocks the calling thread while *addr == expected. It may return spuriously,
+	 * so callers must always re-check their condition.
+	 * \param addr the futex word.
+	 * \param expected the value the word is expected to hold while sleeping.
+	 */
+	inline void futexWait(std::atomic<uint32_t>* addr, uint32_t expected) noexcept
+	{
+#if defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+		// Portable fallback: back off politely until the word changes.
+		if (addr->load(std::memory_order_acquire) == expected)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+#endif
+	}
+
+	//! futexWaitFor
+	/**
+	 * Same as futexWait but gives up after the relative timeout expires.
+	 * \param addr the futex word.
+	 * \param expected the value the word is expected to hold while sleeping.
+	 * \param timeout the maximum time to sleep.
+	 */
+	inline void futexWaitFor(std::atomic<uint32_t>* addr, uint32_t expected, std::chrono::nanoseconds timeout) noexcept
+	{
+		if (timeout <= std::chrono::nanoseconds::zero())
+		{
+			return;
+		}
+#if defined(__linux__)
+		struct timespec ts;
+		ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+		ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+#else
+		if (addr->load(std::memory_order_acquire) == expected)
+		{
+			std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, std::chrono::microseconds(50)));
+		}
+#endif
+	}
+
+	//! futexWake
+	/**
+	 * Wakes up to count threads blocked on addr.
+	 * \param addr the futex word.
+	 * \param count the maximum number of threads to wake.
+	 */
+	inline void futexWake(std::atomic<uint32_t>* addr, int count) noexcept
+	{
+#if defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+		(void)addr;
+		(void)count;
+#endif
+	}
+
+	//! futexWakeAll
+	/**
+	 * Wakes every thread blocked on addr.
+	 * \param addr the futex word.
+	 */
+	inline void futexWakeAll(std::atomic<uint32_t>* addr) noexcept
+	{
+		futexWake(addr, INT32_MAX);
+	}
+
+}}}} // namespace rboc::utils::threading::details
+
+#endif // THREADING_FUTEX_HEADER
@@ -0,0 +1,366 @@
+#pragma once
+#ifndef THREADING_PIPELINE_HEADER
+#define THREADING_PIPELINE_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <thread/ActiveWorker.h>
+#include <thread/Channel.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! Counters of one pipeline stage, as returned by Pipeline::stats().
+	struct StageStats
+	{
+		std::string name;
+		size_t width;        // Number of workers of the stage.
+		uint64_t items;      // Items processed so far.
+		double throughput;   // Items per second since the pipeline was built.
+		size_t queued;       // Items waiting in the input channel of the stage.
+		size_t capacity;     // Capacity of that channel.
+	};
+
+	namespace details
+	{
+		//! One stage: its workers, the futures of their loops and its counters.
+		struct PipelineStage
+		{
+			PipelineStage(std::string stage_name, size_t stage_width)
+				: name(std::move(stage_name))
+				, width(stage_width)
+				, workers(stage_width)
+				, running(stage_width)
+			{}
+
+			std::string name;
+			size_t width;
+			std::vector<ActiveWorker<void>> workers;
+			std::vector<std::future<void>> loops;
+			std::atomic<uint64_t> items{0};
+			std::atomic<size_t> running;        // Loops still running; the last one closes the output.
+			std::function<size_t()> queued;     // Size of the input channel.
+			size_t capacity = 0;
+		};
+
+		//! Owns the channels and stages of a pipeline, shared by every Pipeline handle.
+		struct PipelineCore
+		{
+			explicit PipelineCore(size_t channel_capacity)
+				: capacity(channel_capacity)
+				, start(std::chrono::steady_clock::now())
+			{}
+
+			~PipelineCore()
+			{
+				// Abort whatever is still in flight so the stage loops return, then
+				// stop the workers before the channels they use are destroyed.
+				for (auto& close : closers)
+				{
+					close();
+				}
+				stages.clear();
+			}
+
+			template<typename T>
+			Channel<T>* makeChannel()
+			{
+				auto channel = std::make_shared<Channel<T>>(capacity);
+				channels.push_back(channel);
+				closers.push_back([channel]{ channel->close(); });
+				return channel.get();
+			}
+
+			const size_t capacity;
+			const std::chrono::steady_clock::time_point start;
+			std::vector<std::shared_ptr<void>> channels;
+			std::vector<std::function<void()>> closers;
+			std::vector<std::unique_ptr<PipelineStage>> stages;
+			mutable std::mutex mtx; /*! < Protects channels, closers and stages. */
+			std::mutex wait_mtx;    /*! < Serializes wait(). */
+
+			std::vector<PipelineStage*> stageList() const
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				std::vector<PipelineStage*> result;
+				for (const auto& stage : stages)
+				{
+					result.push_back(stage.get());
+				}
+				return result;
+			}
+		};
+
+		//! Result type of a stage function taking T.
+		template<typename F, typename T>
+		struct StageResult
+		{
+			using type = typename std::decay<decltype(std::declval<F&>()(std::declval<T&&>()))>::type;
+		};
+
+		//! Moves one processed item downstream. Sinks have nowhere to send it.
+		template<typename I, typename O, typename F>
+		bool processItem(F& f, I&& item, Channel<O>* out)
+		{
+			return out->send(f(std::move(item)));
+		}
+
+		template<typename I, typename F>
+		bool processItem(F& f, I&& item, Channel<void>*)
+		{
+			f(std::move(item));
+			return true;
+		}
+
+		template<typename O>
+		void closeChannel(Channel<O>* channel) { channel->close(); }
+
+		inline void closeChannel(Channel<void>*) {}
+	}
+
+	//! class Pipeline
+	/**
+	 * A chain of stages connected by bounded channels, i.e. parse -> enrich ->
+	 * compress -> write. Every stage runs on its own ActiveWorkers: a serial
+	 * stage has one and keeps the order of the items, a parallel stage has
+	 * several and does not. Items are moved from stage to stage, never copied.
+	 *
+	 * A full channel blocks the stage feeding it, so a slow stage pushes back
+	 * all the way up to push(). close() lets the items in flight drain through
+	 * every stage; wait() then joins the stages. If a stage throws, the channels
+	 * around it are closed, the pipeline winds down and wait() rethrows.
+	 *
+	 * Items must be default constructible, as each stage receives into a local
+	 * item, and nothrow move constructible and assignable, as Channel requires.
+	 *
+	 * \code
+	 * Pipeline<std::string> pipeline{256};
+	 * auto ingest = pipeline.parallel("parse", 4, [](std::string&& line){ return parse(line); })
+	 *                       .serial("write", [&](Record&& record){ out << record; });
+	 * for (auto& line : lines) ingest.push(std::move(line));
+	 * ingest.close();
+	 * ingest.wait();
+	 * \endcode
+	 */
+	template<typename In, typename Out = In>
+	class Pipeline
+	{
+		template<typename, typename> friend class Pipeline;
+
+		public:
+
+		//! Constructor
+		/**
+		 * Builds an empty pipeline, whose output is its input until stages are added.
+		 * \param capacity the capacity of every channel of the pipeline.
+		 */
+		explicit Pipeline(size_t capacity = 1024)
+			: _core(std::make_shared<details::PipelineCore>(capacity))
+		{
+			static_assert(std::is_same<In, Out>::value, "a new pipeline starts with no stage");
+			_head = _core->template makeChannel<In>();
+			_tail = reinterpret_cast<Channel<Out>*>(_head);
+		}
+
+		//! parallel
+		/**
+		 * Adds a stage of width workers applying f to every item. Items may leave
+		 * the stage in a different order.
+		 * \param name the name of the stage in the stats.
+		 * \param width the number of workers. It must be positive.
+		 * \param f a function taking Out&& and returning the item for the next
+		 * stage, or void for a final stage.
+		 * \return a handle to the extended pipeline. Every handle refers to the same stages.
+		 */
+		template<typename F>
+		Pipeline<In, typename details::StageResult<F, Out>::type> parallel(const std::string& name, size_t width, F f)
+		{
+			using Next = typename details::StageResult<F, Out>::type;
+			if (width == 0)
+			{
+				throw std::invalid_argument("stage width must be positive");
+			}
+			std::lock_guard<std::mutex> lock(_core->mtx);
+			auto in = _tail;
+			auto out = makeOutput<Next>();
+			std::unique_ptr<details::PipelineStage> stage(new details::PipelineStage(name, width));
+			stage->queued = [in]{ return in->size(); };
+			stage->capacity = in->capacity();
+			auto raw = stage.get();
+			auto shared_f = std::make_shared<F>(std::move(f));
+			for (auto& worker : stage->workers)
+			{
+				stage->loops.emplace_back(worker.addWork([in, out, raw, shared_f]
+				{
+					runStage(*shared_f, in, out, *raw);
+				}));
+			}
+			_core->stages.push_back(std::move(stage));
+			return Pipeline<In, Next>(_core, _head, out);
+		}
+
+		//! serial
+		/**
+		 * Adds a single worker stage, which keeps the order of the items. See parallel.
+		 */
+		template<typename F>
+		Pipeline<In, typename details::StageResult<F, Out>::type> serial(const std::string& name, F f)
+		{
+			return parallel(name, 1, std::move(f));
+		}
+
+		//! push
+		/**
+		 * Feeds an item to the first stage, waiting while its channel is full.
+		 * \return false if the pipeline is closed or failed.
+		 */
+		bool push(In&& item)
+		{
+			return _head->send(std::move(item));
+		}
+
+		//! push
+		bool push(const In& item)
+		{
+			return _head->send(item);
+		}
+
+		//! pop
+		/**
+		 * Takes an item from the output of the last stage, for pipelines that do
+		 * not end in a sink.
+		 * \return false once the pipeline is closed and drained.
+		 */
+		template<typename U = Out>
+		typename std::enable_if<!std::is_void<U>::value, bool>::type pop(U& item)
+		{
+			return _tail->recv(item);
+		}
+
+		//! close
+		/**
+		 * Ends the input. Stages finish the items in flight and close in turn.
+		 */
+		void close()
+		{
+			_head->close();
+		}
+
+		//! wait
+		/**
+		 * Waits until every stage has finished.
+		 * \throw the first exception thrown by a stage.
+		 */
+		void wait()
+		{
+			std::lock_guard<std::mutex> lock(_core->wait_mtx);
+			std::exception_ptr error;
+			for (auto stage : _core->stageList())
+			{
+				for (auto& loop : stage->loops)
+				{
+					if (!loop.valid()) continue;
+					try
+					{
+						loop.get();
+					}
+					catch (...)
+					{
+						if (!error) error = std::current_exception();
+					}
+				}
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		//! stats
+		/**
+		 * \return the counters of every stage, in pipeline order.
+		 */
+		std::vector<StageStats> stats() const
+		{
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _core->start;
+			std::vector<StageStats> result;
+			for (auto stage : _core->stageList())
+			{
+				StageStats stats;
+				stats.name = stage->name;
+				stats.width = stage->width;
+				stats.items = stage->items.load(std::memory_order_relaxed);
+				stats.throughput = elapsed.count() > 0.0 ? static_cast<double>(stats.items) / elapsed.count() : 0.0;
+				stats.queued = stage->queued();
+				stats.capacity = stage->capacity;
+				result.push_back(stats);
+			}
+			return result;
+		}
+
+		private:
+
+		Pipeline(std::shared_ptr<details::PipelineCore> core, Channel<In>* head, Channel<Out>* tail)
+			: _core(std::move(core))
+			, _head(head)
+			, _tail(tail)
+		{}
+
+		template<typename Next>
+		typename std::enable_if<!std::is_void<Next>::value, Channel<Next>*>::type makeOutput()
+		{
+			return _core->template makeChannel<Next>();
+		}
+
+		template<typename Next>
+		typename std::enable_if<std::is_void<Next>::value, Channel<Next>*>::type makeOutput()
+		{
+			return nullptr;
+		}
+
+		// Loop of one stage worker.
+		template<typename F, typename Next>
+		static void runStage(F& f, Channel<Out>* in, Channel<Next>* out, details::PipelineStage& stage)
+		{
+			try
+			{
+				Out item;
+				while (in->recv(item))
+				{
+					if (!details::processItem(f, std::move(item), out))
+					{
+						in->close(); // Downstream failed: stop our producers too.
+						break;
+					}
+					stage.items.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+			catch (...)
+			{
+				in->close();
+				details::closeChannel(out);
+				throw;
+			}
+			if (stage.running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				details::closeChannel(out);
+			}
+		}
+
+		std::shared_ptr<details::PipelineCore> _core;
+		Channel<In>* _head;
+		Channel<Out>* _tail;
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_PIPELINE_HEADER
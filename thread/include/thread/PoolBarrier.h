@@ -0,0 +1,156 @@
+#pragma once
+#ifndef THREADING_POOLBARRIER_HEADER
+#define THREADING_POOLBARRIER_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <utility>
+#include <vector>
+#include <thread/BlockingRegion.h>
+#include <thread/Synchronization.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! class PoolBarrier
+	/**
+	 * A Barrier for the tasks of a phase based parallel loop on a ThreadPool.
+	 * A plain Barrier deadlocks when there are more participants than workers,
+	 * or when other tasks are queued behind a waiting participant: the tasks
+	 * that would complete the phase never get a thread. PoolBarrier waits
+	 * inside a BlockingRegion, so while a worker waits the pool runs its queue
+	 * on a compensating thread. The phase is checked before entering the
+	 * region, so the last arrival, and waiters released quickly, pay nothing
+	 * for it.
+	 *
+	 * run() starts the participants itself:
+	 * \code
+	 * PoolBarrier barrier{pool, 4, [&]{ std::swap(current, next); }};
+	 * barrier.run(steps, [&](size_t party, size_t step){ relax(current, next, party); });
+	 * \endcode
+	 */
+	class PoolBarrier
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param pool the pool the participants run on. It must outlive the barrier.
+		 * \param parties the number of participants, positive.
+		 * \param completion run by the last participant to arrive at each phase.
+		 */
+		PoolBarrier(ThreadPool<void>& pool, size_t parties, std::function<void()> completion = nullptr)
+			: _pool(pool)
+			, _parties(parties)
+			, _barrier(static_cast<std::ptrdiff_t>(parties), std::move(completion))
+		{}
+
+		//! Copy constructor
+		PoolBarrier(const PoolBarrier& other) = delete;
+		//! Copy assignment
+		PoolBarrier& operator=(const PoolBarrier& other) = delete;
+
+		//! arriveAndWait
+		/**
+		 * Arrives at the current phase and waits for it to complete, letting
+		 * the pool compensate for the calling worker meanwhile.
+		 */
+		void arriveAndWait()
+		{
+			auto token = _barrier.arrive();
+			if (_barrier.phase() == token)
+			{
+				BlockingRegion region;
+				_barrier.wait(token);
+			}
+		}
+
+		//! arriveAndDrop
+		/**
+		 * Arrives at the current phase and leaves the barrier.
+		 */
+		void arriveAndDrop()
+		{
+			_barrier.arriveAndDrop();
+		}
+
+		//! parties
+		size_t parties() const noexcept
+		{
+			return _parties;
+		}
+
+		//! run
+		/**
+		 * Runs a phase based loop: one pool task per participant, each calling
+		 * f(party, phase) for every phase and waiting at the barrier after each
+		 * call. Blocks until every participant has finished. The barrier must
+		 * not be used by other tasks meanwhile, and can run one loop only.
+		 *
+		 * If f throws, its participant drops out and the others stop after the
+		 * phase in progress; the first exception is rethrown here.
+		 * \param phases the number of phases.
+		 * \param f a function taking the participant index and the phase index.
+		 */
+		template<typename F>
+		void run(size_t phases, F f)
+		{
+			std::atomic<size_t> failed_phase{phases}; // The first phase a participant failed in.
+			std::vector<std::future<void>> participants;
+			participants.reserve(_parties);
+			for (size_t party = 0; party < _parties; ++party)
+			{
+				participants.push_back(_pool.addTask([this, &f, &failed_phase, party, phases]
+				{
+					for (size_t phase = 0; phase < phases; ++phase)
+					{
+						try
+						{
+							f(party, phase);
+						}
+						catch (...)
+						{
+							auto first = failed_phase.load(std::memory_order_relaxed);
+							while (phase < first && !failed_phase.compare_exchange_weak(first, phase, std::memory_order_relaxed))
+							{}
+							arriveAndDrop();
+							throw;
+						}
+						arriveAndWait();
+						// A failure in this phase is visible to every participant once the
+						// phase completes, so they all stop after the same phase.
+						if (failed_phase.load(std::memory_order_relaxed) <= phase) return;
+					}
+				}));
+			}
+			std::exception_ptr error;
+			BlockingRegion region;
+			for (auto& participant : participants)
+			{
+				try
+				{
+					participant.get();
+				}
+				catch (...)
+				{
+					if (!error) error = std::current_exception();
+				}
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		private:
+
+		ThreadPool<void>& _pool;
+		const size_t _parties;
+		Barrier _barrier;
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_POOLBARRIER_HEADER
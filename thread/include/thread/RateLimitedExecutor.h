@@ -0,0 +1,165 @@
+#pragma once
+#ifndef THREADING_RATELIMITEDEXECUTOR_HEADER
+#define THREADING_RATELIMITEDEXECUTOR_HEADER
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <stdexcept>
+#include <common/Utility.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! class RateLimitedExecutor
+	/**
+	 * An executor adaptor that forwards tasks to a ThreadPool at no more than a
+	 * given rate. Tasks that exceed the rate wait in the adaptor's own queue and
+	 * are released by a token bucket from a dispatcher thread, so the pool
+	 * workers never sleep waiting for tokens.
+	 */
+	template<typename R, typename... Args>
+	class RateLimitedExecutor
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param pool the pool that executes the released tasks. It must outlive the executor.
+		 * \param rate the number of tasks released per second.
+		 * \param burst the bucket capacity, i.e. how many tasks can be released back to back.
+		 */
+		RateLimitedExecutor(ThreadPool<R, Args...>& pool, double rate, size_t burst)
+			: _pool(pool)
+			, _rate(rate)
+			, _burst(static_cast<double>(burst))
+			, _tokens(static_cast<double>(burst))
+			, _last_refill(std::chrono::steady_clock::now())
+			, _running(true)
+		{
+			if (!std::isfinite(rate) || rate <= 0.0 || burst == 0)
+			{
+				throw std::invalid_argument("rate and burst must be positive");
+			}
+			_dispatcher = std::thread(&RateLimitedExecutor::dispatch, this);
+		}
+
+		//! Copy constructor
+		RateLimitedExecutor(const RateLimitedExecutor& other) = delete;
+		//! Copy assignment
+		RateLimitedExecutor& operator=(const RateLimitedExecutor& other) = delete;
+
+		//! Destructor
+		/**
+		 * Stops the dispatcher. Tasks still waiting for a token are discarded and
+		 * their futures report std::future_errc::broken_promise.
+		 */
+		~RateLimitedExecutor()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				_running = false;
+			}
+			_cond.notify_one();
+			_dispatcher.join();
+		}
+
+		//! addTask.
+		/**
+		 * Queues a task to be released to the pool when a token is available.
+		 * \param f the function to be executed.
+		 * \param Args... the arguments to be passed to the function f.
+		 */
+		template<typename F>
+		std::future<R> addTask(F&& f, Args... args)
+		{
+			std::packaged_task<R(Args...)> task{std::forward<F>(f)};
+			auto result = task.get_future();
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				_queue.emplace_back(std::make_pair(std::move(task), std::make_tuple(args...)));
+			}
+			_cond.notify_one();
+			return result;
+		}
+
+		//! pending
+		/**
+		 * \return the number of tasks waiting for a token.
+		 */
+		size_t pending() const
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			return _queue.size();
+		}
+
+		private:
+
+		// A queued task.
+		using Task = std::pair<std::packaged_task<R(Args...)>, std::tuple<Args...>>;
+
+		static constexpr double kMaxWaitSeconds = 3600.0; // The dispatcher re-checks the bucket at least this often.
+
+		// private functions.
+		void dispatch()
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			while (true)
+			{
+				_cond.wait(lock, [this]{ return !_queue.empty() || !_running; });
+				if (!_running) break;
+
+				refill();
+				if (_tokens < 1.0)
+				{
+					// Sleep until the next token is due; new submissions do not change that.
+					// Clamped, so tiny rates cannot overflow steady_clock::duration.
+					auto seconds = std::min((1.0 - _tokens) / _rate, kMaxWaitSeconds);
+					_cond.wait_for(lock, std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)),
+						[this]{ return !_running; });
+					continue;
+				}
+				_tokens -= 1.0;
+				auto task = std::move(_queue.front());
+				_queue.pop_front();
+				lock.unlock();
+				release(std::move(task), typename utilities::GenerateSequence<sizeof...(Args)>::type{});
+				lock.lock();
+			}
+		}
+
+		void refill()
+		{
+			auto now = std::chrono::steady_clock::now();
+			std::chrono::duration<double> elapsed = now - _last_refill;
+			_last_refill = now;
+			_tokens = std::min(_burst, _tokens + elapsed.count() * _rate);
+		}
+
+		template<std::size_t... Seq>
+		void release(Task&& task, utilities::IndexSequence<Seq...>)
+		{
+			_pool.post(std::move(task.first), std::get<Seq>(std::move(task.second))...);
+		}
+
+		// Private members.
+		ThreadPool<R, Args...>& _pool;
+		const double _rate;  // Tokens added per second.
+		const double _burst; // Bucket capacity.
+		double _tokens;
+		std::chrono::steady_clock::time_point _last_refill;
+		bool _running;
+		std::deque<Task> _queue;
+		mutable std::mutex _mtx; // Mutex to protect the queue, the bucket and running bool.
+		std::condition_variable _cond;
+		std::thread _dispatcher;
+	};
+
+	template<typename R, typename... Args>
+	constexpr double RateLimitedExecutor<R, Args...>::kMaxWaitSeconds;
+
+}}} // rboc::utils::threading
+
+#endif // THREADING_RATELIMITEDEXECUTOR_HEADER
@@ -0,0 +1,637 @@
+#pragma once
+#ifndef THREADING_REACTOR_HEADER
+#define THREADING_REACTOR_HEADER
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <thread/ThreadOptions.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! class EventFd
+	/**
+	 * A non blocking Linux eventfd: a counter other threads signal and a
+	 * Reactor can watch like any file descriptor, i.e. to hand work to
+	 * reactor driven code.
+	 */
+	class EventFd
+	{
+		public:
+
+		//! Constructor
+		EventFd()
+			: _fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+		{
+			if (_fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "eventfd");
+			}
+		}
+
+		//! Destructor
+		~EventFd()
+		{
+			::close(_fd);
+		}
+
+		//! Copy constructor
+		EventFd(const EventFd& other) = delete;
+		//! Copy assignment
+		EventFd& operator=(const EventFd& other) = delete;
+
+		//! signal
+		/**
+		 * Adds n to the counter, making the eventfd readable.
+		 */
+		void signal(uint64_t n = 1) noexcept
+		{
+			while (::write(_fd, &n, sizeof(n)) < 0 && errno == EINTR)
+			{}
+		}
+
+		//! consume
+		/**
+		 * Reads and resets the counter.
+		 * \return the sum of the signals since the last consume, 0 if none.
+		 */
+		uint64_t consume() noexcept
+		{
+			uint64_t value = 0;
+			while (::read(_fd, &value, sizeof(value)) < 0)
+			{
+				if (errno != EINTR) return 0;
+			}
+			return value;
+		}
+
+		//! fd
+		int fd() const noexcept
+		{
+			return _fd;
+		}
+
+		private:
+
+		int _fd;
+	};
+
+	namespace details
+	{
+		inline std::system_error ioError(const char* what)
+		{
+			return std::system_error(errno, std::generic_category(), what);
+		}
+
+		inline std::exception_ptr ioCancelled()
+		{
+			return std::make_exception_ptr(std::system_error(ECANCELED, std::generic_category(), "watch removed"));
+		}
+
+		//! A watch on a file descriptor.
+		struct IoWatch
+		{
+			uint64_t id = 0;
+			int fd = -1;
+			uint32_t events = 0;
+			bool persistent = false;             // Re-armed after each callback until unwatched.
+			bool on_pool = true;                 // The callback is posted to the pool, not run by the reactor thread.
+			bool armed = true;                   // Protected by the state mutex, like removed.
+			bool removed = false;
+			std::function<void(uint32_t)> callback;
+			std::function<void()> cancel;        // Fails the future of a one-shot watch that never fired.
+		};
+
+		//! Completes a promise with the result of a continuation.
+		template<typename R>
+		struct ContinuationRunner
+		{
+			template<typename F>
+			static void run(std::promise<R>& promise, F& f, uint32_t events)
+			{
+				promise.set_value(f(events));
+			}
+		};
+
+		template<>
+		struct ContinuationRunner<void>
+		{
+			template<typename F>
+			static void run(std::promise<void>& promise, F& f, uint32_t events)
+			{
+				f(events);
+				promise.set_value();
+			}
+		};
+
+		//! class ReactorState
+		/**
+		 * The epoll instance and the watches of a Reactor, shared with the
+		 * callbacks in flight on the pool so that re-arming after the reactor
+		 * is gone is harmless.
+		 */
+		class ReactorState
+		{
+			public:
+
+			ReactorState()
+				: _epoll(::epoll_create1(EPOLL_CLOEXEC))
+			{
+				if (_epoll < 0)
+				{
+					throw ioError("epoll_create1");
+				}
+				epoll_event event{};
+				event.events = EPOLLIN;
+				event.data.fd = _wake.fd();
+				if (::epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake.fd(), &event) != 0)
+				{
+					auto error = ioError("epoll_ctl");
+					::close(_epoll);
+					throw error;
+				}
+			}
+
+			~ReactorState()
+			{
+				::close(_epoll);
+			}
+
+			ReactorState(const ReactorState& other) = delete;
+			ReactorState& operator=(const ReactorState& other) = delete;
+
+			//! Registers a watch. Throws std::system_error if epoll rejects the fd.
+			uint64_t add(std::shared_ptr<IoWatch> watch)
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				watch->id = ++_last_id;
+				auto& entry = _fds[watch->fd];
+				entry.watches.push_back(watch);
+				try
+				{
+					updateInterest(watch->fd, entry);
+				}
+				catch (...)
+				{
+					entry.watches.pop_back();
+					if (entry.watches.empty()) _fds.erase(watch->fd);
+					throw;
+				}
+				_watches.emplace(watch->id, watch);
+				return watch->id;
+			}
+
+			//! Removes a watch. A callback already dispatched still runs.
+			bool remove(uint64_t id)
+			{
+				std::shared_ptr<IoWatch> watch;
+				{
+					std::lock_guard<std::mutex> lock(_mtx);
+					auto found = _watches.find(id);
+					if (found == _watches.end()) return false;
+					watch = found->second;
+					detach(watch);
+				}
+				if (watch->cancel) watch->cancel();
+				return true;
+			}
+
+			//! Removes every watch of fd.
+			size_t removeAll(int fd)
+			{
+				std::vector<std::shared_ptr<IoWatch>> removed;
+				{
+					std::lock_guard<std::mutex> lock(_mtx);
+					auto found = _fds.find(fd);
+					if (found == _fds.end()) return 0;
+					removed = found->second.watches;
+					for (const auto& watch : removed)
+					{
+						detach(watch);
+					}
+				}
+				for (const auto& watch : removed)
+				{
+					if (watch->cancel) watch->cancel();
+				}
+				return removed.size();
+			}
+
+			//! Removes every watch, failing the futures that never completed.
+			void cancelAll()
+			{
+				std::unordered_map<uint64_t, std::shared_ptr<IoWatch>> watches;
+				{
+					std::lock_guard<std::mutex> lock(_mtx);
+					for (const auto& fd : _fds)
+					{
+						if (fd.second.registered != 0) ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd.first, nullptr);
+					}
+					_fds.clear();
+					watches.swap(_watches);
+					for (const auto& watch : watches)
+					{
+						watch.second->removed = true;
+					}
+				}
+				for (const auto& watch : watches)
+				{
+					if (watch.second->cancel) watch.second->cancel();
+				}
+			}
+
+			//! Watches fd again once the callback of a persistent watch returned.
+			void rearm(const std::shared_ptr<IoWatch>& watch) noexcept
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				if (watch->removed) return;
+				watch->armed = true;
+				auto found = _fds.find(watch->fd);
+				try
+				{
+					updateInterest(watch->fd, found->second);
+				}
+				catch (...) // The fd was closed without unwatching it.
+				{
+					detach(watch);
+				}
+			}
+
+			//! Disarms the watches fd is ready for and drops the one-shot ones.
+			void collect(int fd, uint32_t ready, std::vector<std::pair<std::shared_ptr<IoWatch>, uint32_t>>& out)
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				auto found = _fds.find(fd);
+				if (found == _fds.end()) return;
+				auto start = out.size();
+				for (const auto& watch : found->second.watches)
+				{
+					if (watch->armed && (ready & (watch->events | EPOLLERR | EPOLLHUP)) != 0)
+					{
+						watch->armed = false;
+						out.emplace_back(watch, ready);
+					}
+				}
+				for (auto i = start; i < out.size(); ++i)
+				{
+					if (!out[i].first->persistent) detach(out[i].first);
+				}
+				found = _fds.find(fd);
+				if (found != _fds.end())
+				{
+					try
+					{
+						updateInterest(fd, found->second);
+					}
+					catch (...)
+					{}
+				}
+			}
+
+			int epoll() const noexcept
+			{
+				return _epoll;
+			}
+
+			EventFd& wake() noexcept
+			{
+				return _wake;
+			}
+
+			size_t size() const
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				return _watches.size();
+			}
+
+			private:
+
+			struct FdEntry
+			{
+				std::vector<std::shared_ptr<IoWatch>> watches;
+				uint32_t registered = 0; // The events epoll watches for this fd.
+			};
+
+			// Removes a watch from the tables. Called with _mtx held.
+			void detach(const std::shared_ptr<IoWatch>& watch)
+			{
+				watch->removed = true;
+				_watches.erase(watch->id);
+				auto found = _fds.find(watch->fd);
+				if (found == _fds.end()) return;
+				auto& watches = found->second.watches;
+				for (auto it = watches.begin(); it != watches.end(); ++it)
+				{
+					if (*it == watch)
+					{
+						watches.erase(it);
+						break;
+					}
+				}
+				try
+				{
+					updateInterest(watch->fd, found->second);
+				}
+				catch (...)
+				{}
+				if (watches.empty()) _fds.erase(found);
+			}
+
+			// Makes epoll watch fd for the events of its armed watches. Called with _mtx held.
+			void updateInterest(int fd, FdEntry& entry)
+			{
+				uint32_t wanted = 0;
+				for (const auto& watch : entry.watches)
+				{
+					if (watch->armed) wanted |= watch->events;
+				}
+				if (wanted == entry.registered) return;
+				epoll_event event{};
+				event.events = wanted;
+				event.data.fd = fd;
+				int op = entry.registered == 0 ? EPOLL_CTL_ADD : (wanted == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD);
+				int result = ::epoll_ctl(_epoll, op, fd, &event);
+				if (result != 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+				{
+					result = ::epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event); // Closed and reused since.
+				}
+				if (result != 0 && op == EPOLL_CTL_DEL)
+				{
+					result = 0; // Closing the fd already took it out of epoll.
+				}
+				if (result != 0)
+				{
+					throw ioError("epoll_ctl");
+				}
+				entry.registered = wanted;
+			}
+
+			int _epoll;
+			EventFd _wake;                     // Wakes the reactor thread to stop.
+			mutable std::mutex _mtx;           // Protects the tables below and the armed and removed flags.
+			uint64_t _last_id = 0;
+			std::unordered_map<int, FdEntry> _fds;
+			std::unordered_map<uint64_t, std::shared_ptr<IoWatch>> _watches;
+		};
+	}
+
+	//! class Reactor
+	/**
+	 * Waits for file descriptors to become ready so that pool workers do not
+	 * block in read() or write(). A dedicated thread, named "reactor", waits
+	 * in epoll_wait and dispatches readiness onto a ThreadPool as tasks:
+	 *
+	 * - whenReady(fd, events) returns a future completed, by the reactor
+	 *   thread, with the events that fired.
+	 * - whenReady(fd, events, f) runs f(events) on the pool and returns its future.
+	 * - watch(fd, events, f) runs f(events) on the pool every time fd is ready,
+	 *   until unwatched. f never runs concurrently with itself: fd is watched
+	 *   again only once f returned, so level triggered readiness does not
+	 *   flood the pool while f drains it.
+	 *
+	 * Watches are level triggered and non blocking fds are expected. Errors
+	 * and hang-ups complete every watch of the fd. Unwatch an fd before
+	 * closing it. Futures of watches removed before firing, including those
+	 * pending when the reactor is destroyed, throw std::system_error with
+	 * ECANCELED. The pool must outlive the reactor.
+	 *
+	 * \code
+	 * ThreadPool<void> pool{4};
+	 * Reactor reactor{pool};
+	 * auto bytes = reactor.whenReady(socket, Reactor::readable, [&](uint32_t){ return ::read(socket, buffer, size); });
+	 * \endcode
+	 */
+	class Reactor
+	{
+		public:
+
+		//! Readiness events, to be combined with |.
+		enum Events : uint32_t
+		{
+			readable = EPOLLIN,   /*! < Data to read, or the peer closed its end. */
+			writable = EPOLLOUT,  /*! < Room to write. */
+			priority = EPOLLPRI,  /*! < Out of band data. */
+			error = EPOLLERR,     /*! < Always reported. */
+			hangup = EPOLLHUP     /*! < Always reported. */
+		};
+
+		//! Identifies a persistent watch. See watch and unwatch.
+		using WatchId = uint64_t;
+
+		//! Constructor
+		/**
+		 * Starts the reactor thread.
+		 * \param pool the pool the callbacks run on.
+		 */
+		explicit Reactor(ThreadPool<void>& pool)
+			: _pool(pool)
+			, _state(std::make_shared<details::ReactorState>())
+			, _running(true)
+			, _thread(&Reactor::run, this)
+		{}
+
+		//! Destructor
+		/**
+		 * Stops the reactor thread and cancels the pending watches. Callbacks
+		 * already dispatched to the pool still run.
+		 */
+		~Reactor()
+		{
+			_running.store(false, std::memory_order_release);
+			_state->wake().signal();
+			_thread.join();
+			_state->cancelAll();
+		}
+
+		//! Copy constructor
+		Reactor(const Reactor& other) = delete;
+		//! Copy assignment
+		Reactor& operator=(const Reactor& other) = delete;
+
+		//! whenReady
+		/**
+		 * \param fd the file descriptor, which epoll must support (not a regular file).
+		 * \param events the events to wait for, i.e. readable.
+		 * \return a future with the events that fired.
+		 * \throws std::system_error if epoll rejects fd.
+		 */
+		std::future<uint32_t> whenReady(int fd, uint32_t events)
+		{
+			auto promise = std::make_shared<std::promise<uint32_t>>();
+			auto watch = std::make_shared<details::IoWatch>();
+			watch->fd = fd;
+			watch->events = events;
+			watch->on_pool = false; // Setting a promise is cheaper than a pool task.
+			watch->callback = [promise](uint32_t ready){ promise->set_value(ready); };
+			watch->cancel = [promise]{ promise->set_exception(details::ioCancelled()); };
+			auto result = promise->get_future();
+			_state->add(std::move(watch));
+			return result;
+		}
+
+		//! whenReady
+		/**
+		 * Runs a continuation on the pool once fd is ready.
+		 * \param fd the file descriptor.
+		 * \param events the events to wait for.
+		 * \param f called with the events that fired.
+		 * \return the future of f.
+		 */
+		template<typename F, typename R = typename std::result_of<F(uint32_t)>::type>
+		std::future<R> whenReady(int fd, uint32_t events, F&& f)
+		{
+			auto promise = std::make_shared<std::promise<R>>();
+			auto continuation = std::make_shared<typename std::decay<F>::type>(std::forward<F>(f));
+			auto watch = std::make_shared<details::IoWatch>();
+			watch->fd = fd;
+			watch->events = events;
+			watch->callback = [promise, continuation](uint32_t ready)
+			{
+				try
+				{
+					details::ContinuationRunner<R>::run(*promise, *continuation, ready);
+				}
+				catch (...)
+				{
+					promise->set_exception(std::current_exception());
+				}
+			};
+			watch->cancel = [promise]{ promise->set_exception(details::ioCancelled()); };
+			auto result = promise->get_future();
+			_state->add(std::move(watch));
+			return result;
+		}
+
+		//! watch
+		/**
+		 * Runs f on the pool every time fd is ready, one call at a time.
+		 * \param fd the file descriptor.
+		 * \param events the events to wait for.
+		 * \param f called with the events that fired.
+		 * \return the id to pass to unwatch.
+		 */
+		WatchId watch(int fd, uint32_t events, std::function<void(uint32_t)> f)
+		{
+			auto watch = std::make_shared<details::IoWatch>();
+			watch->fd = fd;
+			watch->events = events;
+			watch->persistent = true;
+			watch->callback = std::move(f);
+			return _state->add(std::move(watch));
+		}
+
+		//! unwatch
+		/**
+		 * Stops a persistent watch. A callback already dispatched still runs.
+		 * \return false if id is not watched.
+		 */
+		bool unwatch(WatchId id)
+		{
+			return _state->remove(id);
+		}
+
+		//! unwatchAll
+		/**
+		 * Removes every watch of fd, i.e. before closing it. Pending futures
+		 * throw std::system_error with ECANCELED.
+		 * \return the number of watches removed.
+		 */
+		size_t unwatchAll(int fd)
+		{
+			return _state->removeAll(fd);
+		}
+
+		//! size
+		/**
+		 * \return the number of watches waiting, persistent ones included.
+		 */
+		size_t size() const
+		{
+			return _state->size();
+		}
+
+		private:
+
+		void run()
+		{
+			ThreadOptions options;
+			options.name = "reactor";
+			details::applyThreadOptions(options);
+			epoll_event events[64];
+			std::vector<std::pair<std::shared_ptr<details::IoWatch>, uint32_t>> ready;
+			while (_running.load(std::memory_order_acquire))
+			{
+				int count = ::epoll_wait(_state->epoll(), events, 64, -1); // EINTR returns -1: just loop.
+				for (int i = 0; i < count; ++i)
+				{
+					if (events[i].data.fd == _state->wake().fd())
+					{
+						_state->wake().consume();
+						continue;
+					}
+					_state->collect(events[i].data.fd, events[i].events, ready);
+				}
+				for (auto& entry : ready)
+				{
+					dispatch(std::move(entry.first), entry.second);
+				}
+				ready.clear();
+			}
+		}
+
+		// Runs the callback of a ready watch, on the pool unless it completes a plain future.
+		void dispatch(std::shared_ptr<details::IoWatch> watch, uint32_t ready)
+		{
+			if (!watch->on_pool)
+			{
+				watch->callback(ready);
+				return;
+			}
+			auto state = _state;
+			_pool.addTask([state, watch, ready]
+			{
+				if (!watch->persistent)
+				{
+					watch->callback(ready);
+					return;
+				}
+				try
+				{
+					watch->callback(ready);
+				}
+				catch (...)
+				{
+					state->rearm(watch); // A failing callback keeps watching.
+					throw;
+				}
+				state->rearm(watch);
+			});
+		}
+
+		ThreadPool<void>& _pool;
+		std::shared_ptr<details::ReactorState> _state;
+		std::atomic<bool> _running;
+		std::thread _thread;                  // Last: started once the members it uses are built.
+	};
+
+}}} // rboc::utils::threading
+
+#endif // __linux__
+#endif // THREADING_REACTOR_HEADER
@@ -0,0 +1,862 @@
+#pragma once
+#ifndef THREADING_RECLAMATION_HEADER
+#define THREADING_RECLAMATION_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <common/Utility.h>
+#include <thread/ActiveWorker.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! An object unlinked from a concurrent structure, waiting to be destroyed.
+		struct Retired
+		{
+			void* ptr;
+			void (*deleter)(void*);
+		};
+
+		template<typename T>
+		void deleteRetired(void* ptr)
+		{
+			delete static_cast<T*>(ptr);
+		}
+
+		inline void reclaimAll(std::vector<Retired>& retired) noexcept
+		{
+			for (auto& item : retired)
+			{
+				item.deleter(item.ptr);
+			}
+			retired.clear();
+		}
+
+		//! class ThreadRecords
+		/**
+		 * The records the calling thread owns in the domains of one kind. A thread
+		 * gets a record the first time it uses a domain and gives it back when it
+		 * exits; until then it keeps the domain state alive, so a domain may be
+		 * destroyed while other threads still hold a record in it. Records of
+		 * closed domains are given back on the next miss.
+		 * \tparam State the domain state, with a Record type, acquire(), release(Record*) and closed().
+		 */
+		template<typename State>
+		class ThreadRecords
+		{
+			public:
+
+			using Record = typename State::Record;
+
+			ThreadRecords() = default;
+			ThreadRecords(const ThreadRecords&) = delete;
+			ThreadRecords& operator=(const ThreadRecords&) = delete;
+
+			~ThreadRecords()
+			{
+				for (auto& entry : _entries)
+				{
+					entry.first->release(entry.second);
+				}
+			}
+
+			Record& get(const std::shared_ptr<State>& state)
+			{
+				if (state.get() == _last_state)
+				{
+					return *_last_record;
+				}
+				auto found = std::find_if(_entries.begin(), _entries.end(),
+					[&state](const Entry& entry){ return entry.first == state; });
+				Record* record;
+				if (found != _entries.end())
+				{
+					record = found->second;
+				}
+				else
+				{
+					prune();
+					record = state->acquire();
+					_entries.emplace_back(state, record);
+				}
+				_last_state = state.get();
+				_last_record = record;
+				return *record;
+			}
+
+			//! Gives back the record the calling thread holds in state, if any.
+			void drop(const State* state)
+			{
+				auto found = std::find_if(_entries.begin(), _entries.end(),
+					[state](const Entry& entry){ return entry.first.get() == state; });
+				if (found != _entries.end())
+				{
+					found->first->release(found->second);
+					_entries.erase(found);
+				}
+				_last_state = nullptr;
+			}
+
+			private:
+
+			using Entry = std::pair<std::shared_ptr<State>, Record*>;
+
+			// Gives back the records of closed domains so their state can go.
+			void prune()
+			{
+				for (auto it = _entries.begin(); it != _entries.end();)
+				{
+					if (it->first->closed())
+					{
+						it->first->release(it->second);
+						it = _entries.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+				_last_state = nullptr;
+			}
+
+			std::vector<Entry> _entries;
+			const State* _last_state = nullptr; // One entry cache for the common single domain case.
+			Record* _last_record = nullptr;
+		};
+
+		template<typename State>
+		ThreadRecords<State>& threadRecords()
+		{
+			static thread_local ThreadRecords<State> records;
+			return records;
+		}
+
+		//! Objects retired before the global epoch was sealed_epoch.
+		struct EpochBag
+		{
+			uint64_t sealed_epoch;
+			std::vector<Retired> items;
+		};
+
+		//! The shared part of an EpochDomain: the global epoch and one record per thread.
+		struct EpochState
+		{
+			//! A thread's view of the domain. Only the owner thread touches nesting and
+			//! bag; limbo is shared with the domain destructor.
+			struct Record final : TaskBoundaryHook
+			{
+				explicit Record(EpochState& owner)
+					: state(owner)
+				{}
+
+				void onTaskBoundary() noexcept override
+				{
+					state.boundary(*this);
+				}
+
+				std::atomic<uint64_t> epoch{0};  // (epoch << 1) | 1 while pinned, 0 otherwise.
+				std::atomic<bool> in_use{true};
+				std::atomic<size_t> sealed{0};   // Number of bags in limbo.
+				unsigned nesting = 0;
+				std::vector<Retired> bag;        // Retired objects not sealed yet.
+				std::mutex mtx;                  // Protects limbo.
+				std::deque<EpochBag> limbo;      // Sealed bags, oldest first.
+				EpochState& state;
+				Record* next = nullptr;
+				char padding[utilities::kCacheLineSize];
+			};
+
+			explicit EpochState(size_t batch)
+				: batch_size(batch)
+			{}
+
+			EpochState(const EpochState&) = delete;
+			EpochState& operator=(const EpochState&) = delete;
+
+			~EpochState()
+			{
+				auto record = records.load(std::memory_order_acquire);
+				while (record != nullptr)
+				{
+					auto next = record->next;
+					reclaimAll(record->bag);
+					for (auto& bag : record->limbo)
+					{
+						reclaimAll(bag.items);
+					}
+					delete record;
+					record = next;
+				}
+			}
+
+			// Claims a free record or adds a new one for the calling thread.
+			Record* acquire()
+			{
+				for (auto record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+				{
+					bool expected = false;
+					if (!record->in_use.load(std::memory_order_relaxed)
+						&& record->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					{
+						addTaskBoundaryHook(record);
+						return record;
+					}
+				}
+				auto record = new Record(*this);
+				record->bag.reserve(batch_size);
+				record->next = records.load(std::memory_order_relaxed);
+				while (!records.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed))
+				{}
+				addTaskBoundaryHook(record);
+				return record;
+			}
+
+			// Called on the owner thread when it exits or drops the domain. The bags
+			// left behind are reclaimed by the next owner of the record.
+			void release(Record* record) noexcept
+			{
+				removeTaskBoundaryHook(record);
+				seal(*record);
+				if (!closed())
+				{
+					tryAdvance();
+				}
+				collect(*record);
+				record->in_use.store(false, std::memory_order_release);
+			}
+
+			bool closed() const noexcept
+			{
+				return is_closed.load(std::memory_order_acquire);
+			}
+
+			// Reclaims every sealed bag. The domain is gone, so no reader is left.
+			void close() noexcept
+			{
+				is_closed.store(true, std::memory_order_seq_cst);
+				for (auto record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+				{
+					std::deque<EpochBag> limbo;
+					{
+						std::lock_guard<std::mutex> lock(record->mtx);
+						limbo.swap(record->limbo);
+						record->sealed.store(0, std::memory_order_relaxed);
+					}
+					for (auto& bag : limbo)
+					{
+						reclaimAll(bag.items);
+					}
+				}
+			}
+
+			void pin(Record& record) noexcept
+			{
+				if (record.nesting++ != 0) return;
+				auto current = epoch.load(std::memory_order_relaxed);
+				record.epoch.store((current << 1) | 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+
+			void unpin(Record& record) noexcept
+			{
+				if (--record.nesting == 0)
+				{
+					record.epoch.store(0, std::memory_order_release);
+				}
+			}
+
+			void retire(Record& record, Retired item)
+			{
+				record.bag.push_back(item);
+				if (record.bag.size() >= batch_size)
+				{
+					seal(record);
+					tryAdvance();
+					collect(record);
+				}
+			}
+
+			// Moves the pending objects to limbo, tagged with the current epoch.
+			void seal(Record& record)
+			{
+				if (record.bag.empty()) return;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				EpochBag sealed_bag{epoch.load(std::memory_order_relaxed), std::move(record.bag)};
+				record.bag = std::vector<Retired>();
+				{
+					std::lock_guard<std::mutex> lock(record.mtx);
+					record.limbo.push_back(std::move(sealed_bag));
+					record.sealed.store(record.limbo.size(), std::memory_order_relaxed);
+				}
+				record.bag.reserve(batch_size);
+			}
+
+			// Moves the global epoch forward if every pinned thread has seen it.
+			bool tryAdvance() noexcept
+			{
+				auto current = epoch.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				for (auto record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+				{
+					auto local = record->epoch.load(std::memory_order_acquire); // Pairs with unpin.
+					if ((local & 1) != 0 && (local >> 1) != current)
+					{
+						return false;
+					}
+				}
+				return epoch.compare_exchange_strong(current, current + 1, std::memory_order_release, std::memory_order_relaxed);
+			}
+
+			// Reclaims the bags sealed two epochs ago or earlier, every bag once the
+			// domain is closed. Deleters run without the lock, so they may retire.
+			void collect(Record& record) noexcept
+			{
+				std::deque<EpochBag> ready;
+				{
+					std::lock_guard<std::mutex> lock(record.mtx);
+					if (closed())
+					{
+						ready.swap(record.limbo);
+					}
+					else
+					{
+						auto current = epoch.load(std::memory_order_acquire);
+						while (!record.limbo.empty() && record.limbo.front().sealed_epoch + 2 <= current)
+						{
+							ready.push_back(std::move(record.limbo.front()));
+							record.limbo.pop_front();
+						}
+					}
+					record.sealed.store(record.limbo.size(), std::memory_order_relaxed);
+				}
+				for (auto& bag : ready)
+				{
+					reclaimAll(bag.items);
+				}
+			}
+
+			// Between two tasks the owner is not pinned: seal what it retired, help
+			// the epoch along and reclaim what has become safe.
+			void boundary(Record& record) noexcept
+			{
+				if (record.nesting != 0) return;
+				auto sealed_bags = record.sealed.load(std::memory_order_relaxed);
+				if (record.bag.empty() && sealed_bags == 0) return;
+				if (closed())
+				{
+					reclaimAll(record.bag);
+					collect(record);
+					removeTaskBoundaryHook(&record);
+					return;
+				}
+				if (sealed_bags == 0)
+				{
+					seal(record); // A partial bag, only when nothing older is waiting.
+				}
+				tryAdvance();
+				collect(record);
+			}
+
+			std::atomic<uint64_t> epoch{0};
+			char padding[utilities::kCacheLineSize]; // Keeps the epoch off the record list.
+			std::atomic<Record*> records{nullptr};
+			std::atomic<bool> is_closed{false};
+			const size_t batch_size;
+		};
+
+		//! The shared part of a HazardDomain: the hazard slots and one record per thread.
+		struct HazardState
+		{
+			//! One hazard pointer. Slots are never freed before the domain.
+			struct Slot
+			{
+				std::atomic<const void*> ptr{nullptr};
+				std::atomic<bool> in_use{true};
+				Slot* next = nullptr;
+				char padding[utilities::kCacheLineSize];
+			};
+
+			//! The objects a thread retired and has not reclaimed yet.
+			struct Record
+			{
+				std::atomic<bool> in_use{true};
+				std::vector<Retired> bag;
+				Record* next = nullptr;
+			};
+
+			explicit HazardState(size_t batch)
+				: batch_size(batch)
+			{}
+
+			HazardState(const HazardState&) = delete;
+			HazardState& operator=(const HazardState&) = delete;
+
+			~HazardState()
+			{
+				reclaimAll(orphans);
+				auto record = records.load(std::memory_order_acquire);
+				while (record != nullptr)
+				{
+					auto next = record->next;
+					reclaimAll(record->bag);
+					delete record;
+					record = next;
+				}
+				auto slot = slots.load(std::memory_order_acquire);
+				while (slot != nullptr)
+				{
+					auto next = slot->next;
+					delete slot;
+					slot = next;
+				}
+			}
+
+			Slot* acquireSlot()
+			{
+				for (auto slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+				{
+					bool expected = false;
+					if (!slot->in_use.load(std::memory_order_relaxed)
+						&& slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					{
+						return slot;
+					}
+				}
+				auto slot = new Slot();
+				slot->next = slots.load(std::memory_order_relaxed);
+				while (!slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+				{}
+				slot_count.fetch_add(1, std::memory_order_relaxed);
+				return slot;
+			}
+
+			void releaseSlot(Slot* slot) noexcept
+			{
+				slot->ptr.store(nullptr, std::memory_order_release);
+				slot->in_use.store(false, std::memory_order_release);
+			}
+
+			Record* acquire()
+			{
+				for (auto record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+				{
+					bool expected = false;
+					if (!record->in_use.load(std::memory_order_relaxed)
+						&& record->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					{
+						return record;
+					}
+				}
+				auto record = new Record();
+				record->next = records.load(std::memory_order_relaxed);
+				while (!records.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed))
+				{}
+				return record;
+			}
+
+			// Called on the owner thread when it exits or drops the domain. What is
+			// still protected is handed to the next scan of any thread.
+			void release(Record* record) noexcept
+			{
+				scan(*record);
+				if (!record->bag.empty())
+				{
+					std::lock_guard<std::mutex> lock(orphans_mtx);
+					if (!is_closed.load(std::memory_order_acquire))
+					{
+						orphans.insert(orphans.end(), record->bag.begin(), record->bag.end());
+						record->bag.clear();
+					}
+				}
+				reclaimAll(record->bag); // Only left when the domain is closed.
+				record->in_use.store(false, std::memory_order_release);
+			}
+
+			bool closed() const noexcept
+			{
+				return is_closed.load(std::memory_order_acquire);
+			}
+
+			// Reclaims the orphans. The domain is gone, so no hazard is left.
+			void close() noexcept
+			{
+				std::vector<Retired> adopted;
+				{
+					std::lock_guard<std::mutex> lock(orphans_mtx);
+					is_closed.store(true, std::memory_order_seq_cst);
+					adopted.swap(orphans);
+				}
+				reclaimAll(adopted);
+			}
+
+			void retire(Record& record, Retired item)
+			{
+				record.bag.push_back(item);
+				if (record.bag.size() >= std::max(batch_size, 2 * slot_count.load(std::memory_order_relaxed)))
+				{
+					scan(record);
+				}
+			}
+
+			// Reclaims the retired objects no hazard pointer protects.
+			void scan(Record& record) noexcept
+			{
+				if (closed())
+				{
+					reclaimAll(record.bag);
+					return;
+				}
+				std::vector<Retired> candidates;
+				candidates.swap(record.bag);
+				{
+					std::lock_guard<std::mutex> lock(orphans_mtx);
+					candidates.insert(candidates.end(), orphans.begin(), orphans.end());
+					orphans.clear();
+				}
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				std::vector<const void*> hazards;
+				for (auto slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+				{
+					auto ptr = slot->ptr.load(std::memory_order_acquire);
+					if (ptr != nullptr)
+					{
+						hazards.push_back(ptr);
+					}
+				}
+				std::sort(hazards.begin(), hazards.end());
+				std::vector<Retired> ready;
+				for (auto& item : candidates)
+				{
+					if (std::binary_search(hazards.begin(), hazards.end(), static_cast<const void*>(item.ptr)))
+					{
+						record.bag.push_back(item);
+					}
+					else
+					{
+						ready.push_back(item);
+					}
+				}
+				reclaimAll(ready); // May retire more objects into record.bag.
+			}
+
+			std::atomic<Slot*> slots{nullptr};
+			std::atomic<size_t> slot_count{0};
+			std::atomic<Record*> records{nullptr};
+			std::atomic<bool> is_closed{false};
+			std::mutex orphans_mtx; // Protects orphans and the closing of the domain.
+			std::vector<Retired> orphans; // Left behind by exited threads.
+			const size_t batch_size;
+		};
+	}
+
+	//! class EpochDomain
+	/**
+	 * Epoch based memory reclamation for lock-free structures. Readers pin the
+	 * domain (see EpochGuard) while they hold pointers into the structure; a
+	 * writer that unlinks a node retires it instead of deleting it. A retired
+	 * node is destroyed once the global epoch has moved two steps past the
+	 * moment it was retired, which guarantees that no pinned reader can still
+	 * see it. Pinning costs a store and a fence, with no shared write.
+	 *
+	 * Retired nodes are gathered in per-thread batches of batch_size; only a
+	 * full batch pays for advancing the epoch and reclaiming, so retire stays
+	 * cheap. ThreadPool and ActiveWorker threads also advance the epoch and
+	 * reclaim between two tasks, when they cannot be pinned, so nodes retired
+	 * by pool tasks do not wait for a full batch.
+	 *
+	 * A pinned thread holds back reclamation for every thread, so guards must
+	 * be short lived and never held while blocking.
+	 *
+	 * \code
+	 * EpochDomain domain;
+	 * {
+	 *     EpochGuard guard{domain};
+	 *     auto node = head.load(std::memory_order_acquire);
+	 *     if (node && head.compare_exchange_strong(node, node->next)) domain.retire(node);
+	 * }
+	 * \endcode
+	 */
+	class EpochDomain
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param batch_size the number of objects a thread retires before it tries to reclaim.
+		 */
+		explicit EpochDomain(size_t batch_size = 64)
+			: _state(std::make_shared<details::EpochState>(batch_size > 0 ? batch_size : 1))
+		{}
+
+		//! Copy constructor
+		EpochDomain(const EpochDomain& other) = delete;
+		//! Copy assignment
+		EpochDomain& operator=(const EpochDomain& other) = delete;
+
+		//! Destructor
+		/**
+		 * Destroys every retired object. No thread may be pinned; objects retired
+		 * by other threads and not sealed yet are destroyed by those threads,
+		 * between two tasks or when they exit.
+		 */
+		~EpochDomain()
+		{
+			_state->close();
+			details::threadRecords<details::EpochState>().drop(_state.get());
+		}
+
+		//! retire
+		/**
+		 * Hands over an object unlinked from the structure. It is deleted once no
+		 * pinned thread can reach it.
+		 */
+		template<typename T>
+		void retire(T* ptr)
+		{
+			retire(ptr, &details::deleteRetired<T>);
+		}
+
+		//! retire
+		/**
+		 * \param ptr the object to destroy.
+		 * \param deleter a function destroying ptr. It must not throw.
+		 */
+		void retire(void* ptr, void (*deleter)(void*))
+		{
+			_state->retire(record(), details::Retired{ptr, deleter});
+		}
+
+		//! collect
+		/**
+		 * Seals the objects the calling thread retired, tries to advance the
+		 * epoch twice and reclaims what has become safe. When no thread is
+		 * pinned this reclaims everything the calling thread retired.
+		 */
+		void collect()
+		{
+			auto& local = record();
+			_state->seal(local);
+			if (_state->tryAdvance())
+			{
+				_state->tryAdvance();
+			}
+			_state->collect(local);
+		}
+
+		//! epoch
+		/**
+		 * \return the global epoch.
+		 */
+		uint64_t epoch() const noexcept
+		{
+			return _state->epoch.load(std::memory_order_acquire);
+		}
+
+		private:
+
+		friend class EpochGuard;
+
+		details::EpochState::Record& record()
+		{
+			return details::threadRecords<details::EpochState>().get(_state);
+		}
+
+		std::shared_ptr<details::EpochState> _state;
+	};
+
+	//! class EpochGuard
+	/**
+	 * Pins the calling thread in a domain for the lifetime of the scope, so the
+	 * objects it reads are not reclaimed under it. Guards nest.
+	 */
+	class EpochGuard
+	{
+		public:
+
+		//! Constructor
+		explicit EpochGuard(EpochDomain& domain)
+			: _state(*domain._state)
+			, _record(domain.record())
+		{
+			_state.pin(_record);
+		}
+
+		//! Copy constructor
+		EpochGuard(const EpochGuard& other) = delete;
+		//! Copy assignment
+		EpochGuard& operator=(const EpochGuard& other) = delete;
+
+		//! Destructor
+		~EpochGuard()
+		{
+			_state.unpin(_record);
+		}
+
+		private:
+
+		details::EpochState& _state;
+		details::EpochState::Record& _record;
+	};
+
+	//! class HazardDomain
+	/**
+	 * Hazard pointer reclamation, the alternative to EpochDomain when readers
+	 * may hold on to a node for long: a reader publishes the single node it is
+	 * about to use (see HazardPointer) and only that node is kept alive, so a
+	 * stalled reader never holds back the reclamation of anything else. The
+	 * price is a fence per protected pointer.
+	 *
+	 * Retired objects are batched per thread; a batch is scanned against every
+	 * hazard pointer once it holds batch_size objects, or twice the number of
+	 * hazard pointers if that is more.
+	 */
+	class HazardDomain
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param batch_size the minimum number of objects a thread retires before it scans.
+		 */
+		explicit HazardDomain(size_t batch_size = 64)
+			: _state(std::make_shared<details::HazardState>(batch_size > 0 ? batch_size : 1))
+		{}
+
+		//! Copy constructor
+		HazardDomain(const HazardDomain& other) = delete;
+		//! Copy assignment
+		HazardDomain& operator=(const HazardDomain& other) = delete;
+
+		//! Destructor
+		/**
+		 * Destroys every retired object. No HazardPointer of the domain may be alive.
+		 */
+		~HazardDomain()
+		{
+			_state->close();
+			details::threadRecords<details::HazardState>().drop(_state.get());
+		}
+
+		//! retire
+		/**
+		 * Hands over an object unlinked from the structure. It is deleted once no
+		 * hazard pointer protects it.
+		 */
+		template<typename T>
+		void retire(T* ptr)
+		{
+			retire(ptr, &details::deleteRetired<T>);
+		}
+
+		//! retire
+		/**
+		 * \param ptr the object to destroy.
+		 * \param deleter a function destroying ptr. It must not throw.
+		 */
+		void retire(void* ptr, void (*deleter)(void*))
+		{
+			_state->retire(record(), details::Retired{ptr, deleter});
+		}
+
+		//! collect
+		/**
+		 * Reclaims the objects retired by the calling thread, or left by exited
+		 * threads, that no hazard pointer protects.
+		 */
+		void collect()
+		{
+			_state->scan(record());
+		}
+
+		private:
+
+		friend class HazardPointer;
+
+		details::HazardState::Record& record()
+		{
+			return details::threadRecords<details::HazardState>().get(_state);
+		}
+
+		std::shared_ptr<details::HazardState> _state;
+	};
+
+	//! class HazardPointer
+	/**
+	 * One hazard pointer of a HazardDomain. The object it protects is not
+	 * reclaimed until it protects another one, is reset or is destroyed.
+	 *
+	 * \code
+	 * HazardPointer hazard{domain};
+	 * auto node = hazard.protect(head);
+	 * if (node) use(node->value);
+	 * \endcode
+	 */
+	class HazardPointer
+	{
+		public:
+
+		//! Constructor
+		explicit HazardPointer(HazardDomain& domain)
+			: _state(*domain._state)
+			, _slot(_state.acquireSlot())
+		{}
+
+		//! Copy constructor
+		HazardPointer(const HazardPointer& other) = delete;
+		//! Copy assignment
+		HazardPointer& operator=(const HazardPointer& other) = delete;
+
+		//! Destructor
+		~HazardPointer()
+		{
+			_state.releaseSlot(_slot);
+		}
+
+		//! protect
+		/**
+		 * Loads source and protects the result, retrying until the pointer
+		 * published is still the value of source.
+		 * \return the protected pointer, which may be null.
+		 */
+		template<typename T>
+		T* protect(const std::atomic<T*>& source) noexcept
+		{
+			auto ptr = source.load(std::memory_order_relaxed);
+			while (true)
+			{
+				_slot->ptr.store(ptr, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				auto current = source.load(std::memory_order_acquire);
+				if (current == ptr)
+				{
+					return ptr;
+				}
+				ptr = current;
+			}
+		}
+
+		//! reset
+		/**
+		 * Stops protecting the current object.
+		 */
+		void reset() noexcept
+		{
+			_slot->ptr.store(nullptr, std::memory_order_release);
+		}
+
+		private:
+
+		details::HazardState& _state;
+		details::HazardState::Slot* _slot;
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_RECLAMATION_HEADER
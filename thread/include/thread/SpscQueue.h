@@ -0,0 +1,182 @@
+#pragma once
+#ifndef THREADING_SPSCQUEUE_HEADER
+#define THREADING_SPSCQUEUE_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <common/Utility.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! class SpscQueue
+	/**
+	 * A bounded wait-free queue for exactly one producer thread and one consumer
+	 * thread. The ring has a power-of-two capacity and each side owns one index,
+	 * which only it writes. Each side also keeps a cached copy of the other
+	 * side's index and reloads it only when the ring looks full (or empty), so
+	 * in steady state a push or a pop touches no cache line written by the
+	 * other thread except the slot itself.
+	 *
+	 * Calling tryPush from more than one thread, or tryPop from more than one
+	 * thread, at the same time is undefined behaviour.
+	 */
+	template<typename T>
+	class SpscQueue
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param capacity the maximum number of queued items, rounded up to a power of two.
+		 * It must be positive.
+		 */
+		explicit SpscQueue(size_t capacity)
+			: _capacity(checkedCapacity(capacity))
+			, _mask(_capacity - 1)
+			, _slots(new Slot[_capacity])
+		{}
+
+		//! Copy constructor
+		SpscQueue(const SpscQueue& other) = delete;
+		//! Copy assignment
+		SpscQueue& operator=(const SpscQueue& other) = delete;
+
+		//! Destructor
+		/**
+		 * Destroys the items still queued.
+		 */
+		~SpscQueue()
+		{
+			auto head = _consumer.index.load(std::memory_order_relaxed);
+			auto tail = _producer.index.load(std::memory_order_relaxed);
+			for (; head != tail; ++head)
+			{
+				item(head)->~T();
+			}
+		}
+
+		//! tryPush
+		/**
+		 * Queues value if there is room. Producer thread only.
+		 * \return false if the queue is full; value is left untouched then.
+		 */
+		bool tryPush(T&& value)
+		{
+			auto tail = _producer.index.load(std::memory_order_relaxed);
+			if (tail - _producer.cached == _capacity)
+			{
+				_producer.cached = _consumer.index.load(std::memory_order_acquire);
+				if (tail - _producer.cached == _capacity)
+				{
+					return false;
+				}
+			}
+			::new (static_cast<void*>(item(tail))) T(std::move(value));
+			_producer.index.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		//! tryPush
+		/**
+		 * Queues a copy of value. See tryPush(T&&).
+		 */
+		bool tryPush(const T& value)
+		{
+			T copy(value);
+			return tryPush(std::move(copy));
+		}
+
+		//! tryPop
+		/**
+		 * Takes the oldest item if there is one. Consumer thread only.
+		 * \param value Output parameter that receives the item.
+		 * \return false if the queue is empty.
+		 */
+		bool tryPop(T& value)
+		{
+			auto head = _consumer.index.load(std::memory_order_relaxed);
+			if (head == _consumer.cached)
+			{
+				_consumer.cached = _producer.index.load(std::memory_order_acquire);
+				if (head == _consumer.cached)
+				{
+					return false;
+				}
+			}
+			auto slot = item(head);
+			value = std::move(*slot);
+			slot->~T();
+			_consumer.index.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		//! size
+		/**
+		 * \return the number of queued items. Exact only when called by one of the two sides.
+		 */
+		size_t size() const noexcept
+		{
+			auto head = _consumer.index.load(std::memory_order_acquire);
+			auto tail = _producer.index.load(std::memory_order_acquire);
+			return tail - head;
+		}
+
+		//! empty
+		bool empty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		//! capacity
+		size_t capacity() const noexcept
+		{
+			return _capacity;
+		}
+
+		private:
+
+		using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+		//! The index one side writes and its cached copy of the other side's
+		//! index, padded so the two sides never share a cache line.
+		struct Side
+		{
+			std::atomic<size_t> index{0};
+			size_t cached = 0;
+			char padding[utilities::kCacheLineSize];
+		};
+
+		static size_t checkedCapacity(size_t capacity)
+		{
+			if (capacity == 0 || capacity > (size_t(1) << (sizeof(size_t) * 8 - 2)))
+			{
+				throw std::invalid_argument("queue capacity must be positive");
+			}
+			size_t result = 1;
+			while (result < capacity)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		T* item(size_t index) noexcept
+		{
+			return reinterpret_cast<T*>(&_slots[index & _mask]);
+		}
+
+		const size_t _capacity;
+		const size_t _mask;
+		std::unique_ptr<Slot[]> _slots;
+		char _padding[utilities::kCacheLineSize]; // Keeps the indices off the read-only members.
+		Side _producer; // Written by the producer: its index and its copy of the consumer index.
+		Side _consumer; // Written by the consumer: its index and its copy of the producer index.
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_SPSCQUEUE_HEADER
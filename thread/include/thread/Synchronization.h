@@ -0,0 +1,395 @@
+#pragma once
+#ifndef THREADING_SYNCHRONIZATION_HEADER
+#define THREADING_SYNCHRONIZATION_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <thread/Futex.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! The bit of a futex word telling that some thread sleeps on it. The
+		//! other bits hold the count or phase. Keeping both in one word lets
+		//! the waking side touch nothing but the futex address once the state
+		//! has changed, so a released waiter may destroy the object right away.
+		static constexpr uint32_t kWaitersBit = 0x80000000u;
+
+		inline uint32_t checkedCount(std::ptrdiff_t count, const char* message)
+		{
+			if (count < 0 || count > static_cast<std::ptrdiff_t>(kWaitersBit - 1))
+			{
+				throw std::invalid_argument(message);
+			}
+			return static_cast<uint32_t>(count);
+		}
+
+		//! Sets the waiters bit of word if it still holds value and sleeps.
+		/**
+		 * \return false if word no longer holds value, so the caller must re-check.
+		 */
+		inline bool sleepOn(std::atomic<uint32_t>& word, uint32_t value) noexcept
+		{
+			if ((value & kWaitersBit) == 0
+				&& !word.compare_exchange_strong(value, value | kWaitersBit, std::memory_order_relaxed))
+			{
+				return false;
+			}
+			futexWait(&word, value | kWaitersBit);
+			return true;
+		}
+
+		//! Same as sleepOn but gives up at the deadline.
+		inline bool sleepOnUntil(std::atomic<uint32_t>& word, uint32_t value, std::chrono::steady_clock::time_point deadline) noexcept
+		{
+			if ((value & kWaitersBit) == 0
+				&& !word.compare_exchange_strong(value, value | kWaitersBit, std::memory_order_relaxed))
+			{
+				return false;
+			}
+			futexWaitFor(&word, value | kWaitersBit, deadline - std::chrono::steady_clock::now());
+			return true;
+		}
+	}
+
+	//! class Latch
+	/**
+	 * A single use countdown, like C++20 std::latch: threads wait until the
+	 * counter reaches zero. Counting down is one atomic subtraction, plus a
+	 * wake syscall only if a thread sleeps; waiting on an open latch is one
+	 * load. A waiter released by the last countDown may destroy the latch.
+	 */
+	class Latch
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param expected the initial value of the counter, from 0 to 2^31 - 1.
+		 */
+		explicit Latch(std::ptrdiff_t expected)
+			: _count(details::checkedCount(expected, "latch count out of range"))
+		{}
+
+		//! Copy constructor
+		Latch(const Latch& other) = delete;
+		//! Copy assignment
+		Latch& operator=(const Latch& other) = delete;
+
+		//! countDown
+		/**
+		 * Decrements the counter, waking the waiters when it reaches zero. Must
+		 * not take it below zero.
+		 * \param n the amount to decrement.
+		 */
+		void countDown(std::ptrdiff_t n = 1) noexcept
+		{
+			auto amount = static_cast<uint32_t>(n);
+			auto old = _count.fetch_sub(amount, std::memory_order_acq_rel);
+			if ((old & ~details::kWaitersBit) == amount && (old & details::kWaitersBit) != 0)
+			{
+				details::futexWakeAll(&_count);
+			}
+		}
+
+		//! tryWait
+		/**
+		 * \return true if the counter has reached zero.
+		 */
+		bool tryWait() const noexcept
+		{
+			return (_count.load(std::memory_order_acquire) & ~details::kWaitersBit) == 0;
+		}
+
+		//! wait
+		/**
+		 * Blocks until the counter reaches zero.
+		 */
+		void wait() noexcept
+		{
+			uint32_t count;
+			while (((count = _count.load(std::memory_order_acquire)) & ~details::kWaitersBit) != 0)
+			{
+				details::sleepOn(_count, count);
+			}
+		}
+
+		//! arriveAndWait
+		/**
+		 * Counts down and waits for the counter to reach zero.
+		 * \param n the amount to decrement.
+		 */
+		void arriveAndWait(std::ptrdiff_t n = 1) noexcept
+		{
+			countDown(n);
+			wait();
+		}
+
+		private:
+
+		std::atomic<uint32_t> _count; // The counter and the waiters bit; the futex word.
+	};
+
+	//! class Barrier
+	/**
+	 * A reusable barrier for a fixed set of threads, like C++20 std::barrier.
+	 * Each phase ends when every participant has arrived: the last one to
+	 * arrive runs the completion function, if any, and releases the others.
+	 *
+	 * Arriving is one atomic subtraction. Waiters sleep on the phase word, a
+	 * futex, and are woken with a single syscall by the last arrival, only
+	 * if some of them actually went to sleep.
+	 */
+	class Barrier
+	{
+		public:
+
+		//! Identifies the phase a thread arrived in. See arrive and wait.
+		using Token = uint32_t;
+
+		//! Constructor
+		/**
+		 * \param parties the number of participants, from 1 to 2^31 - 1.
+		 * \param completion run by the last thread to arrive at each phase, before the others are released.
+		 */
+		explicit Barrier(std::ptrdiff_t parties, std::function<void()> completion = nullptr)
+			: _phase(0)
+			, _remaining(checkedParties(parties))
+			, _parties(_remaining.load(std::memory_order_relaxed))
+			, _completion(std::move(completion))
+		{}
+
+		//! Copy constructor
+		Barrier(const Barrier& other) = delete;
+		//! Copy assignment
+		Barrier& operator=(const Barrier& other) = delete;
+
+		//! arrive
+		/**
+		 * Arrives at the current phase without waiting.
+		 * \return a token to pass to wait.
+		 */
+		Token arrive()
+		{
+			auto token = phase(); // Cannot advance before we arrive.
+			if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				completePhase();
+			}
+			return token;
+		}
+
+		//! wait
+		/**
+		 * Blocks until the phase of token completes.
+		 * \param token the value returned by arrive.
+		 */
+		void wait(Token token) const noexcept
+		{
+			uint32_t word;
+			while (((word = _phase.load(std::memory_order_acquire)) & ~details::kWaitersBit) == token)
+			{
+				details::sleepOn(_phase, word);
+			}
+		}
+
+		//! arriveAndWait
+		/**
+		 * Arrives at the current phase and blocks until it completes.
+		 */
+		void arriveAndWait()
+		{
+			wait(arrive());
+		}
+
+		//! arriveAndDrop
+		/**
+		 * Arrives at the current phase and leaves the barrier: the next phases
+		 * expect one participant less.
+		 */
+		void arriveAndDrop()
+		{
+			_parties.fetch_sub(1, std::memory_order_relaxed);
+			arrive();
+		}
+
+		//! phase
+		/**
+		 * \return the number of completed phases, modulo 2^31.
+		 */
+		Token phase() const noexcept
+		{
+			return _phase.load(std::memory_order_acquire) & ~details::kWaitersBit;
+		}
+
+		private:
+
+		static uint32_t checkedParties(std::ptrdiff_t parties)
+		{
+			if (parties <= 0)
+			{
+				throw std::invalid_argument("barrier parties must be positive");
+			}
+			return details::checkedCount(parties, "barrier parties out of range");
+		}
+
+		// Run by the last thread to arrive: nobody else touches the barrier
+		// until the phase advances, except participants that already dropped.
+		void completePhase()
+		{
+			if (_completion)
+			{
+				_completion();
+			}
+			_remaining.store(_parties.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			auto old = _phase.load(std::memory_order_relaxed);
+			auto next = ((old & ~details::kWaitersBit) + 1) & ~details::kWaitersBit;
+			old = _phase.exchange(next, std::memory_order_acq_rel); // Clears the waiters bit.
+			if ((old & details::kWaitersBit) != 0)
+			{
+				details::futexWakeAll(&_phase);
+			}
+		}
+
+		mutable std::atomic<uint32_t> _phase;   // The phase and the waiters bit; the futex word.
+		std::atomic<uint32_t> _remaining;       // Participants yet to arrive at the current phase.
+		std::atomic<uint32_t> _parties;         // Participants expected at the next phase.
+		std::function<void()> _completion;
+	};
+
+	//! class CountingSemaphore
+	/**
+	 * A counting semaphore, like C++20 std::counting_semaphore. acquire takes
+	 * a unit with a compare-and-swap when one is available and sleeps on a
+	 * futex otherwise; release adds units and only makes a syscall if some
+	 * thread sleeps. A release wakes every sleeper, which then compete for
+	 * the units, so none can be left asleep while units are available.
+	 */
+	class CountingSemaphore
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param initial the number of units available, from 0 to 2^31 - 1.
+		 */
+		explicit CountingSemaphore(std::ptrdiff_t initial)
+			: _count(details::checkedCount(initial, "semaphore count out of range"))
+		{}
+
+		//! Copy constructor
+		CountingSemaphore(const CountingSemaphore& other) = delete;
+		//! Copy assignment
+		CountingSemaphore& operator=(const CountingSemaphore& other) = delete;
+
+		//! release
+		/**
+		 * Makes n units available.
+		 * \param n the number of units.
+		 */
+		void release(std::ptrdiff_t n = 1) noexcept
+		{
+			auto count = _count.load(std::memory_order_relaxed);
+			uint32_t next;
+			do
+			{
+				next = (count & ~details::kWaitersBit) + static_cast<uint32_t>(n); // Clears the waiters bit.
+			}
+			while (!_count.compare_exchange_weak(count, next, std::memory_order_release, std::memory_order_relaxed));
+			if ((count & details::kWaitersBit) != 0)
+			{
+				details::futexWakeAll(&_count);
+			}
+		}
+
+		//! acquire
+		/**
+		 * Takes a unit, blocking until one is available.
+		 */
+		void acquire() noexcept
+		{
+			uint32_t count;
+			while (!tryAcquire(count))
+			{
+				details::sleepOn(_count, count);
+			}
+		}
+
+		//! tryAcquire
+		/**
+		 * Takes a unit if one is available.
+		 * \return false if none was.
+		 */
+		bool tryAcquire() noexcept
+		{
+			uint32_t count;
+			return tryAcquire(count);
+		}
+
+		//! tryAcquireUntil
+		/**
+		 * Takes a unit, blocking until one is available or the deadline passes.
+		 * \return false if the deadline passed first.
+		 */
+		bool tryAcquireUntil(std::chrono::steady_clock::time_point deadline) noexcept
+		{
+			uint32_t count;
+			while (!tryAcquire(count))
+			{
+				if (std::chrono::steady_clock::now() >= deadline)
+				{
+					return false;
+				}
+				details::sleepOnUntil(_count, count, deadline);
+			}
+			return true;
+		}
+
+		//! tryAcquireFor
+		/**
+		 * See tryAcquireUntil.
+		 * \param timeout the maximum time to wait.
+		 */
+		template<typename Rep, typename Period>
+		bool tryAcquireFor(const std::chrono::duration<Rep, Period>& timeout) noexcept
+		{
+			return tryAcquireUntil(std::chrono::steady_clock::now()
+				+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+		}
+
+		//! available
+		/**
+		 * \return the number of units available right now.
+		 */
+		std::ptrdiff_t available() const noexcept
+		{
+			return _count.load(std::memory_order_relaxed) & ~details::kWaitersBit;
+		}
+
+		private:
+
+		// Takes a unit if one is available; otherwise count is the word observed.
+		bool tryAcquire(uint32_t& count) noexcept
+		{
+			count = _count.load(std::memory_order_relaxed);
+			while ((count & ~details::kWaitersBit) != 0)
+			{
+				if (_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		std::atomic<uint32_t> _count; // The units and the waiters bit; the futex word.
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_SYNCHRONIZATION_HEADER
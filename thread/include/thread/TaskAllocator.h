@@ -0,0 +1,358 @@
+#pragma once
+#ifndef THREADING_TASKALLOCATOR_HEADER
+#define THREADING_TASKALLOCATOR_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! Number of fixed block sizes recycled by the task allocator: 64, 128, ..., 4096 bytes.
+		static constexpr std::size_t kBlockClasses = 7;
+		//! Smallest block size (header included).
+		static constexpr std::size_t kMinBlockSize = 64;
+		//! Maximum number of idle blocks a cache keeps per size class before giving them back.
+		static constexpr uint32_t kMaxCachedBlocks = 1024;
+		//! Number of blocks a thread gathers before handing them back to their origin cache.
+		static constexpr uint32_t kRemoteBatchSize = 32;
+
+		struct BlockCache;
+
+		//! Header placed in front of every block. It keeps the block's origin and size class.
+		struct alignas(std::max_align_t) BlockHeader
+		{
+			BlockCache* origin;
+			uint32_t size_class;
+		};
+
+		//! Link used while a block sits on a free list. It overlays the payload.
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		inline BlockHeader* headerOf(FreeBlock* block) noexcept
+		{
+			return reinterpret_cast<BlockHeader*>(block) - 1;
+		}
+
+		inline FreeBlock* payloadOf(BlockHeader* header) noexcept
+		{
+			return reinterpret_cast<FreeBlock*>(header + 1);
+		}
+
+		//! Size class of a request, kBlockClasses if it is too big to be recycled.
+		inline uint32_t sizeClassOf(std::size_t bytes) noexcept
+		{
+			std::size_t block = kMinBlockSize;
+			uint32_t size_class = 0;
+			while (size_class < kBlockClasses && block - sizeof(BlockHeader) < bytes)
+			{
+				block <<= 1;
+				++size_class;
+			}
+			return size_class;
+		}
+
+		//! class BlockCache
+		/**
+		 * A per-thread cache of free blocks. Blocks are taken from and returned to
+		 * the local free lists without synchronization. Blocks freed by other threads
+		 * come back in batches through the lock-free _remote stack, which the owner
+		 * drains when a local list runs dry.
+		 */
+		struct BlockCache
+		{
+			BlockCache()
+				: _remote(nullptr)
+			{
+				for (std::size_t i = 0; i < kBlockClasses; ++i)
+				{
+					_free[i] = nullptr;
+					_count[i] = 0;
+				}
+			}
+
+			void* allocate(uint32_t size_class)
+			{
+				if (_free[size_class] == nullptr)
+				{
+					reclaimRemote();
+				}
+				auto block = _free[size_class];
+				if (block != nullptr)
+				{
+					_free[size_class] = block->next;
+					--_count[size_class];
+					return block;
+				}
+				auto header = static_cast<BlockHeader*>(::operator new(kMinBlockSize << size_class));
+				header->origin = this;
+				header->size_class = size_class;
+				return payloadOf(header);
+			}
+
+			// Called by the owner thread for its own blocks.
+			void release(FreeBlock* block, uint32_t size_class) noexcept
+			{
+				if (_count[size_class] >= kMaxCachedBlocks)
+				{
+					::operator delete(headerOf(block));
+					return;
+				}
+				block->next = _free[size_class];
+				_free[size_class] = block;
+				++_count[size_class];
+			}
+
+			// Called by other threads to hand back a chain of blocks in one CAS.
+			void pushRemote(FreeBlock* head, FreeBlock* tail) noexcept
+			{
+				auto old_head = _remote.load(std::memory_order_relaxed);
+				do
+				{
+					tail->next = old_head;
+				}
+				while (!_remote.compare_exchange_weak(old_head, head, std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			// Moves every block returned by other threads to the local free lists.
+			void reclaimRemote() noexcept
+			{
+				auto block = _remote.exchange(nullptr, std::memory_order_acquire);
+				while (block != nullptr)
+				{
+					auto next = block->next;
+					release(block, headerOf(block)->size_class);
+					block = next;
+				}
+			}
+
+			// Sends the pending batch of foreign blocks back to its origin.
+			void flushBatch() noexcept
+			{
+				if (_batch_head != nullptr)
+				{
+					_batch_origin->pushRemote(_batch_head, _batch_tail);
+					_batch_origin = nullptr;
+					_batch_head = _batch_tail = nullptr;
+					_batch_size = 0;
+				}
+			}
+
+			// Queues a block owned by another cache, flushing when the batch is full
+			// or when the block belongs to a different origin.
+			void batchRemote(FreeBlock* block, BlockCache* origin) noexcept
+			{
+				if (origin != _batch_origin)
+				{
+					flushBatch();
+					_batch_origin = origin;
+				}
+				block->next = _batch_head;
+				_batch_head = block;
+				if (_batch_tail == nullptr)
+				{
+					_batch_tail = block;
+				}
+				if (++_batch_size >= kRemoteBatchSize)
+				{
+					flushBatch();
+				}
+			}
+
+			FreeBlock* _free[kBlockClasses];
+			uint32_t _count[kBlockClasses];
+			std::atomic<FreeBlock*> _remote;
+			BlockCache* _batch_origin = nullptr;
+			FreeBlock* _batch_head = nullptr;
+			FreeBlock* _batch_tail = nullptr;
+			uint32_t _batch_size = 0;
+			BlockCache* _next_orphan = nullptr;
+		};
+
+		//! Caches whose thread exited. They are adopted by new threads instead of being
+		//! destroyed, because blocks they handed out may still be returned to them.
+		struct BlockCacheRegistry
+		{
+			BlockCache* adopt()
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				if (_orphans == nullptr)
+				{
+					return new BlockCache();
+				}
+				auto cache = _orphans;
+				_orphans = cache->_next_orphan;
+				cache->_next_orphan = nullptr;
+				return cache;
+			}
+
+			void orphan(BlockCache* cache)
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				cache->_next_orphan = _orphans;
+				_orphans = cache;
+			}
+
+			std::mutex _mtx;
+			BlockCache* _orphans = nullptr;
+		};
+
+		inline BlockCacheRegistry& blockCacheRegistry()
+		{
+			static BlockCacheRegistry registry;
+			return registry;
+		}
+
+		//! Owns the calling thread's cache for the lifetime of the thread.
+		struct BlockCacheHolder
+		{
+			BlockCacheHolder()
+				: _cache(blockCacheRegistry().adopt())
+			{}
+
+			~BlockCacheHolder()
+			{
+				_cache->flushBatch();
+				blockCacheRegistry().orphan(_cache);
+			}
+
+			BlockCache* _cache;
+		};
+
+		inline BlockCache& localBlockCache()
+		{
+			static thread_local BlockCacheHolder holder;
+			return *holder._cache;
+		}
+
+		//! Allocates bytes from the calling thread's cache.
+		inline void* allocateBlock(std::size_t bytes)
+		{
+			auto size_class = sizeClassOf(bytes);
+			if (size_class == kBlockClasses)
+			{
+				if (bytes > SIZE_MAX - sizeof(BlockHeader))
+				{
+					throw std::bad_alloc();
+				}
+				auto header = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader) + bytes));
+				header->origin = nullptr;
+				header->size_class = size_class;
+				return payloadOf(header);
+			}
+			return localBlockCache().allocate(size_class);
+		}
+
+		//! Returns a block to its origin: directly if it is ours, batched otherwise.
+		inline void deallocateBlock(void* ptr) noexcept
+		{
+			auto block = static_cast<FreeBlock*>(ptr);
+			auto header = headerOf(block);
+			if (header->origin == nullptr)
+			{
+				::operator delete(header);
+				return;
+			}
+			auto& cache = localBlockCache();
+			if (header->origin == &cache)
+			{
+				cache.release(block, header->size_class);
+			}
+			else
+			{
+				cache.batchRemote(block, header->origin);
+			}
+		}
+
+	} // namespace details
+
+	//! flushTaskAllocatorCache
+	/**
+	 * Hands back to their origin every block the calling thread freed on behalf of
+	 * other threads and that is still waiting in a partial batch. Workers call it
+	 * before going to sleep so idle producers get their blocks back.
+	 */
+	inline void flushTaskAllocatorCache() noexcept
+	{
+		details::localBlockCache().flushBatch();
+	}
+
+	//! class TaskAllocator
+	/**
+	 * A stateless allocator that recycles fixed-size blocks from thread-local caches.
+	 * It is meant for task closures and future shared states, which are allocated by
+	 * the submitting thread and released by the worker: released blocks are batched
+	 * back to the cache of the thread that allocated them instead of going through
+	 * the global heap.
+	 *
+	 * \code
+	 * worker.addWork(std::allocator_arg, TaskAllocator<char>{}, f);
+	 * \endcode
+	 */
+	template<typename T>
+	class TaskAllocator
+	{
+		public:
+
+		using value_type = T;
+
+		//! Default constructor
+		TaskAllocator() noexcept = default;
+
+		//! Converting constructor
+		template<typename U>
+		TaskAllocator(const TaskAllocator<U>&) noexcept
+		{}
+
+		//! allocate
+		/**
+		 * Blocks are aligned for std::max_align_t, so over-aligned types, i.e.
+		 * an alignas(64) functor in a shared state, are rejected at compile time.
+		 * \param n the number of objects of type T to allocate room for.
+		 * \throw std::bad_alloc if the request does not fit in a size_t.
+		 */
+		T* allocate(std::size_t n)
+		{
+			static_assert(alignof(T) <= alignof(std::max_align_t),
+				"TaskAllocator blocks are only aligned for std::max_align_t");
+			if (n > SIZE_MAX / sizeof(T))
+			{
+				throw std::bad_alloc();
+			}
+			return static_cast<T*>(details::allocateBlock(n * sizeof(T)));
+		}
+
+		//! deallocate
+		/**
+		 * \param p a pointer returned by allocate. It may be released by any thread.
+		 */
+		void deallocate(T* p, std::size_t) noexcept
+		{
+			details::deallocateBlock(p);
+		}
+	};
+
+	//! operator ==
+	template<typename T, typename U>
+	bool operator == (const TaskAllocator<T>&, const TaskAllocator<U>&) noexcept
+	{
+		return true;
+	}
+
+	//! operator !=
+	template<typename T, typename U>
+	bool operator != (const TaskAllocator<T>&, const TaskAllocator<U>&) noexcept
+	{
+		return false;
+	}
+
+}}} // rboc::utils::threading
+
+#endif // THREADING_TASKALLOCATOR_HEADER
@@ -0,0 +1,214 @@
+#pragma once
+#ifndef THREADING_TASKGROUP_HEADER
+#define THREADING_TASKGROUP_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <thread/BlockingRegion.h>
+#include <thread/EventCount.h>
+#include <thread/TaskAllocator.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! State shared by a TaskGroup and its queued tasks, which keep it alive
+		//! until they finish even if the group object is already gone.
+		struct TaskGroupState
+		{
+			std::atomic<size_t> pending{0};
+			std::atomic_bool cancelled{false};
+			EventCount event;
+			std::mutex mtx; /*! < Protects error. */
+			std::exception_ptr error;
+
+			void fail(std::exception_ptr e)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					if (!error)
+					{
+						error = std::move(e);
+					}
+				}
+				cancelled.store(true, std::memory_order_relaxed);
+			}
+
+			void finish() noexcept
+			{
+				if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					event.notifyAll();
+				}
+			}
+		};
+
+		//! Runs a group task unless the group was cancelled and signals completion.
+		template<typename F>
+		struct GroupTask
+		{
+			void operator()()
+			{
+				if (!state->cancelled.load(std::memory_order_relaxed))
+				{
+					try
+					{
+						f();
+					}
+					catch (...)
+					{
+						state->fail(std::current_exception());
+					}
+				}
+				state->finish();
+			}
+
+			F f;
+			std::shared_ptr<TaskGroupState> state;
+		};
+	}
+
+	//! class TaskGroup
+	/**
+	 * A set of tasks run on a ThreadPool<void> with a single join point. Instead
+	 * of a future per task, the group counts outstanding tasks with one atomic
+	 * counter and wait() returns once it drops to zero.
+	 *
+	 * The first exception thrown by a task cancels the group: tasks that have not
+	 * started yet are skipped, and wait() rethrows that exception. cancel() does
+	 * the same without an error.
+	 *
+	 * Groups nest: a task may create a group and wait on it. wait() runs inside a
+	 * BlockingRegion, so when it is called from a pool worker the pool keeps
+	 * running that worker's queue, including the children, on a compensating
+	 * thread instead of deadlocking.
+	 *
+	 * \code
+	 * TaskGroup group{pool};
+	 * for (auto& chunk : chunks) group.run([&chunk]{ process(chunk); });
+	 * group.wait(); // rethrows the first failure
+	 * \endcode
+	 */
+	class TaskGroup
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param pool the pool that runs the tasks. It must outlive the group.
+		 */
+		explicit TaskGroup(ThreadPool<void>& pool)
+			: _pool(pool)
+			, _state(std::make_shared<details::TaskGroupState>())
+		{}
+
+		//! Copy constructor
+		TaskGroup(const TaskGroup& other) = delete;
+		//! Copy assignment
+		TaskGroup& operator=(const TaskGroup& other) = delete;
+
+		//! Destructor
+		/**
+		 * Waits for the outstanding tasks. Errors not collected by wait() are discarded.
+		 */
+		~TaskGroup()
+		{
+			waitIdle();
+		}
+
+		//! run
+		/**
+		 * Queues f on the pool as part of this group.
+		 * \param f the function to be executed, taking no arguments.
+		 */
+		template<typename F>
+		void run(F&& f)
+		{
+			using Task = details::GroupTask<typename std::decay<F>::type>;
+			_state->pending.fetch_add(1, std::memory_order_relaxed);
+			try
+			{
+				_pool.post(std::packaged_task<void()>(std::allocator_arg, TaskAllocator<char>(),
+					Task{std::forward<F>(f), _state}));
+			}
+			catch (...)
+			{
+				_state->finish();
+				throw;
+			}
+		}
+
+		//! wait
+		/**
+		 * Blocks until every task run so far has finished or been skipped.
+		 * The group can be reused afterwards.
+		 * \throw the first exception thrown by a task, which is then cleared.
+		 */
+		void wait()
+		{
+			waitIdle();
+			std::exception_ptr error;
+			{
+				std::lock_guard<std::mutex> lock(_state->mtx);
+				std::swap(error, _state->error);
+			}
+			_state->cancelled.store(false, std::memory_order_relaxed);
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		//! cancel
+		/**
+		 * Skips the tasks of the group that have not started yet. Running tasks
+		 * can poll cancelled() to stop early.
+		 */
+		void cancel() noexcept
+		{
+			_state->cancelled.store(true, std::memory_order_relaxed);
+		}
+
+		//! cancelled
+		/**
+		 * \return true if the group was cancelled or a task failed since the last wait().
+		 */
+		bool cancelled() const noexcept
+		{
+			return _state->cancelled.load(std::memory_order_relaxed);
+		}
+
+		private:
+
+		void waitIdle() noexcept
+		{
+			auto& state = *_state;
+			if (state.pending.load(std::memory_order_acquire) == 0)
+			{
+				return;
+			}
+			BlockingRegion region;
+			while (state.pending.load(std::memory_order_acquire) != 0)
+			{
+				auto key = state.event.prepareWait();
+				if (state.pending.load(std::memory_order_acquire) == 0)
+				{
+					state.event.cancelWait();
+					break;
+				}
+				state.event.wait(key);
+			}
+		}
+
+		ThreadPool<void>& _pool;
+		std::shared_ptr<details::TaskGroupState> _state;
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_TASKGROUP_HEADER
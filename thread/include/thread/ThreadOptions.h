@@ -0,0 +1,260 @@
+#pragma once
+#ifndef THREADING_THREADOPTIONS_HEADER
+#define THREADING_THREADOPTIONS_HEADER
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <common/Optional.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RBOC_THREADING_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define RBOC_THREADING_NOINLINE __declspec(noinline)
+#else
+#define RBOC_THREADING_NOINLINE
+#endif
+
+namespace rboc { namespace utils { namespace threading
+{
+	//! Scheduling class of a worker thread.
+	enum class SchedulingPolicy
+	{
+		normal,      /*! < The default time sharing class (SCHED_OTHER). */
+		fifo,        /*! < SCHED_FIFO: real-time, runs until it blocks or yields. */
+		roundRobin   /*! < SCHED_RR: real-time, time sliced among equal priorities. */
+	};
+
+	//! struct ThreadOptions
+	/**
+	 * How a worker thread should run, for latency sensitive work sharing the
+	 * host with batch jobs, and what it is called in top -H, perf or gdb.
+	 * Every option is off by default. Options that need
+	 * privileges (CAP_SYS_NICE, CAP_IPC_LOCK or a large RLIMIT_MEMLOCK) are
+	 * not applied when the process lacks them: the ThreadStatus says so and
+	 * the thread keeps running with its previous settings.
+	 *
+	 * \code
+	 * ThreadOptions options;
+	 * options.policy = SchedulingPolicy::fifo;
+	 * options.priority = 50;
+	 * options.lock_memory = true;
+	 * options.prefault_stack = 256 * 1024;
+	 * ActiveWorker<void> control{options};
+	 * if (!control.threadStatus().ok()) std::cerr << control.threadStatus().message << '\n';
+	 * \endcode
+	 */
+	struct ThreadOptions
+	{
+		SchedulingPolicy policy = SchedulingPolicy::normal;
+		int priority = 0;                  /*! < Real-time priority, 1 (lowest) to 99 on Linux. Ignored for normal. */
+		optional::Optional<int> nice;      /*! < Nice value, -20 (highest) to 19, for the normal class. */
+		bool lock_memory = false;          /*! < mlockall(MCL_CURRENT | MCL_FUTURE). Affects the whole process. */
+		size_t prefault_stack = 0;         /*! < Bytes of stack to touch so later calls take no page faults. */
+		std::string name;                  /*! < Thread name, truncated to kMaxThreadName characters. A pool appends "/<worker>". */
+
+		//! requested
+		/**
+		 * \return true if some option differs from the default.
+		 */
+		bool requested() const
+		{
+			return policy != SchedulingPolicy::normal || nice.has_value() || lock_memory || prefault_stack != 0 || !name.empty();
+		}
+	};
+
+	//! The longest thread name the system keeps: 15 characters on Linux.
+	static constexpr size_t kMaxThreadName = 15;
+
+	//! Outcome of applying one option.
+	enum class OptionStatus
+	{
+		notRequested,  /*! < The option was left at its default. */
+		applied,       /*! < The option is in effect. */
+		denied,        /*! < The process lacks the privilege or the resource limit. */
+		unsupported,   /*! < The platform has no such option. */
+		failed         /*! < The value was rejected, i.e. a priority out of range. */
+	};
+
+	//! struct ThreadStatus
+	/**
+	 * What became of each option of a ThreadOptions, with a readable summary
+	 * of the ones that were not applied.
+	 */
+	struct ThreadStatus
+	{
+		OptionStatus scheduling = OptionStatus::notRequested;
+		OptionStatus nice = OptionStatus::notRequested;
+		OptionStatus memory_lock = OptionStatus::notRequested;
+		OptionStatus stack_prefault = OptionStatus::notRequested;
+		OptionStatus naming = OptionStatus::notRequested;
+		std::string message; /*! < One "option: reason" entry per option not applied, separated by "; ". */
+
+		//! ok
+		/**
+		 * \return true if every requested option was applied.
+		 */
+		bool ok() const
+		{
+			return good(scheduling) && good(nice) && good(memory_lock) && good(stack_prefault) && good(naming);
+		}
+
+		private:
+
+		static bool good(OptionStatus status)
+		{
+			return status == OptionStatus::notRequested || status == OptionStatus::applied;
+		}
+	};
+
+	namespace details
+	{
+		inline void reportOption(ThreadStatus& status, OptionStatus& field, OptionStatus result, const char* option, const std::string& reason)
+		{
+			field = result;
+			if (result == OptionStatus::applied) return;
+			if (!status.message.empty()) status.message += "; ";
+			status.message += option;
+			status.message += ": ";
+			status.message += reason;
+		}
+
+		inline OptionStatus errnoStatus(int error)
+		{
+			return (error == EPERM || error == EACCES || error == ENOMEM) ? OptionStatus::denied : OptionStatus::failed;
+		}
+
+		//! The name of worker index of a pool called name, keeping the index when truncating.
+		inline std::string workerName(const std::string& name, size_t index)
+		{
+			auto suffix = "/" + std::to_string(index);
+			auto room = kMaxThreadName > suffix.size() ? kMaxThreadName - suffix.size() : 0;
+			return name.substr(0, room) + suffix;
+		}
+
+		//! Touches `bytes` of stack below the caller, a page per frame. Touching
+		//! after the recursive call keeps the frames from being merged.
+		RBOC_THREADING_NOINLINE inline size_t touchStack(size_t bytes)
+		{
+			volatile char page[4096];
+			page[0] = 0;
+			page[sizeof(page) - 1] = 0;
+			size_t touched = sizeof(page);
+			if (bytes > sizeof(page))
+			{
+				touched += touchStack(bytes - sizeof(page));
+			}
+			return touched + static_cast<size_t>(page[0]);
+		}
+
+		//! threadCpuTime
+		/**
+		 * \return the CPU time consumed so far by the thread, zero if it has
+		 * exited or the platform cannot tell.
+		 */
+		inline std::chrono::nanoseconds threadCpuTime(std::thread::native_handle_type thread)
+		{
+#if defined(__linux__)
+			clockid_t clock;
+			timespec time;
+			if (pthread_getcpuclockid(thread, &clock) == 0 && clock_gettime(clock, &time) == 0)
+			{
+				return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+			}
+#else
+			(void)thread;
+#endif
+			return std::chrono::nanoseconds(0);
+		}
+
+#if defined(__linux__)
+		//! The stack bytes the calling thread can still use, leaving a safety margin.
+		inline size_t usableStack()
+		{
+			pthread_attr_t attr;
+			if (pthread_getattr_np(pthread_self(), &attr) != 0) return 0;
+			void* base = nullptr;
+			size_t size = 0;
+			pthread_attr_getstack(&attr, &base, &size);
+			pthread_attr_destroy(&attr);
+			char here;
+			auto used = static_cast<size_t>(static_cast<char*>(base) + size - &here);
+			const size_t margin = 64 * 1024;
+			return size > used + margin ? size - used - margin : 0;
+		}
+#endif
+
+		//! applyThreadOptions
+		/**
+		 * Applies options to the calling thread. Never throws for a missing
+		 * privilege: the returned status reports it.
+		 */
+		inline ThreadStatus applyThreadOptions(const ThreadOptions& options)
+		{
+			ThreadStatus status;
+#if defined(__linux__)
+			if (options.policy != SchedulingPolicy::normal)
+			{
+				int policy = options.policy == SchedulingPolicy::fifo ? SCHED_FIFO : SCHED_RR;
+				sched_param param;
+				std::memset(&param, 0, sizeof(param));
+				param.sched_priority = options.priority;
+				int error = pthread_setschedparam(pthread_self(), policy, &param);
+				reportOption(status, status.scheduling, error == 0 ? OptionStatus::applied : errnoStatus(error),
+					policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR", std::strerror(error));
+			}
+			if (options.nice.has_value())
+			{
+				auto tid = static_cast<id_t>(syscall(SYS_gettid)); // Linux nice values are per thread.
+				int error = setpriority(PRIO_PROCESS, tid, options.nice.value()) == 0 ? 0 : errno;
+				reportOption(status, status.nice, error == 0 ? OptionStatus::applied : errnoStatus(error), "nice", std::strerror(error));
+			}
+			if (options.lock_memory)
+			{
+				int error = mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : errno;
+				reportOption(status, status.memory_lock, error == 0 ? OptionStatus::applied : errnoStatus(error), "mlockall", std::strerror(error));
+			}
+			if (options.prefault_stack != 0)
+			{
+				auto usable = usableStack();
+				auto bytes = options.prefault_stack < usable ? options.prefault_stack : usable;
+				if (bytes != 0) touchStack(bytes);
+				reportOption(status, status.stack_prefault, bytes == options.prefault_stack ? OptionStatus::applied : OptionStatus::failed,
+					"stack prefault", "only " + std::to_string(bytes) + " bytes of stack available");
+			}
+			if (!options.name.empty())
+			{
+				int error = pthread_setname_np(pthread_self(), options.name.substr(0, kMaxThreadName).c_str());
+				reportOption(status, status.naming, error == 0 ? OptionStatus::applied : errnoStatus(error), "name", std::strerror(error));
+			}
+#else
+			const std::string reason = "not supported on this platform";
+			if (options.policy != SchedulingPolicy::normal) reportOption(status, status.scheduling, OptionStatus::unsupported, "scheduling", reason);
+			if (options.nice.has_value()) reportOption(status, status.nice, OptionStatus::unsupported, "nice", reason);
+			if (options.lock_memory) reportOption(status, status.memory_lock, OptionStatus::unsupported, "memory lock", reason);
+			if (!options.name.empty()) reportOption(status, status.naming, OptionStatus::unsupported, "name", reason);
+			if (options.prefault_stack != 0)
+			{
+				touchStack(options.prefault_stack); // The caller asked for it and knows its stack size.
+				status.stack_prefault = OptionStatus::applied;
+			}
+#endif
+			return status;
+		}
+	}
+
+}}} // rboc::utils::threading
+#endif // THREADING_THREADOPTIONS_HEADER
@@ -3,6 +3,7 @@
 #define THREADING_THREADPOOL_HEADER
 
 #include <vector>
+#include <common/Optional.h>
 #include <thread/ActiveWorker.h>
 
 namespace rboc { namespace utils { namespace threading
@@ -10,6 +11,8 @@ namespace rboc { namespace utils { namespace threading
 	/*! 
 	 * This is a Thread Pool class that consists in a vector of ActiveWorkers 
 	 * that will have tasks scheduled in a round robin fashion.
+	 * Workers whose running task is inside a BlockingRegion are skipped and a
+	 * compensating thread runs their queue until the region ends.
 	 */
 	template<typename R, typename... Args>
 	class ThreadPool
@@ -19,12 +22,28 @@ namespace rboc { namespace utils { namespace threading
 		//! Default cosntructor
 		ThreadPool()
 			: _workers(1)
-		{}
+		{
+			setupWorkers();
+		}
 		
 		//! Explicit constructor
 		explicit ThreadPool(size_t num_threads)
 			: _workers(num_threads)
-		{}
+		{
+			setupWorkers();
+		}
+
+		//! Thread options constructor
+		/*!
+		 * \param num_threads the number of workers.
+		 * \param options applied to every worker thread. See configureThreads.
+		 */
+		ThreadPool(size_t num_threads, const ThreadOptions& options)
+			: _workers(num_threads)
+		{
+			setupWorkers();
+			configureThreads(options);
+		}
 		
 		//! stop
 		/*!
@@ -49,12 +68,168 @@ namespace rboc { namespace utils { namespace threading
 		std::future<R> addTask(F&& f, Args... args)
 		{
 			std::lock_guard<std::mutex> lock(_mtx);
-			_idx = (_idx % _workers.size());
-			return _workers[_idx++].addWork(std::forward<F>(f), std::forward<Args>(args)...);			
+			return nextWorker().addWork(std::forward<F>(f), std::forward<Args>(args)...);			
+		}
+
+		//! addTask.
+		/** 
+		 * Adds tasks to the thread pool allocating them with alloc.
+		 * \param alloc the allocator for the task and its shared state, i.e. TaskAllocator.
+		 * \param f the function to be executed.
+		 * \param Args... the arguments to be passed to the function f.
+		 */
+		template<typename Alloc, typename F>
+		std::future<R> addTask(std::allocator_arg_t, const Alloc& alloc, F&& f, Args... args)
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			return nextWorker().addWork(std::allocator_arg, alloc, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//! addTask.
+		/** 
+		 * Adds a task that is dropped if it has not started by the deadline.
+		 * \param deadline the point in time after which the task is not executed.
+		 * \param f the function to be executed.
+		 * \param Args... the arguments to be passed to the function f.
+		 */
+		template<typename F>
+		std::future<R> addTask(Deadline deadline, F&& f, Args... args)
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			return nextWorker().addWork(deadline, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//! post.
+		/** 
+		 * Enqueues an already built task whose future is kept by the caller.
+		 * \param task the task to be executed.
+		 * \param Args... the arguments to be passed to the task.
+		 */
+		void post(std::packaged_task<R(Args...)>&& task, Args... args)
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			nextWorker().post(std::move(task), std::forward<Args>(args)...);
+		}
+
+		//! size
+		/*!
+		 * \return the number of workers.
+		 */
+		size_t size() const
+		{
+			return _workers.size();
+		}
+
+		//! currentWorker
+		/*!
+		 * \return the index of the worker running the calling task, or nullopt
+		 * when called from a thread that is not one of this pool's workers.
+		 */
+		optional::Optional<size_t> currentWorker() const
+		{
+			auto identity = details::currentWorkerIdentity();
+			if (identity != nullptr && identity->owner.load(std::memory_order_acquire) == this)
+			{
+				return identity->index.load(std::memory_order_relaxed);
+			}
+			return optional::nullopt;
+		}
+
+		//! shedCount
+		/*!
+		 * \return the number of tasks dropped by all the workers because their deadline expired.
+		 */
+		uint64_t shedCount() const
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			uint64_t shed = 0;
+			for (const auto& worker : _workers)
+			{
+				shed += worker.shedCount();
+			}
+			return shed;
+		}
+
+		//! configureThreads
+		/*!
+		 * Applies options to every worker thread, each between two of its
+		 * tasks. A name is taken as the pool name: worker i is called
+		 * "<name>/i". Must not be called from a task of this pool.
+		 * \return the outcome for each worker, in worker order. See ActiveWorker::configureThread.
+		 */
+		std::vector<ThreadStatus> configureThreads(const ThreadOptions& options)
+		{
+			std::vector<ThreadStatus> statuses;
+			statuses.reserve(_workers.size());
+			auto worker_options = options;
+			for (size_t i = 0; i < _workers.size(); ++i) // Not under _mtx: running tasks may be adding tasks.
+			{
+				if (!options.name.empty())
+				{
+					worker_options.name = details::workerName(options.name, i);
+				}
+				statuses.push_back(_workers[i].configureThread(worker_options));
+			}
+			return statuses;
+		}
+
+		//! threadStatus
+		/*!
+		 * \return the outcome of the last configureThreads for each worker.
+		 */
+		std::vector<ThreadStatus> threadStatus() const
+		{
+			std::vector<ThreadStatus> statuses;
+			statuses.reserve(_workers.size());
+			for (const auto& worker : _workers)
+			{
+				statuses.push_back(worker.threadStatus());
+			}
+			return statuses;
+		}
+
+		//! cpuTime
+		/*!
+		 * \return the CPU time consumed so far by every worker. Divided by the
+		 * wall time elapsed and size(), the change between two calls is the
+		 * utilisation of the pool. See ActiveWorker::cpuTime.
+		 */
+		std::chrono::nanoseconds cpuTime() const
+		{
+			std::chrono::nanoseconds total{0};
+			for (const auto& worker : _workers)
+			{
+				total += worker.cpuTime();
+			}
+			return total;
 		}
 
 		private:
 
+		void setupWorkers()
+		{
+			for (size_t i = 0; i < _workers.size(); ++i)
+			{
+				_workers[i].setCompensation(true);
+				_workers[i].setOwner(this, i);
+			}
+		}
+
+		// Next worker in round robin order, skipping blocked ones. Called with _mtx held.
+		ActiveWorker<R, Args...>& nextWorker()
+		{
+			for (size_t attempt = 0; attempt < _workers.size(); ++attempt)
+			{
+				auto& worker = _workers[_idx++ % _workers.size()];
+				if (!worker.blocked())
+				{
+					return worker;
+				}
+			}
+			// Every worker is blocked: their compensators will run the task.
+			return _workers[_idx++ % _workers.size()];
+		}
+
 		size_t _idx = 0;
 		std::vector<ActiveWorker<R,Args...>> _workers{1};
 		mutable std::mutex _mtx = {}; /*! < Mutex to protect the workers. */
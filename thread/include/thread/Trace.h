@@ -0,0 +1,313 @@
+#pragma once
+#ifndef THREADING_TRACE_HEADER
+#define THREADING_TRACE_HEADER
+
+#include <cstdint>
+
+//! Set RBOC_THREADING_TRACE to 1 (cmake -DENABLE_TRACING=ON) to compile task tracing in.
+#ifndef RBOC_THREADING_TRACE
+#define RBOC_THREADING_TRACE 0
+#endif
+
+#if RBOC_THREADING_TRACE
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace rboc { namespace utils { namespace threading { namespace trace
+{
+	//! Kind of a trace event.
+	enum class EventType : uint8_t
+	{
+		submit, //!< The task was queued.
+		start,  //!< A worker dequeued the task and started running it.
+		end     //!< The task finished.
+	};
+
+#if RBOC_THREADING_TRACE
+
+	//! One trace event. Task ids pair the submit, start and end of a task.
+	struct Event
+	{
+		uint64_t timestamp; // Nanoseconds on the steady clock.
+		uint64_t task_id;
+		EventType type;
+	};
+
+	namespace details
+	{
+		//! Number of events a thread can record before it starts dropping them.
+		static constexpr std::size_t kBufferCapacity = 1 << 16;
+
+		//! class ThreadBuffer
+		/**
+		 * Events recorded by a single thread. Only the owner thread writes; the
+		 * size is published with release semantics so a flush can read every
+		 * complete event without locking.
+		 */
+		struct ThreadBuffer
+		{
+			explicit ThreadBuffer(uint64_t tid)
+				: _tid(tid)
+				, _events(kBufferCapacity)
+				, _size(0)
+				, _dropped(0)
+			{}
+
+			void push(EventType type, uint64_t task_id) noexcept
+			{
+				auto size = _size.load(std::memory_order_relaxed);
+				if (size == kBufferCapacity)
+				{
+					_dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					return;
+				}
+				auto now = std::chrono::steady_clock::now().time_since_epoch();
+				auto& event = _events[size];
+				event.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+				event.task_id = task_id;
+				event.type = type;
+				_size.store(size + 1, std::memory_order_release);
+			}
+
+			const uint64_t _tid;
+			std::vector<Event> _events;
+			std::atomic<std::size_t> _size;
+			std::atomic<uint64_t> _dropped;
+		};
+
+		//! Every buffer ever created. Buffers outlive their threads until flushed.
+		struct Registry
+		{
+			std::atomic_bool _enabled{false};
+			std::atomic<uint64_t> _next_worker{1};
+			std::mutex _mtx;
+			std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+		};
+
+		inline Registry& registry()
+		{
+			static Registry instance;
+			return instance;
+		}
+
+		inline uint64_t currentTid()
+		{
+#if defined(__linux__)
+			return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+			return static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+#endif
+		}
+
+		inline ThreadBuffer& localBuffer()
+		{
+			static thread_local std::shared_ptr<ThreadBuffer> buffer = []
+			{
+				auto created = std::make_shared<ThreadBuffer>(currentTid());
+				auto& reg = registry();
+				std::lock_guard<std::mutex> lock(reg._mtx);
+				reg._buffers.push_back(created);
+				return created;
+			}();
+			return *buffer;
+		}
+	}
+
+	//! enable
+	/**
+	 * Starts recording events.
+	 */
+	inline void enable() noexcept
+	{
+		details::registry()._enabled.store(true, std::memory_order_relaxed);
+	}
+
+	//! disable
+	/**
+	 * Stops recording events. Already recorded events are kept until flushed.
+	 */
+	inline void disable() noexcept
+	{
+		details::registry()._enabled.store(false, std::memory_order_relaxed);
+	}
+
+	//! enabled
+	/**
+	 * \return true if events are being recorded.
+	 */
+	inline bool enabled() noexcept
+	{
+		return details::registry()._enabled.load(std::memory_order_relaxed);
+	}
+
+	//! record
+	/**
+	 * Records an event in the calling thread's buffer if tracing is enabled.
+	 * \param type the kind of event.
+	 * \param task_id the id of the task the event refers to.
+	 */
+	inline void record(EventType type, uint64_t task_id) noexcept
+	{
+		if (enabled())
+		{
+			details::localBuffer().push(type, task_id);
+		}
+	}
+
+	//! writeChromeTrace
+	/**
+	 * Writes every recorded event as Chrome trace JSON, which can be loaded in
+	 * chrome://tracing or Perfetto. Submissions are instant events linked to the
+	 * execution slice by a flow arrow.
+	 * \param out the stream to write to.
+	 * \return the number of events that were dropped because a buffer was full.
+	 */
+	inline uint64_t writeChromeTrace(std::ostream& out)
+	{
+		auto& reg = details::registry();
+		std::vector<std::shared_ptr<details::ThreadBuffer>> buffers;
+		{
+			std::lock_guard<std::mutex> lock(reg._mtx);
+			buffers = reg._buffers;
+		}
+#if defined(__linux__)
+		auto pid = static_cast<long>(getpid());
+#else
+		long pid = 1;
+#endif
+		uint64_t dropped = 0;
+		bool first = true;
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		auto emit = [&](const char* name, const char* phase, uint64_t tid, uint64_t ts, uint64_t id, const char* extra)
+		{
+			out << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"task\",\"ph\":\"" << phase
+				<< "\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"ts\":" << (ts / 1000) << '.';
+			auto frac = ts % 1000;
+			out << (frac < 100 ? (frac < 10 ? "00" : "0") : "") << frac
+				<< ",\"id\":" << id << ",\"args\":{\"task\":" << id << "}" << extra << "}";
+			first = false;
+		};
+		for (const auto& buffer : buffers)
+		{
+			auto size = buffer->_size.load(std::memory_order_acquire);
+			dropped += buffer->_dropped.load(std::memory_order_relaxed);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				const auto& event = buffer->_events[i];
+				switch (event.type)
+				{
+					case EventType::submit:
+						emit("submit", "i", buffer->_tid, event.timestamp, event.task_id, ",\"s\":\"t\"");
+						emit("task", "s", buffer->_tid, event.timestamp, event.task_id, "");
+						break;
+					case EventType::start:
+						emit("task", "f", buffer->_tid, event.timestamp, event.task_id, ",\"bp\":\"e\"");
+						emit("task", "B", buffer->_tid, event.timestamp, event.task_id, "");
+						break;
+					case EventType::end:
+						emit("task", "E", buffer->_tid, event.timestamp, event.task_id, "");
+						break;
+				}
+			}
+		}
+		out << "\n]}\n";
+		return dropped;
+	}
+
+	//! writeChromeTrace
+	/**
+	 * Writes every recorded event to a Chrome trace JSON file.
+	 * \param path the file to write.
+	 * \param error Output parameter set to 0 on success, 1 if the file cannot be written.
+	 */
+	inline void writeChromeTrace(const std::string& path, int& error)
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			error = 1;
+			return;
+		}
+		writeChromeTrace(file);
+		error = file.good() ? 0 : 1;
+	}
+
+	//! clear
+	/**
+	 * Discards every recorded event. It must not race with threads recording events.
+	 */
+	inline void clear()
+	{
+		auto& reg = details::registry();
+		std::lock_guard<std::mutex> lock(reg._mtx);
+		for (auto& buffer : reg._buffers)
+		{
+			buffer->_size.store(0, std::memory_order_relaxed);
+			buffer->_dropped.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	//! class WorkerTrace
+	/**
+	 * Hands out task ids for a FIFO worker: the n-th task pushed is the n-th task
+	 * popped, so a pair of counters (protected by the worker queue mutex) is all
+	 * it takes to match submissions with executions.
+	 */
+	class WorkerTrace
+	{
+		public:
+
+		WorkerTrace()
+			: _worker(details::registry()._next_worker.fetch_add(1, std::memory_order_relaxed))
+		{}
+
+		uint64_t pushed() noexcept
+		{
+			return (_worker << 40) | (_pushed++ & 0xFFFFFFFFFFull);
+		}
+
+		uint64_t popped() noexcept
+		{
+			return (_worker << 40) | (_popped++ & 0xFFFFFFFFFFull);
+		}
+
+		private:
+
+		uint64_t _worker;
+		uint64_t _pushed = 0;
+		uint64_t _popped = 0;
+	};
+
+#else // !RBOC_THREADING_TRACE
+
+	// Tracing is compiled out: every hook is an empty inline function.
+	inline void enable() noexcept {}
+	inline void disable() noexcept {}
+	inline bool enabled() noexcept { return false; }
+	inline void record(EventType, uint64_t) noexcept {}
+
+	class WorkerTrace
+	{
+		public:
+		uint64_t pushed() noexcept { return 0; }
+		uint64_t popped() noexcept { return 0; }
+	};
+
+#endif // RBOC_THREADING_TRACE
+
+}}}} // namespace rboc::utils::threading::trace
+
+#endif // THREADING_TRACE_HEADER
@@ -0,0 +1,191 @@
+#pragma once
+#ifndef THREADING_WORKERLOCAL_HEADER
+#define THREADING_WORKERLOCAL_HEADER
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <common/Utility.h>
+#include <thread/ActiveWorker.h>
+#include <thread/Threadpool.h>
+
+namespace rboc { namespace utils { namespace threading
+{
+	namespace details
+	{
+		//! One lazily constructed value. Slots are allocated in an array and the
+		//! padding keeps values of neighbouring slots from sharing a cache line
+		//! (over-aligned new is not available before C++17).
+		template<typename T>
+		struct WorkerSlot
+		{
+			WorkerSlot() = default;
+			WorkerSlot(const WorkerSlot&) = delete;
+			WorkerSlot& operator=(const WorkerSlot&) = delete;
+
+			~WorkerSlot()
+			{
+				if (constructed)
+				{
+					get().~T();
+				}
+			}
+
+			T& get() noexcept
+			{
+				return *reinterpret_cast<T*>(&storage);
+			}
+
+			T& getOrCreate(const std::function<T()>& factory)
+			{
+				if (!constructed)
+				{
+					::new (static_cast<void*>(&storage)) T(factory());
+					constructed = true;
+				}
+				return get();
+			}
+
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+			bool constructed = false;
+			char padding[utilities::kCacheLineSize];
+		};
+	}
+
+	//! class WorkerLocal
+	/**
+	 * One instance of T per worker of a ThreadPool, i.e. per-worker accumulators,
+	 * scratch buffers or caches. A task reaches its worker's instance with local()
+	 * without locking or sharing cache lines with other workers. Values are built
+	 * lazily, on first use, with the factory (or value initialised).
+	 *
+	 * Threads that are not workers of the pool (the submitting thread, threads
+	 * compensating for a blocked worker) get their own instance too, through a
+	 * slower, mutex protected path.
+	 *
+	 * combine() and forEach() visit every constructed instance; they must not run
+	 * concurrently with tasks using local(), i.e. call them after waiting on the
+	 * futures of those tasks.
+	 *
+	 * \code
+	 * ThreadPool<void> pool{4};
+	 * WorkerLocal<long> sums{pool};
+	 * for (...) pool.addTask([&]{ sums.local() += work(); });
+	 * // wait for the tasks...
+	 * auto total = sums.combine(0L, std::plus<long>());
+	 * \endcode
+	 */
+	template<typename T>
+	class WorkerLocal
+	{
+		public:
+
+		//! Constructor
+		/**
+		 * \param pool the pool whose workers get an instance each. It must outlive this object.
+		 */
+		template<typename R, typename... Args>
+		explicit WorkerLocal(const ThreadPool<R, Args...>& pool)
+			: WorkerLocal(pool, []{ return T(); })
+		{}
+
+		//! Constructor
+		/**
+		 * \param pool the pool whose workers get an instance each. It must outlive this object.
+		 * \param factory builds the instance of a thread on its first call to local().
+		 */
+		template<typename R, typename... Args>
+		WorkerLocal(const ThreadPool<R, Args...>& pool, std::function<T()> factory)
+			: _owner(&pool)
+			, _size(pool.size())
+			, _slots(new details::WorkerSlot<T>[pool.size()])
+			, _factory(std::move(factory))
+		{}
+
+		//! Copy constructor
+		WorkerLocal(const WorkerLocal& other) = delete;
+		//! Copy assignment
+		WorkerLocal& operator=(const WorkerLocal& other) = delete;
+
+		//! local
+		/**
+		 * \return the instance of the calling thread, constructing it if needed.
+		 */
+		T& local()
+		{
+			auto identity = details::currentWorkerIdentity();
+			if (identity != nullptr && identity->owner.load(std::memory_order_acquire) == _owner)
+			{
+				return _slots[identity->index.load(std::memory_order_relaxed)].getOrCreate(_factory);
+			}
+			return externalSlot().getOrCreate(_factory);
+		}
+
+		//! forEach
+		/**
+		 * Calls f on every constructed instance.
+		 * \param f a function taking T&.
+		 */
+		template<typename F>
+		void forEach(F&& f)
+		{
+			for (size_t i = 0; i < _size; ++i)
+			{
+				if (_slots[i].constructed)
+				{
+					f(_slots[i].get());
+				}
+			}
+			std::lock_guard<std::mutex> lock(_mtx);
+			for (auto& entry : _external)
+			{
+				if (entry.second->constructed)
+				{
+					f(entry.second->get());
+				}
+			}
+		}
+
+		//! combine
+		/**
+		 * Folds every constructed instance into init.
+		 * \param init the initial value.
+		 * \param op a binary function (accumulated, const T&) returning the new accumulated value.
+		 * \return the folded value.
+		 */
+		template<typename U, typename BinaryOp>
+		U combine(U init, BinaryOp op)
+		{
+			forEach([&](T& value){ init = op(std::move(init), value); });
+			return init;
+		}
+
+		private:
+
+		details::WorkerSlot<T>& externalSlot()
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			auto& slot = _external[std::this_thread::get_id()];
+			if (!slot)
+			{
+				slot.reset(new details::WorkerSlot<T>());
+			}
+			return *slot;
+		}
+
+		const void* _owner;
+		size_t _size;
+		std::unique_ptr<details::WorkerSlot<T>[]> _slots;
+		std::function<T()> _factory;
+		std::mutex _mtx; /*! < Protects _external. */
+		std::map<std::thread::id, std::unique_ptr<details::WorkerSlot<T>>> _external;
+	};
+
+}}} // rboc::utils::threading
+#endif // THREADING_WORKERLOCAL_HEADER